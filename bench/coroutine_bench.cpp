@@ -0,0 +1,245 @@
+// Storage hand-off: blocking handlers vs. callback stages vs. coroutine handlers.
+//
+// Every request makes one blocking storage call that takes --latency-ms. Three handler shapes
+// are timed on the same storage executor (storage_executors::sqlite(), --executor-threads):
+//
+//   blocking   makes the call on its I/O thread, the way the order handlers did before the
+//              executors;
+//   callback   submits the call to the executor and completes the response from there, the
+//              way run_stage() does in order_routes.cpp;
+//   coroutine  co_awaits route_coro::resume_on(storage_executors::sqlite()), makes the call,
+//              and co_returns, the way the coroutine get_order does.
+//
+// All requests are posted up front to an io_context run by 1, 2, 4... I/O threads, and the
+// wall time until the last response is completed on its I/O thread is measured.
+//
+// Blocking throughput grows with the I/O thread count (threads / latency). Callback and
+// coroutine throughput are set by the executor (executor threads / latency) at any I/O thread
+// count; the gap between them is the cost of the coroutine frame and resume. With
+// --latency-ms 0 the run measures the hand-off itself.
+//
+// Usage:
+//   coroutine_bench [--requests 200] [--latency-ms 20] [--executor-threads 4] [--max-threads 8] [--json]
+//
+// Needs C++20: build with -std=c++20 -DORDER_SERVICE_COROUTINES.
+#include "crow_all.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_response.h"
+#include "metrics.h"
+#include "route_coroutine.h"
+#include "storage_executors.h"
+
+#ifndef ORDER_SERVICE_COROUTINES
+#error "coroutine_bench needs -std=c++20 -DORDER_SERVICE_COROUTINES"
+#endif
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+enum class Handler { Blocking, Callback, Coroutine };
+
+struct Options {
+    int requests = 200;
+    int latency_ms = 20;
+    int executor_threads = 4;
+    int max_threads = 8;
+    bool json = false;
+};
+
+struct RunResult {
+    string handler;
+    int io_threads = 0;
+    int completed = 0;
+    double seconds = 0;
+};
+
+const char* handler_name(Handler handler) {
+    switch (handler) {
+        case Handler::Blocking:
+            return "blocking";
+        case Handler::Callback:
+            return "callback";
+        case Handler::Coroutine:
+            return "coroutine";
+    }
+    return "";
+}
+
+// Stands in for a SQLite or Redis call: holds its thread for the whole latency.
+crow::response storage_call(int latency_ms) {
+    if (latency_ms > 0) {
+        this_thread::sleep_for(chrono::milliseconds(latency_ms));
+    }
+    return crow::response(200);
+}
+
+route_coro::Response coroutine_handler(const crow::request&, int latency_ms) {
+    const bool on_sqlite = co_await route_coro::resume_on(storage_executors::sqlite());
+    if (!on_sqlite) {
+        co_return crow::response(503);
+    }
+    co_return storage_call(latency_ms);
+}
+
+void callback_handler(const crow::request& req, crow::response& res, int latency_ms) {
+    const bool queued = storage_executors::sqlite().submit([&req, &res, latency_ms] {
+        complete_response(req, res, storage_call(latency_ms));
+    });
+    if (!queued) {
+        res = crow::response(503);
+        res.end();
+    }
+}
+
+const metrics::ExecutorStats& sqlite_stats() {
+    for (const auto& pool : metrics::executors) {
+        if (pool.name == "sqlite") {
+            return pool;
+        }
+    }
+    cerr << "storage executors not started\n";
+    exit(1);
+}
+
+RunResult run(Handler handler, int io_threads, const Options& options) {
+    asio::io_context io;
+    // The I/O threads have nothing to do while the executor works on the last requests, so
+    // they are kept running until every executor task has posted its response back.
+    auto work = asio::make_work_guard(io);
+    vector<crow::request> requests(options.requests);
+    vector<crow::response> responses(options.requests);
+    const auto coroutine = route_coro::route(coroutine_handler);
+    for (int i = 0; i < options.requests; ++i) {
+        requests[i].io_context = &io;
+        asio::post(io, [&, i] {
+            switch (handler) {
+                case Handler::Blocking:
+                    complete_response(requests[i], responses[i], storage_call(options.latency_ms));
+                    break;
+                case Handler::Callback:
+                    callback_handler(requests[i], responses[i], options.latency_ms);
+                    break;
+                case Handler::Coroutine:
+                    coroutine(requests[i], responses[i], options.latency_ms);
+                    break;
+            }
+        });
+    }
+
+    const auto& stats = sqlite_stats();
+    const int64_t completed_before = stats.completed.load();
+    const auto start = Clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < io_threads; ++t) {
+        threads.emplace_back([&io] { io.run(); });
+    }
+    if (handler != Handler::Blocking) {
+        // An executor task counts as completed only after its response was posted to io.
+        while (stats.completed.load() - completed_before < options.requests) {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+    work.reset();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    RunResult result;
+    result.handler = handler_name(handler);
+    result.io_threads = io_threads;
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    result.completed = static_cast<int>(count_if(responses.begin(), responses.end(), [](const crow::response& res) {
+        return res.is_completed() && res.code == 200;
+    }));
+    return result;
+}
+
+void usage() {
+    cerr << "usage: coroutine_bench [--requests N] [--latency-ms N] [--executor-threads N] [--max-threads N] [--json]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        if (arg == "--requests") {
+            options.requests = max(1, atoi(value.c_str()));
+        } else if (arg == "--latency-ms") {
+            options.latency_ms = max(0, atoi(value.c_str()));
+        } else if (arg == "--executor-threads") {
+            options.executor_threads = max(1, atoi(value.c_str()));
+        } else if (arg == "--max-threads") {
+            options.max_threads = max(1, atoi(value.c_str()));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    crow::logger::setLogLevel(crow::LogLevel::Warning);
+
+    // Queues sized for the whole batch, so no request is shed and every run does the same work.
+    storage_executors::Options executor_options;
+    executor_options.sqlite_threads = options.executor_threads;
+    executor_options.sqlite_queue = options.requests;
+    storage_executors::start(executor_options);
+
+    vector<RunResult> results;
+    for (int threads = 1; threads <= options.max_threads; threads *= 2) {
+        for (const Handler handler : {Handler::Blocking, Handler::Callback, Handler::Coroutine}) {
+            results.push_back(run(handler, threads, options));
+        }
+    }
+    storage_executors::stop();
+
+    bool all_completed = true;
+    for (const auto& result : results) {
+        all_completed = all_completed && result.completed == options.requests;
+    }
+
+    if (options.json) {
+        crow::json::wvalue out;
+        out["requests"] = options.requests;
+        out["latency_ms"] = options.latency_ms;
+        out["executor_threads"] = options.executor_threads;
+        for (size_t i = 0; i < results.size(); ++i) {
+            out["results"][i]["handler"] = results[i].handler;
+            out["results"][i]["io_threads"] = results[i].io_threads;
+            out["results"][i]["completed"] = results[i].completed;
+            out["results"][i]["seconds"] = results[i].seconds;
+            out["results"][i]["requests_per_second"] = results[i].completed / results[i].seconds;
+        }
+        cout << out.dump() << "\n";
+    } else {
+        cout << options.requests << " concurrent requests, " << options.latency_ms << " ms storage latency, "
+             << options.executor_threads << " executor threads\n";
+        for (const auto& result : results) {
+            cout << result.handler << " x" << result.io_threads << " io threads: " << result.seconds * 1000.0
+                 << " ms, " << result.completed / result.seconds << " req/s\n";
+        }
+    }
+    return all_completed ? 0 : 1;
+}
@@ -0,0 +1,461 @@
+// Open-loop load generator for the order API.
+//
+// Requests are issued on a fixed arrival schedule (request i is due at start + i / rate)
+// over persistent keep-alive connections. Latency is measured from the scheduled send
+// time rather than the actual one, so a stalled server cannot hide queueing delay by
+// slowing the generator down (coordinated omission). Service time from the actual send
+// is reported alongside for comparison.
+//
+// Usage:
+//   load_generator [--host localhost] [--port 8080] [--api-key KEY] [--rate 500]
+//                  [--duration 30] [--connections 16]
+//                  [--mix create=30,get=40,pay=15,list=5,delete=10]
+//                  [--trace requests.jsonl] [--json]
+//
+// Trace files hold one request per line:
+//   {"method": "GET", "path": "/order/get/{order_no}", "body": "", "at_ms": 12.5}
+// `{order_no}` is replaced with an order created during the run, and `at_ms` (optional)
+// overrides the fixed-rate schedule with the recorded arrival offset.
+#include "crow_all.h"
+#include <httplib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+enum class Op { Create, Get, Pay, List, Delete, Trace };
+const char* const kOpNames[] = {"create", "get", "pay", "list", "delete", "trace"};
+constexpr int kOpCount = 6;
+
+struct Options {
+    string host = "localhost";
+    int port = 8080;
+    string api_key = "1234567";
+    double rate = 500;
+    double duration_seconds = 30;
+    int connections = 16;
+    map<string, int> mix = {{"create", 30}, {"get", 40}, {"pay", 15}, {"list", 5}, {"delete", 10}};
+    string trace_path;
+    bool json = false;
+};
+
+struct TraceEntry {
+    string method;
+    string path;
+    string body;
+    double at_ms = -1;
+};
+
+// Per-thread results, merged once the run is over.
+struct OpStats {
+    LatencyHistogram corrected{10, 32};
+    LatencyHistogram service{10, 32};
+    map<int, uint64_t> statuses;
+};
+
+struct WorkerStats {
+    OpStats ops[kOpCount];
+    uint64_t late_sends = 0;
+};
+
+// Orders created during the run, so get/pay/delete target rows that exist.
+class OrderPool {
+public:
+    void add(string order_no) {
+        lock_guard<mutex> lock(mutex_);
+        orders_.push_back(move(order_no));
+    }
+
+    bool pick(mt19937_64& rng, string& out) {
+        lock_guard<mutex> lock(mutex_);
+        if (orders_.empty()) {
+            return false;
+        }
+        out = orders_[rng() % orders_.size()];
+        return true;
+    }
+
+    bool take(mt19937_64& rng, string& out) {
+        lock_guard<mutex> lock(mutex_);
+        if (orders_.empty()) {
+            return false;
+        }
+        const size_t index = rng() % orders_.size();
+        out = move(orders_[index]);
+        orders_[index] = move(orders_.back());
+        orders_.pop_back();
+        return true;
+    }
+
+private:
+    mutex mutex_;
+    vector<string> orders_;
+};
+
+bool parse_mix(const string& raw, map<string, int>& mix) {
+    mix.clear();
+    stringstream ss(raw);
+    string item;
+    while (getline(ss, item, ',')) {
+        const auto eq = item.find('=');
+        if (eq == string::npos) {
+            return false;
+        }
+        const string name = item.substr(0, eq);
+        if (find(begin(kOpNames), end(kOpNames) - 1, name) == end(kOpNames) - 1) {
+            return false;
+        }
+        mix[name] = max(0, atoi(item.c_str() + eq + 1));
+    }
+    return !mix.empty();
+}
+
+bool load_trace(const string& path, vector<TraceEntry>& trace) {
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        auto json = crow::json::load(line);
+        if (!json || !json.has("method") || !json.has("path")) {
+            continue;
+        }
+        TraceEntry entry;
+        entry.method = json["method"].s();
+        entry.path = json["path"].s();
+        if (json.has("body")) {
+            entry.body = json["body"].t() == crow::json::type::String ? string(json["body"].s()) : string();
+        }
+        if (json.has("at_ms")) {
+            entry.at_ms = json["at_ms"].d();
+        }
+        trace.push_back(move(entry));
+    }
+    return !trace.empty();
+}
+
+string replace_order_placeholder(string text, const string& order_no) {
+    static const string placeholder = "{order_no}";
+    for (auto pos = text.find(placeholder); pos != string::npos; pos = text.find(placeholder, pos)) {
+        text.replace(pos, placeholder.size(), order_no);
+        pos += order_no.size();
+    }
+    return text;
+}
+
+int status_of(const httplib::Result& res) {
+    return res ? res->status : 0;
+}
+
+class Worker {
+public:
+    Worker(const Options& options, OrderPool& pool, const vector<Op>& op_table,
+           const vector<TraceEntry>& trace, atomic<uint64_t>& next_index, uint64_t total_requests,
+           Clock::time_point start, uint64_t seed)
+        : options_(options), pool_(pool), op_table_(op_table), trace_(trace), next_index_(next_index),
+          total_requests_(total_requests), start_(start), rng_(seed),
+          client_(options.host, options.port) {
+        client_.set_keep_alive(true);
+        client_.set_tcp_nodelay(true);
+        client_.set_connection_timeout(chrono::seconds(5));
+        client_.set_read_timeout(chrono::seconds(30));
+        headers_ = {{"Authorization", options.api_key}};
+    }
+
+    void run() {
+        const double interval_ns = 1e9 / options_.rate;
+        for (uint64_t i = next_index_.fetch_add(1); i < total_requests_; i = next_index_.fetch_add(1)) {
+            const TraceEntry* entry = trace_.empty() ? nullptr : &trace_[i % trace_.size()];
+            const double offset_ns = entry != nullptr && entry->at_ms >= 0
+                ? entry->at_ms * 1e6
+                : static_cast<double>(i) * interval_ns;
+            const auto intended = start_ + chrono::nanoseconds(static_cast<int64_t>(offset_ns));
+
+            const auto now = Clock::now();
+            if (now < intended) {
+                this_thread::sleep_until(intended);
+            } else if (now - intended > chrono::milliseconds(1)) {
+                ++stats_.late_sends;
+            }
+
+            const auto sent = Clock::now();
+            Op op = entry != nullptr ? Op::Trace : op_table_[rng_() % op_table_.size()];
+            const int status = issue(op, entry);
+            const auto done = Clock::now();
+
+            auto& op_stats = stats_.ops[static_cast<int>(op)];
+            op_stats.corrected.record(chrono::duration_cast<chrono::microseconds>(done - intended).count());
+            op_stats.service.record(chrono::duration_cast<chrono::microseconds>(done - sent).count());
+            ++op_stats.statuses[status];
+        }
+    }
+
+    const WorkerStats& stats() const { return stats_; }
+
+private:
+    // An op with no order to act on creates one instead, and `op` becomes Op::Create so the
+    // request is counted as what was actually sent.
+    int issue(Op& op, const TraceEntry* entry) {
+        string order_no;
+        switch (op) {
+            case Op::Create:
+                return create();
+            case Op::Get:
+                if (!pool_.pick(rng_, order_no)) {
+                    op = Op::Create;
+                    return create();
+                }
+                return status_of(client_.Get("/order/get/" + order_no, headers_));
+            case Op::Pay:
+                if (!pool_.pick(rng_, order_no)) {
+                    op = Op::Create;
+                    return create();
+                }
+                return status_of(client_.Post(
+                    "/order/pay", headers_, R"({"order_no": ")" + order_no + R"("})", "application/json"));
+            case Op::List:
+                return status_of(client_.Get("/order/list?status=PENDING", headers_));
+            case Op::Delete:
+                if (!pool_.take(rng_, order_no)) {
+                    op = Op::Create;
+                    return create();
+                }
+                return status_of(client_.Delete("/order/delete/" + order_no, headers_));
+            case Op::Trace:
+                return replay(*entry, op);
+        }
+        return 0;
+    }
+
+    int create() {
+        const double amount = static_cast<double>(rng_() % 50000 + 1) / 100.0;
+        ostringstream body;
+        body << R"({"amount": )" << amount << "}";
+        auto res = client_.Post("/order/create", headers_, body.str(), "application/json");
+        if (res && res->status == 200) {
+            auto json = crow::json::load(res->body);
+            if (json && json.has("order_no")) {
+                pool_.add(json["order_no"].s());
+            }
+        }
+        return status_of(res);
+    }
+
+    int replay(const TraceEntry& entry, Op& op) {
+        string order_no;
+        const bool needs_order = entry.path.find("{order_no}") != string::npos ||
+                                 entry.body.find("{order_no}") != string::npos;
+        if (needs_order && !pool_.pick(rng_, order_no)) {
+            op = Op::Create;
+            return create();
+        }
+        const string path = replace_order_placeholder(entry.path, order_no);
+        const string body = replace_order_placeholder(entry.body, order_no);
+
+        httplib::Result res;
+        if (entry.method == "GET") {
+            res = client_.Get(path, headers_);
+        } else if (entry.method == "POST") {
+            res = client_.Post(path, headers_, body, "application/json");
+        } else if (entry.method == "DELETE") {
+            res = client_.Delete(path, headers_);
+        } else {
+            return 0;
+        }
+        if (res && res->status == 200 && path == "/order/create") {
+            auto json = crow::json::load(res->body);
+            if (json && json.has("order_no")) {
+                pool_.add(json["order_no"].s());
+            }
+        }
+        return status_of(res);
+    }
+
+    const Options& options_;
+    OrderPool& pool_;
+    const vector<Op>& op_table_;
+    const vector<TraceEntry>& trace_;
+    atomic<uint64_t>& next_index_;
+    uint64_t total_requests_;
+    Clock::time_point start_;
+    mt19937_64 rng_;
+    httplib::Client client_;
+    httplib::Headers headers_;
+    WorkerStats stats_;
+};
+
+void usage() {
+    cerr << "usage: load_generator [--host H] [--port P] [--api-key K] [--rate R] [--duration S]\n"
+            "                      [--connections N] [--mix create=30,get=40,pay=15,list=5,delete=10]\n"
+            "                      [--trace FILE.jsonl] [--json]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        if (arg == "--host") {
+            options.host = value;
+        } else if (arg == "--port") {
+            options.port = atoi(value.c_str());
+        } else if (arg == "--api-key") {
+            options.api_key = value;
+        } else if (arg == "--rate") {
+            options.rate = atof(value.c_str());
+        } else if (arg == "--duration") {
+            options.duration_seconds = atof(value.c_str());
+        } else if (arg == "--connections") {
+            options.connections = max(1, atoi(value.c_str()));
+        } else if (arg == "--mix") {
+            if (!parse_mix(value, options.mix)) {
+                cerr << "invalid --mix " << value << endl;
+                return false;
+            }
+        } else if (arg == "--trace") {
+            options.trace_path = value;
+        } else {
+            return false;
+        }
+    }
+    return options.rate > 0 && options.duration_seconds > 0;
+}
+
+void print_text(const OpStats* ops, double elapsed_seconds, uint64_t total, uint64_t late_sends) {
+    cout << "requests " << total << " in " << elapsed_seconds << " s ("
+         << static_cast<int64_t>(total / elapsed_seconds) << " req/s achieved), late sends " << late_sends << "\n";
+    cout << "latency in ms, corrected for coordinated omission (service time in brackets)\n";
+    for (int i = 0; i < kOpCount; ++i) {
+        const auto& op = ops[i];
+        if (op.corrected.count() == 0) {
+            continue;
+        }
+        cout << kOpNames[i] << ": n=" << op.corrected.count();
+        for (const double p : {50.0, 90.0, 99.0, 99.9}) {
+            cout << " p" << p << "=" << op.corrected.value_at_percentile(p) / 1000.0
+                 << " [" << op.service.value_at_percentile(p) / 1000.0 << "]";
+        }
+        cout << " max=" << op.corrected.max() / 1000.0 << " statuses:";
+        for (const auto& [status, count] : op.statuses) {
+            cout << " " << (status == 0 ? string("conn_error") : to_string(status)) << "=" << count;
+        }
+        cout << "\n";
+    }
+}
+
+void print_json(const OpStats* ops, double elapsed_seconds, uint64_t total, uint64_t late_sends, const Options& options) {
+    crow::json::wvalue out;
+    out["target_rate"] = options.rate;
+    out["achieved_rate"] = total / elapsed_seconds;
+    out["requests"] = total;
+    out["late_sends"] = late_sends;
+    out["connections"] = options.connections;
+    for (int i = 0; i < kOpCount; ++i) {
+        const auto& op = ops[i];
+        if (op.corrected.count() == 0) {
+            continue;
+        }
+        auto& entry = out["ops"][kOpNames[i]];
+        entry["count"] = op.corrected.count();
+        for (const auto& [label, p] : {pair<const char*, double>{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p999", 99.9}}) {
+            entry["latency_us"][label] = op.corrected.value_at_percentile(p);
+            entry["service_time_us"][label] = op.service.value_at_percentile(p);
+        }
+        entry["latency_us"]["max"] = op.corrected.max();
+        entry["latency_us"]["mean"] = op.corrected.mean();
+        for (const auto& [status, count] : op.statuses) {
+            entry["statuses"][status == 0 ? string("conn_error") : to_string(status)] = count;
+        }
+    }
+    cout << out.dump() << endl;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    vector<TraceEntry> trace;
+    if (!options.trace_path.empty() && !load_trace(options.trace_path, trace)) {
+        cerr << "Can't read any requests from trace " << options.trace_path << endl;
+        return 1;
+    }
+
+    vector<Op> op_table;
+    for (int i = 0; i < kOpCount - 1; ++i) {
+        const auto it = options.mix.find(kOpNames[i]);
+        const int weight = it == options.mix.end() ? 0 : it->second;
+        op_table.insert(op_table.end(), weight, static_cast<Op>(i));
+    }
+    if (trace.empty() && op_table.empty()) {
+        cerr << "--mix has no positive weights" << endl;
+        return 2;
+    }
+
+    uint64_t total_requests = static_cast<uint64_t>(options.rate * options.duration_seconds);
+    if (!trace.empty() && trace.front().at_ms >= 0) {
+        total_requests = trace.size();
+    }
+
+    OrderPool pool;
+    atomic<uint64_t> next_index{0};
+    const auto start = Clock::now() + chrono::milliseconds(100);
+    vector<unique_ptr<Worker>> workers;
+    for (int i = 0; i < options.connections; ++i) {
+        workers.push_back(make_unique<Worker>(
+            options, pool, op_table, trace, next_index, total_requests, start, 0x9E3779B97F4A7C15ULL * (i + 1)));
+    }
+
+    vector<thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker] { worker->run(); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const double elapsed_seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    OpStats merged[kOpCount];
+    uint64_t late_sends = 0;
+    for (const auto& worker : workers) {
+        late_sends += worker->stats().late_sends;
+        for (int i = 0; i < kOpCount; ++i) {
+            merged[i].corrected.merge(worker->stats().ops[i].corrected);
+            merged[i].service.merge(worker->stats().ops[i].service);
+            for (const auto& [status, count] : worker->stats().ops[i].statuses) {
+                merged[i].statuses[status] += count;
+            }
+        }
+    }
+
+    if (options.json) {
+        print_json(merged, elapsed_seconds, total_requests, late_sends, options);
+    } else {
+        print_text(merged, elapsed_seconds, total_requests, late_sends);
+    }
+    return 0;
+}
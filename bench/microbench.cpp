@@ -0,0 +1,389 @@
+// Microbenchmarks for the CPU work every request goes through: JSON parsing and
+// serialisation, route lookup, the middleware chain, metrics updates, flight recorder
+// events, order helpers and the cache value encodings. Encoding benchmarks also report the
+// size of one cache value.
+//
+// Each benchmark is calibrated so one repetition runs for roughly --min-time-ms, warmed
+// up, then timed for --repetitions rounds. The median and the median absolute deviation
+// (MAD) of the per-operation times are reported; both are robust to the occasional
+// preempted round that would skew a mean.
+//
+// Usage:
+//   microbench [--filter SUBSTR] [--repetitions 15] [--min-time-ms 50] [--warmup-ms 200]
+//              [--json] [--baseline previous.json] [--threshold 10]
+//
+// With --baseline, results are compared against an earlier --json run and the process
+// exits with status 1 if any benchmark's median got slower by more than --threshold
+// percent and by more than three MADs of either run.
+#include "crow_all.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/null_sink.h>
+#include "auth_middleware.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "middlewares.h"
+#include "order_codec.h"
+#include "order_utils.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+// Results are folded into this so the optimiser can't drop the measured work.
+volatile size_t sink = 0;
+
+struct Benchmark {
+    string name;
+    function<void(uint64_t iterations)> run;
+    size_t value_bytes = 0; // size of the value produced, for the encoding benchmarks
+};
+
+struct Result {
+    string name;
+    uint64_t iterations = 0;
+    double median_ns = 0;
+    double mad_ns = 0;
+    double min_ns = 0;
+};
+
+struct Options {
+    string filter;
+    int repetitions = 15;
+    double min_time_ms = 50;
+    double warmup_ms = 200;
+    bool json = false;
+    string baseline_path;
+    double threshold_percent = 10;
+};
+
+double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+double time_ns(const Benchmark& bench, uint64_t iterations) {
+    const auto start = Clock::now();
+    bench.run(iterations);
+    return chrono::duration<double, nano>(Clock::now() - start).count();
+}
+
+Result measure(const Benchmark& bench, const Options& options) {
+    // Grow the batch until it is long enough to time reliably, then scale to min_time.
+    const double target_ns = options.min_time_ms * 1e6;
+    uint64_t iterations = 1;
+    double elapsed = time_ns(bench, iterations);
+    while (elapsed < target_ns / 10 && iterations < (uint64_t{1} << 40)) {
+        iterations *= 10;
+        elapsed = time_ns(bench, iterations);
+    }
+    iterations = max<uint64_t>(1, static_cast<uint64_t>(iterations * target_ns / max(elapsed, 1.0)));
+
+    const auto warmup_end = Clock::now() + chrono::duration<double, milli>(options.warmup_ms);
+    while (Clock::now() < warmup_end) {
+        time_ns(bench, iterations);
+    }
+
+    vector<double> per_op;
+    per_op.reserve(options.repetitions);
+    for (int i = 0; i < options.repetitions; ++i) {
+        per_op.push_back(time_ns(bench, iterations) / static_cast<double>(iterations));
+    }
+
+    Result result;
+    result.name = bench.name;
+    result.iterations = iterations;
+    result.median_ns = median(per_op);
+    result.min_ns = *min_element(per_op.begin(), per_op.end());
+    vector<double> deviations;
+    for (const double v : per_op) {
+        deviations.push_back(fabs(v - result.median_ns));
+    }
+    result.mad_ns = median(deviations);
+    return result;
+}
+
+using AppMiddlewares = tuple<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware>;
+
+vector<Benchmark> make_benchmarks() {
+    vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"json_load_pay_body", [](uint64_t n) {
+        const string body = R"({"order_no": "ORD170000000012345", "amount": 129.99})";
+        for (uint64_t i = 0; i < n; ++i) {
+            auto parsed = crow::json::load(body);
+            sink = sink + static_cast<size_t>(parsed["amount"].d());
+        }
+    }});
+
+    benchmarks.push_back({"wvalue_dump_order", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            crow::json::wvalue order;
+            order["order_no"] = "ORD170000000012345";
+            order["amount"] = 129.99;
+            order["status"] = "PAID";
+            order["created_at"] = "2024-01-01 12:00:00";
+            order["paid_at"] = "2024-01-01 12:05:00";
+            sink = sink + order.dump().size();
+        }
+    }});
+
+    benchmarks.push_back({"trie_find_order_get", [](uint64_t n) {
+        // Same rule set as main.cpp, folded into a single trie.
+        static const crow::Trie trie = [] {
+            crow::Trie t;
+            uint16_t rule_index = 1;
+            for (const char* rule : {"/healthcheck", "/readiness", "/metrics", "/order/create", "/order/get/<string>",
+                                     "/order/pay", "/order/list", "/order/delete/<string>", "/order/export"}) {
+                t.add(rule, rule_index++);
+            }
+            t.validate();
+            return t;
+        }();
+        const string url = "/order/get/ORD170000000012345";
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + trie.find(url).rule_index;
+        }
+    }});
+
+    benchmarks.push_back({"middleware_chain", [](uint64_t n) {
+        AppMiddlewares middlewares;
+        crow::request req;
+        req.method = crow::HTTPMethod::Get;
+        req.url = "/order/get/ORD170000000012345";
+        req.headers.emplace("Authorization", runtime_config::api_key);
+        for (uint64_t i = 0; i < n; ++i) {
+            crow::response res;
+            crow::detail::context<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware> ctx;
+            crow::detail::middleware_call_helper<crow::detail::middleware_call_criteria_only_global, 0,
+                                                 decltype(ctx), AppMiddlewares>({}, middlewares, req, res, ctx);
+            res.code = 200;
+            crow::detail::after_handlers_call_helper<crow::detail::middleware_call_criteria_only_global,
+                                                     tuple_size<AppMiddlewares>::value - 1,
+                                                     decltype(ctx), AppMiddlewares>({}, middlewares, ctx, req, res);
+            res.notify_written();
+            sink = sink + res.code;
+        }
+    }});
+
+    benchmarks.push_back({"observe_request_duration_ms", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            metrics::observe_request_duration_ms(static_cast<int64_t>(i & 63));
+        }
+    }});
+
+    benchmarks.push_back({"flight_recorder_record", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            flight_recorder::record(flight_recorder::Type::CacheHit, 0, static_cast<uint32_t>(i));
+        }
+    }});
+
+    benchmarks.push_back({"generate_order_no", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + generate_order_no().size();
+        }
+    }});
+
+    benchmarks.push_back({"format_time", [](uint64_t n) {
+        const time_t t = 1700000000;
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + format_time(t + static_cast<time_t>(i & 1023)).size();
+        }
+    }});
+
+    // Same order in both cache formats: what Redis stores and ships per hit, and the cost of
+    // turning each back into the response body.
+    static const string order_no = "ORD170000000012345";
+    static const string json_value = order_json(order_no, 129.99, "PAID", 1700000000, 1700000300).dump();
+    static const string binary_value = [] {
+        order_codec::Order order;
+        order.amount = 129.99;
+        order.status = "PAID";
+        order.created_at = 1700000000;
+        order.paid_at = 1700000300;
+        return *order_codec::encode(order);
+    }();
+
+    benchmarks.push_back({"cache_encode_json", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + order_json(order_no, 129.99, "PAID", 1700000000, 1700000300).dump().size();
+        }
+    }, json_value.size()});
+
+    benchmarks.push_back({"cache_encode_binary", [](uint64_t n) {
+        order_codec::Order order;
+        order.amount = 129.99;
+        order.status = "PAID";
+        order.created_at = 1700000000;
+        order.paid_at = 1700000300;
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + order_codec::encode(order)->size();
+        }
+    }, binary_value.size()});
+
+    benchmarks.push_back({"cache_render_json", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + render_cached_order(order_no, json_value)->size();
+        }
+    }, json_value.size()});
+
+    benchmarks.push_back({"cache_render_binary", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            sink = sink + render_cached_order(order_no, binary_value)->size();
+        }
+    }, binary_value.size()});
+
+    return benchmarks;
+}
+
+bool load_baseline(const string& path, map<string, Result>& baseline) {
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    const auto doc = crow::json::load(buffer.str());
+    if (!doc || !doc.has("benchmarks")) {
+        return false;
+    }
+    for (const auto& entry : doc["benchmarks"]) {
+        Result result;
+        result.name = entry["name"].s();
+        result.median_ns = entry["median_ns"].d();
+        result.mad_ns = entry["mad_ns"].d();
+        baseline[result.name] = result;
+    }
+    return true;
+}
+
+void usage() {
+    cerr << "usage: microbench [--filter SUBSTR] [--repetitions N] [--min-time-ms MS] [--warmup-ms MS]\n"
+            "                  [--json] [--baseline FILE.json] [--threshold PERCENT]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--repetitions") {
+            options.repetitions = max(1, atoi(value.c_str()));
+        } else if (arg == "--min-time-ms") {
+            options.min_time_ms = max(1.0, atof(value.c_str()));
+        } else if (arg == "--warmup-ms") {
+            options.warmup_ms = max(0.0, atof(value.c_str()));
+        } else if (arg == "--baseline") {
+            options.baseline_path = value;
+        } else if (arg == "--threshold") {
+            options.threshold_percent = atof(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    map<string, Result> baseline;
+    if (!options.baseline_path.empty() && !load_baseline(options.baseline_path, baseline)) {
+        cerr << "Can't read baseline " << options.baseline_path << endl;
+        return 2;
+    }
+
+    // The logging middleware still formats its line; the null sink only drops the file I/O.
+    spdlog::set_default_logger(spdlog::null_logger_mt("microbench"));
+    crow::logger::setLogLevel(crow::LogLevel::Warning);
+    srand(42);
+    // Recording is on in the server by default, so the middleware chain pays for it here too.
+    flight_recorder::start(flight_recorder::Options{});
+
+    crow::json::wvalue out;
+    vector<crow::json::wvalue> entries;
+    int regressions = 0;
+    for (const auto& bench : make_benchmarks()) {
+        if (!options.filter.empty() && bench.name.find(options.filter) == string::npos) {
+            continue;
+        }
+        const Result result = measure(bench, options);
+
+        crow::json::wvalue entry;
+        entry["name"] = result.name;
+        entry["iterations"] = result.iterations;
+        entry["median_ns"] = result.median_ns;
+        entry["mad_ns"] = result.mad_ns;
+        entry["min_ns"] = result.min_ns;
+        if (bench.value_bytes > 0) {
+            entry["value_bytes"] = bench.value_bytes;
+        }
+
+        ostringstream line;
+        line.setf(ios::fixed);
+        line.precision(1);
+        line << bench.name << ": median " << result.median_ns << " ns/op, mad " << result.mad_ns
+             << " ns, min " << result.min_ns << " ns (" << result.iterations << " iters x " << options.repetitions << ")";
+        if (bench.value_bytes > 0) {
+            line << ", " << bench.value_bytes << " bytes/value";
+        }
+
+        const auto base = baseline.find(bench.name);
+        if (base != baseline.end() && base->second.median_ns > 0) {
+            const double delta = result.median_ns - base->second.median_ns;
+            const double delta_percent = delta / base->second.median_ns * 100.0;
+            const double noise = 3.0 * max(result.mad_ns, base->second.mad_ns);
+            const bool regressed = delta_percent > options.threshold_percent && delta > noise;
+            regressions += regressed ? 1 : 0;
+            entry["baseline_median_ns"] = base->second.median_ns;
+            entry["delta_percent"] = delta_percent;
+            entry["regression"] = regressed;
+            line << ", " << showpos << delta_percent << noshowpos << "% vs baseline" << (regressed ? " REGRESSION" : "");
+        }
+
+        if (!options.json) {
+            cout << line.str() << endl;
+        }
+        entries.push_back(move(entry));
+    }
+
+    if (options.json) {
+        out["repetitions"] = options.repetitions;
+        out["min_time_ms"] = options.min_time_ms;
+        out["benchmarks"] = move(entries);
+        if (!baseline.empty()) {
+            out["threshold_percent"] = options.threshold_percent;
+            out["regressions"] = regressions;
+        }
+        cout << out.dump() << endl;
+    } else if (!baseline.empty()) {
+        cout << regressions << " regression(s) beyond " << options.threshold_percent << "%" << endl;
+    }
+    flight_recorder::stop();
+    return regressions > 0 ? 1 : 0;
+}
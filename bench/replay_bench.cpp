@@ -0,0 +1,336 @@
+// In-process replay benchmark for the full request path.
+//
+// Builds the real OrderApp (router, middleware chain and handlers) against a scratch SQLite
+// file and an in-process cache standing in for Redis, behind the same circuit breaker. It
+// then feeds pre-parsed crow::request objects straight into it from several threads. There are no sockets and no HTTP parsing,
+// so the numbers are the CPU cost of routing, middleware, handlers, SQLite and JSON alone.
+//
+// For every endpoint all threads replay their requests concurrently; throughput is the
+// total over wall time, and allocations per request come from the server's counting
+// operator new (src/alloc_stats.cpp).
+//
+// Usage:
+//   replay_bench [--threads 4] [--requests 2000] [--orders 1000] [--db replay_bench.db]
+//                [--durable] [--json]
+//
+// --requests is per thread and per endpoint. By default the scratch database runs with
+// synchronous=OFF so fsync latency does not drown out CPU cost; --durable keeps the
+// server's default journaling.
+#include "crow_all.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/null_sink.h>
+#include "alloc_stats.h"
+#include "cache_breaker.h"
+#include "order_app.h"
+#include "order_cache.h"
+#include "order_schema.h"
+#include "runtime_config.h"
+#include "service_state.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+sqlite3* db = nullptr;
+order_cache::Backend* cache = nullptr;
+
+namespace {
+using AppMiddlewares = tuple<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware>;
+using AppContext = crow::detail::context<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware>;
+
+struct Options {
+    int threads = 4;
+    int requests = 2000;
+    int orders = 1000;
+    string db_path = "replay_bench.db";
+    bool durable = false;
+    bool json = false;
+};
+
+struct EndpointResult {
+    string name;
+    uint64_t requests = 0;
+    uint64_t non_2xx = 0;
+    double seconds = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+};
+
+// Mirrors Connection::handle/complete_request: route, before handlers, handler, after handlers.
+int dispatch(OrderApp& app, AppMiddlewares& middlewares, crow::request& req) {
+    crow::response res;
+    AppContext ctx;
+    req.middleware_context = &ctx;
+    req.middleware_container = &middlewares;
+
+    auto found = app.handle_initial(req, res);
+    if (!found->rule_index) {
+        return res.code;
+    }
+
+    crow::detail::middleware_call_helper<crow::detail::middleware_call_criteria_only_global,
+                                         0, AppContext, AppMiddlewares>({}, middlewares, req, res, ctx);
+    if (!res.is_completed()) {
+        app.handle(req, res, found);
+        crow::detail::after_handlers_call_helper<crow::detail::middleware_call_criteria_only_global,
+                                                 tuple_size<AppMiddlewares>::value - 1,
+                                                 AppContext, AppMiddlewares>({}, middlewares, ctx, req, res);
+        res.notify_written();
+    }
+    return res.code;
+}
+
+crow::request make_request(crow::HTTPMethod method, const string& raw_url, const string& body = "") {
+    crow::request req;
+    req.method = method;
+    req.raw_url = raw_url;
+    req.url = raw_url.substr(0, raw_url.find('?'));
+    req.url_params = crow::query_string(raw_url);
+    req.body = body;
+    req.headers.emplace("Authorization", runtime_config::api_key);
+    req.headers.emplace("Content-Type", "application/json");
+    req.headers.emplace("Host", "localhost");
+    return req;
+}
+
+string order_no_for(const char* pool, int index) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "ORDBENCH%s%09d", pool, index);
+    return buf;
+}
+
+bool exec_sql(const string& sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        cerr << "SQL error: " << (err_msg ? err_msg : sqlite3_errmsg(db)) << endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
+bool seed_pool(const char* pool, int count, bool half_paid) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT INTO orders (order_no, amount, status, created_at, paid_at) VALUES (?, ?, ?, ?, ?);",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    const int64_t now = time(nullptr);
+    exec_sql("BEGIN;");
+    for (int i = 0; i < count; ++i) {
+        const bool paid = half_paid && i % 2 == 1;
+        const string order_no = order_no_for(pool, i);
+        sqlite3_bind_text(stmt, 1, order_no.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 2, 10.0 + i % 1000);
+        sqlite3_bind_text(stmt, 3, paid ? "PAID" : "PENDING", -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, now - i);
+        sqlite3_bind_int64(stmt, 5, paid ? now : 0);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return exec_sql("COMMIT;");
+}
+
+bool open_db(const Options& options) {
+    for (const char* suffix : {"", "-journal", "-wal", "-shm"}) {
+        remove((options.db_path + suffix).c_str());
+    }
+    if (sqlite3_open(options.db_path.c_str(), &db) != SQLITE_OK) {
+        cerr << "Can't open DB: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    sqlite3_busy_timeout(db, 5000);
+    if (!options.durable && !exec_sql("PRAGMA synchronous = OFF; PRAGMA journal_mode = MEMORY;")) {
+        return false;
+    }
+    if (!exec_sql(order_schema::create_orders_table_sql() + order_schema::create_orders_indexes_sql())) {
+        return false;
+    }
+    const int per_pool = options.threads * options.requests;
+    return seed_pool("G", options.orders, true) && seed_pool("P", per_pool, false) && seed_pool("D", per_pool, false);
+}
+
+// Builds requests[thread][i] for one endpoint; make(thread, i) returns the request.
+template<typename Make>
+vector<vector<crow::request>> build_requests(const Options& options, Make make) {
+    vector<vector<crow::request>> requests(options.threads);
+    for (int t = 0; t < options.threads; ++t) {
+        requests[t].reserve(options.requests);
+        for (int i = 0; i < options.requests; ++i) {
+            requests[t].push_back(make(t, i));
+        }
+    }
+    return requests;
+}
+
+EndpointResult replay(const string& name, OrderApp& app, vector<vector<crow::request>> requests) {
+    EndpointResult result;
+    result.name = name;
+    atomic<uint64_t> non_2xx{0};
+    atomic<int> ready{0};
+    atomic<bool> go{false};
+
+    vector<thread> threads;
+    for (auto& batch : requests) {
+        threads.emplace_back([&app, &batch, &non_2xx, &ready, &go] {
+            AppMiddlewares middlewares;
+            ready.fetch_add(1);
+            while (!go.load()) {
+                this_thread::yield();
+            }
+            uint64_t failures = 0;
+            for (auto& req : batch) {
+                const int code = dispatch(app, middlewares, req);
+                failures += (code < 200 || code >= 300) ? 1 : 0;
+            }
+            non_2xx.fetch_add(failures);
+        });
+        result.requests += batch.size();
+    }
+
+    while (ready.load() < static_cast<int>(threads.size())) {
+        this_thread::yield();
+    }
+    // Storage runs inline on the replay threads and the main thread only waits, so the
+    // process-wide counts over the run are the requests' own.
+    const auto heap_before = alloc_stats::totals();
+    const auto start = Clock::now();
+    go.store(true);
+    for (auto& t : threads) {
+        t.join();
+    }
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    const auto heap_after = alloc_stats::totals();
+    result.non_2xx = non_2xx.load();
+    result.allocations = heap_after.allocations - heap_before.allocations;
+    result.allocated_bytes = heap_after.allocated_bytes - heap_before.allocated_bytes;
+    return result;
+}
+
+void usage() {
+    cerr << "usage: replay_bench [--threads N] [--requests N] [--orders N] [--db FILE] [--durable] [--json]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (arg == "--durable") {
+            options.durable = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        if (arg == "--threads") {
+            options.threads = max(1, atoi(value.c_str()));
+        } else if (arg == "--requests") {
+            options.requests = max(1, atoi(value.c_str()));
+        } else if (arg == "--orders") {
+            options.orders = max(1, atoi(value.c_str()));
+        } else if (arg == "--db") {
+            options.db_path = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    // Handlers still format their log lines; the null sink only drops the file I/O.
+    spdlog::set_default_logger(spdlog::null_logger_mt("replay_bench"));
+    crow::logger::setLogLevel(crow::LogLevel::Warning);
+    srand(static_cast<unsigned>(time(nullptr)));
+
+    if (!open_db(options)) {
+        return 1;
+    }
+    order_cache::InMemoryBackend in_process_cache;
+    cache = cache_breaker::start(&in_process_cache, metrics::cache_nodes.emplace_back("in-process"), {});
+    service_state::db_ready.store(true);
+    service_state::redis_available.store(true);
+    service_state::max_inflight_requests.store(1 << 20);
+
+    OrderApp app;
+    register_routes(app);
+    app.validate();
+
+    const int orders = options.orders;
+    vector<EndpointResult> results;
+    results.push_back(replay("healthcheck", app, build_requests(options, [](int, int) {
+        return make_request(crow::HTTPMethod::Get, "/healthcheck");
+    })));
+    results.push_back(replay("create", app, build_requests(options, [](int, int i) {
+        return make_request(crow::HTTPMethod::Post, "/order/create", "{\"amount\": " + to_string(10 + i % 500) + ".5}");
+    })));
+    results.push_back(replay("get", app, build_requests(options, [orders](int t, int i) {
+        return make_request(crow::HTTPMethod::Get, "/order/get/" + order_no_for("G", (t * 7919 + i) % orders));
+    })));
+    results.push_back(replay("list_paid", app, build_requests(options, [](int, int) {
+        return make_request(crow::HTTPMethod::Get, "/order/list?status=PAID");
+    })));
+    results.push_back(replay("pay", app, build_requests(options, [&options](int t, int i) {
+        return make_request(crow::HTTPMethod::Post, "/order/pay",
+                            "{\"order_no\": \"" + order_no_for("P", t * options.requests + i) + "\"}");
+    })));
+    results.push_back(replay("delete", app, build_requests(options, [&options](int t, int i) {
+        return make_request(crow::HTTPMethod::Delete, "/order/delete/" + order_no_for("D", t * options.requests + i));
+    })));
+    results.push_back(replay("metrics", app, build_requests(options, [](int, int) {
+        return make_request(crow::HTTPMethod::Get, "/metrics");
+    })));
+
+    if (options.json) {
+        crow::json::wvalue out;
+        out["threads"] = options.threads;
+        out["requests_per_thread"] = options.requests;
+        out["durable"] = options.durable;
+        for (const auto& r : results) {
+            auto& entry = out["endpoints"][r.name];
+            entry["requests"] = r.requests;
+            entry["non_2xx"] = r.non_2xx;
+            entry["requests_per_second"] = r.requests / r.seconds;
+            entry["allocations_per_request"] = static_cast<double>(r.allocations) / r.requests;
+            entry["allocated_bytes_per_request"] = static_cast<double>(r.allocated_bytes) / r.requests;
+        }
+        cout << out.dump() << endl;
+    } else {
+        cout << options.threads << " threads x " << options.requests << " requests per endpoint"
+             << (options.durable ? " (durable)" : "") << "\n";
+        for (const auto& r : results) {
+            cout << r.name << ": " << static_cast<int64_t>(r.requests / r.seconds) << " req/s, "
+                 << static_cast<double>(r.allocations) / r.requests << " allocs/req, "
+                 << r.allocated_bytes / r.requests << " bytes/req";
+            if (r.non_2xx > 0) {
+                cout << ", non-2xx " << r.non_2xx;
+            }
+            cout << "\n";
+        }
+    }
+
+    cache_breaker::stop();
+    sqlite3_close(db);
+    return 0;
+}
@@ -336,6 +336,25 @@ namespace crow
             return *this;
         }
 
+        /// \brief Accept on a socket that is already bound and listening (e.g. handed over by another process) instead of binding port()
+        self_t& listen_fd(int fd)
+        {
+            listen_fd_ = fd;
+            return *this;
+        }
+
+        /// \brief Get the native handle of the listening socket, or -1 before the server has started
+        int native_listen_handle()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                return ssl_server_ ? ssl_server_->native_listen_handle() : -1;
+            }
+#endif
+            return server_ ? server_->native_listen_handle() : -1;
+        }
+
         /// \brief The IP address that Crow will handle requests on (default is 0.0.0.0)
         self_t& bindaddr(std::string bindaddr)
         {
@@ -517,7 +536,7 @@ namespace crow
             if (ssl_used_)
             {
                 router_.using_ssl = true;
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_, listen_fd_)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
                 ssl_server_->signal_clear();
                 for (auto snum : signals_)
@@ -530,7 +549,7 @@ namespace crow
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, listen_fd_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
                 for (auto snum : signals_)
                 {
@@ -552,6 +571,33 @@ namespace crow
             });
         }
 
+        /// \brief Per I/O worker thread: open connections and pending connection deadlines; empty until the server runs
+        std::vector<io_thread_stats> io_threads()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                return ssl_server_ ? ssl_server_->io_threads() : std::vector<io_thread_stats>{};
+            }
+#endif
+            return server_ ? server_->io_threads() : std::vector<io_thread_stats>{};
+        }
+
+        /// \brief Stop taking new connections; open connections keep being served until stop()
+        void stop_accepting()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                if (ssl_server_) { ssl_server_->stop_accepting(); }
+            }
+            else
+#endif
+            {
+                if (server_) { server_->stop_accepting(); }
+            }
+        }
+
         /// \brief Stop the server
         void stop()
         {
@@ -763,6 +809,7 @@ namespace crow
         uint64_t max_payload_{UINT64_MAX};
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
+        int listen_fd_ = -1;
         size_t res_stream_threshold_ = 1048576;
         Router router_;
         bool static_routes_added_{false};
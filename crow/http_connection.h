@@ -42,6 +42,55 @@ namespace crow
     static std::atomic<int> connectionCount;
 #endif
 
+    /// HTTP connections currently open, across every server in the process
+    inline std::atomic<int> open_connections{0};
+
+    /// Running totals across every server in the process, for metrics
+    struct connection_totals
+    {
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> closed{0};
+        std::atomic<uint64_t> requests{0};
+        /// Requests after the first on a keep-alive connection
+        std::atomic<uint64_t> reused{0};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+        /// Connections dropped because the request could not be parsed
+        std::atomic<uint64_t> parse_errors{0};
+    };
+    inline connection_totals connection_stats;
+
+    /// Optional callbacks around the work a connection does for a request on its I/O thread:
+    /// the middlewares and handler, then the after handlers. Parsing the request comes before
+    /// either. `leave` gets what `enter` returned. Set before the server starts.
+    struct request_scope_hooks
+    {
+        void* (*enter)(const request&) = nullptr;
+        void (*leave)(void*) = nullptr;
+    };
+    inline request_scope_hooks request_scope;
+
+    namespace detail
+    {
+        struct request_scope_guard
+        {
+            explicit request_scope_guard(const request& req):
+              token(request_scope.enter != nullptr ? request_scope.enter(req) : nullptr)
+            {}
+
+            ~request_scope_guard()
+            {
+                if (request_scope.leave != nullptr)
+                    request_scope.leave(token);
+            }
+
+            request_scope_guard(const request_scope_guard&) = delete;
+            request_scope_guard& operator=(const request_scope_guard&) = delete;
+
+            void* token;
+        };
+    } // namespace detail
+
     /// An HTTP connection.
     template<typename Adaptor, typename Handler, typename... Middlewares>
     class Connection : public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>
@@ -77,6 +126,12 @@ namespace crow
 
         ~Connection()
         {
+            if (started_)
+            {
+                open_connections--;
+                queue_length_--;
+                connection_stats.closed.fetch_add(1, std::memory_order_relaxed);
+            }
 #ifdef CROW_ENABLE_DEBUG
             connectionCount--;
             CROW_LOG_DEBUG << "Connection (" << this << ") freed, total: " << connectionCount;
@@ -91,6 +146,10 @@ namespace crow
 
         void start()
         {
+            // Counted from here: the server keeps one unaccepted connection waiting on the acceptor
+            started_ = true;
+            open_connections++;
+            connection_stats.accepted.fetch_add(1, std::memory_order_relaxed);
             auto self = this->shared_from_this();
             adaptor_.start([self](const error_code& ec) {
                 if (!ec)
@@ -138,12 +197,16 @@ namespace crow
             cancel_deadline_timer();
             bool is_invalid_request = false;
             add_keep_alive_ = false;
+            connection_stats.requests.fetch_add(1, std::memory_order_relaxed);
+            if (requests_handled_++ > 0)
+                connection_stats.reused.fetch_add(1, std::memory_order_relaxed);
 
             // Create context
             ctx_ = detail::context<Middlewares...>();
             req_.middleware_context = static_cast<void*>(&ctx_);
             req_.middleware_container = static_cast<void*>(middlewares_);
             req_.io_context = &adaptor_.get_io_context();
+            detail::request_scope_guard scope(req_);
 
             req_.remote_ip_address = adaptor_.remote_endpoint().address().to_string();
 
@@ -216,12 +279,15 @@ namespace crow
         /// Call the after handle middleware and send the write the response to the connection.
         void complete_request()
         {
+            // When a handler completes asynchronously, the handler that prepare_buffers() clears holds the last reference
+            auto self = this->shared_from_this();
             CROW_LOG_INFO << "Response: " << this << ' ' << req_.raw_url << ' ' << res.code << ' ' << close_connection_;
             res.is_alive_helper_ = nullptr;
 
             if (need_to_call_after_handlers_)
             {
                 need_to_call_after_handlers_ = false;
+                detail::request_scope_guard scope(req_);
 
                 // call all after_handler of middlewares
                 detail::after_handlers_call_helper<
@@ -230,6 +296,13 @@ namespace crow
                   decltype(ctx_),
                   decltype(*middlewares_)>({}, *middlewares_, ctx_, req_, res);
             }
+
+            // A response (or an after handler) asking for "Connection: close" ends keep-alive
+            if (utility::string_equals(res.get_header_value("connection"), "close"))
+            {
+                close_connection_ = true;
+                add_keep_alive_ = false;
+            }
 #ifdef CROW_ENABLE_COMPRESSION
             if (!res.body.empty() && handler_->compression_used())
             {
@@ -265,6 +338,10 @@ namespace crow
             {
                 do_write_static();
             }
+            else if (res.is_stream_type())
+            {
+                do_write_stream();
+            }
             else
             {
                 do_write_general();
@@ -357,7 +434,7 @@ namespace crow
                 buffers_.emplace_back(crlf.data(), crlf.size());
             }
 
-            if (!res.manual_length_header && !res.headers.count("content-length"))
+            if (!res.manual_length_header && !res.headers.count("content-length") && !res.is_stream_type())
             {
                 content_length_ = std::to_string(res.body.size());
                 static std::string content_length_tag = "Content-Length: ";
@@ -392,7 +469,7 @@ namespace crow
 
         void do_write_static()
         {
-            asio::write(adaptor_.socket(), buffers_);
+            count_sent(asio::write(adaptor_.socket(), buffers_));
 
             if (res.file_info.statResult == 0)
             {
@@ -407,6 +484,7 @@ namespace crow
                     is.read(buf, sizeof(buf));
                 }
             }
+            res.notify_written();
             if (close_connection_)
             {
                 adaptor_.shutdown_readwrite();
@@ -420,6 +498,93 @@ namespace crow
             parser_.clear();
         }
 
+        /// Write the headers, then one chunk at a time: the source is only asked for the next chunk
+        /// once the socket has taken the previous one. Every write runs under the connection
+        /// deadline, so a client that stops reading is disconnected instead of holding the
+        /// stream open, and the I/O thread serves other connections in between.
+        void do_write_stream()
+        {
+            streaming_ = true;
+            start_deadline();
+            auto self = this->shared_from_this();
+            asio::async_write(
+              adaptor_.socket(), buffers_,
+              [self](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  if (ec)
+                      self->finish_stream(ec);
+                  else
+                      self->write_next_chunk();
+              });
+        }
+
+        void write_next_chunk()
+        {
+            static const std::string last_chunk = "0\r\n\r\n";
+            stream_chunk_.clear();
+            bool more = adaptor_.is_open();
+            while (more && stream_chunk_.empty())
+            {
+                more = res.body_source_(stream_chunk_);
+            }
+
+            buffers_.clear();
+            if (!stream_chunk_.empty())
+            {
+                const int size_line_length = snprintf(stream_size_line_, sizeof(stream_size_line_), "%zx\r\n", stream_chunk_.size());
+                buffers_.emplace_back(stream_size_line_, size_line_length);
+                buffers_.emplace_back(stream_chunk_.data(), stream_chunk_.size());
+                buffers_.emplace_back(crlf.data(), crlf.size());
+            }
+            if (!more)
+            {
+                buffers_.emplace_back(last_chunk.data(), last_chunk.size());
+            }
+
+            start_deadline();
+            auto self = this->shared_from_this();
+            asio::async_write(
+              adaptor_.socket(), buffers_,
+              [self, more](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  if (!ec && more)
+                      self->write_next_chunk();
+                  else
+                      self->finish_stream(ec);
+              });
+        }
+
+        void finish_stream(const error_code& ec)
+        {
+            cancel_deadline_timer();
+            streaming_ = false;
+            res.notify_written();
+            if (ec)
+            {
+                CROW_LOG_ERROR << ec << " - happened while streaming response";
+                close_connection_ = true;
+            }
+            if (close_connection_)
+            {
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                CROW_LOG_DEBUG << this << " from write (stream)";
+            }
+
+            res.end();
+            res.clear();
+            buffers_.clear();
+            stream_chunk_.clear();
+            parser_.clear();
+
+            if (need_to_start_read_after_complete_ && !close_connection_)
+            {
+                need_to_start_read_after_complete_ = false;
+                start_deadline();
+                do_read();
+            }
+        }
+
         void do_write_general()
         {
             if (res.body.length() < res_stream_threshold_)
@@ -428,6 +593,7 @@ namespace crow
                 buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
 
                 do_write_sync(buffers_);
+                res.notify_written();
 
                 if (need_to_start_read_after_complete_)
                 {
@@ -438,7 +604,7 @@ namespace crow
             }
             else
             {
-                asio::write(adaptor_.socket(), buffers_); // Write the response start / headers
+                count_sent(asio::write(adaptor_.socket(), buffers_)); // Write the response start / headers
                 cancel_deadline_timer();
                 if (res.body.length() > 0)
                 {
@@ -453,6 +619,7 @@ namespace crow
                         transferred += to_transfer;
                     }
                 }
+                res.notify_written();
                 if (close_connection_)
                 {
                     adaptor_.shutdown_readwrite();
@@ -476,11 +643,16 @@ namespace crow
                   bool error_while_reading = true;
                   if (!ec)
                   {
+                      connection_stats.bytes_in.fetch_add(bytes_transferred, std::memory_order_relaxed);
                       bool ret = self->parser_.feed(self->buffer_.data(), bytes_transferred);
                       if (ret && self->adaptor_.is_open())
                       {
                           error_while_reading = false;
                       }
+                      else if (!ret)
+                      {
+                          connection_stats.parse_errors.fetch_add(1, std::memory_order_relaxed);
+                      }
                   }
 
                   if (error_while_reading)
@@ -491,6 +663,11 @@ namespace crow
                       self->adaptor_.close();
                       CROW_LOG_DEBUG << self << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(self->parser_.http_errno)) << '\"';
                   }
+                  else if (self->streaming_)
+                  {
+                      // The stream owns the deadline; reading resumes once it has been written
+                      self->need_to_start_read_after_complete_ = true;
+                  }
                   else if (self->close_connection_)
                   {
                       self->cancel_deadline_timer();
@@ -515,7 +692,9 @@ namespace crow
             auto self = this->shared_from_this();
             asio::async_write(
               adaptor_.socket(), buffers_,
-              [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
+              [self](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  self->res.notify_written();
                   self->res.clear();
                   self->res_body_copy_.clear();
                   if (!self->continue_requested)
@@ -546,7 +725,7 @@ namespace crow
         inline void do_write_sync(std::vector<asio::const_buffer>& buffers)
         {
             error_code ec;
-            asio::write(adaptor_.socket(), buffers, ec);
+            count_sent(asio::write(adaptor_.socket(), buffers, ec));
 
             this->res.clear();
             this->res_body_copy_.clear();
@@ -566,6 +745,11 @@ namespace crow
             }
         }
 
+        void count_sent(std::size_t bytes)
+        {
+            connection_stats.bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
         void cancel_deadline_timer()
         {
             CROW_LOG_DEBUG << this << " timer cancelled: " << &task_timer_ << ' ' << task_id_;
@@ -614,6 +798,10 @@ namespace crow
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
+        bool streaming_{};
+
+        std::string stream_chunk_;
+        char stream_size_line_[24];
 
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
@@ -624,6 +812,8 @@ namespace crow
         size_t res_stream_threshold_;
 
         std::atomic<unsigned int>& queue_length_;
+        bool started_ = false;
+        unsigned int requests_handled_ = 0;
     };
 
 } // namespace crow
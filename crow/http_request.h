@@ -49,6 +49,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         void* middleware_context{};
         void* middleware_container{};
         asio::io_context* io_context{};
+        /// The rule the router matched (e.g. `/order/get/<string>`), or null before routing or if none did.
+        const std::string* matched_rule{};
 
         /// Construct an empty request. (sets the method to `GET`)
         request():
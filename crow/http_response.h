@@ -47,6 +47,14 @@ namespace crow
         bool skip_body = false;            ///< Whether this is a response to a HEAD request.
         bool manual_length_header = false; ///< Whether Crow should automatically add a "Content-Length" header.
 
+        /// Pull-based body producer used for chunked streaming responses.
+
+        ///
+        /// The source appends the next piece of the body to the buffer it is given and returns false once it has
+        /// nothing more to produce. Each piece is sent as one HTTP chunk, and the source is only asked for more data
+        /// after the socket has accepted the previous chunk. It runs on the connection's I/O thread.
+        using body_source_t = std::function<bool(std::string&)>;
+
         /// Set the value of an existing header in the response.
         void set_header(std::string key, std::string value)
         {
@@ -170,6 +178,7 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            body_source_ = std::move(r.body_source_);
             return *this;
         }
 
@@ -186,6 +195,7 @@ namespace crow
             headers.clear();
             completed_ = false;
             file_info = static_file_info{};
+            body_source_ = nullptr;
         }
 
         /// Return a "Temporary Redirect" response.
@@ -261,6 +271,23 @@ namespace crow
             end();
         }
 
+        /// Run `handler` once the connection has written this response, or given up writing it.
+        void on_written(std::function<void()> handler)
+        {
+            written_handler_ = std::move(handler);
+        }
+
+        /// Called by the connection after the last write of this response; runs the on_written handler once.
+        void notify_written()
+        {
+            if (written_handler_)
+            {
+                auto handler = std::move(written_handler_);
+                written_handler_ = nullptr;
+                handler();
+            }
+        }
+
         /// Check if the connection is still alive (usually by checking the socket status).
         bool is_alive()
         {
@@ -318,10 +345,30 @@ namespace crow
             }
         }
 
+        /// Check whether the response body is produced by a streaming source.
+        bool is_stream_type()
+        {
+            return static_cast<bool>(body_source_);
+        }
+
+        /// Stream the response body from a source using chunked transfer encoding.
+        void set_body_source(body_source_t source)
+        {
+            body_source_ = std::move(source);
+            body.clear();
+#ifdef CROW_ENABLE_COMPRESSION
+            compressed = false;
+#endif
+            set_header("Transfer-Encoding", "chunked");
+            headers.erase("Content-Length");
+        }
+
     private:
         bool completed_{};
         std::function<void()> complete_request_handler_;
         std::function<bool()> is_alive_helper_;
         static_file_info file_info;
+        body_source_t body_source_;
+        std::function<void()> written_handler_;
     };
 } // namespace crow
@@ -22,6 +22,10 @@
 #include <memory>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
 #include "crow/version.h"
 #include "crow/http_connection.h"
 #include "crow/logging.h"
@@ -38,6 +42,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 #endif
     using tcp = asio::ip::tcp;
 
+    /// One I/O worker thread of a server, for metrics
+    struct io_thread_stats
+    {
+        /// Connections assigned to the thread and not yet closed
+        unsigned int connections;
+        /// Connection deadlines its task_timer holds
+        size_t pending_timeouts;
+    };
+
     template<typename Handler, typename Adaptor = SocketAdaptor, typename... Middlewares>
     class Server
     {
@@ -48,15 +61,17 @@ namespace crow // NOTE: Already documented in "crow/app.h"
              std::tuple<Middlewares...>* middlewares = nullptr,
              uint16_t concurrency = 1,
              uint8_t timeout = 5,
-             typename Adaptor::context* adaptor_ctx = nullptr):
-          acceptor_(io_context_,endpoint),
+             typename Adaptor::context* adaptor_ctx = nullptr,
+             int listen_fd = -1):
+          // A listen_fd that is already bound and listening (e.g. inherited from another process) replaces binding endpoint
+          task_queue_length_pool_(concurrency - 1),
+          acceptor_(listen_fd < 0 ? tcp::acceptor(io_context_, endpoint) : tcp::acceptor(io_context_, endpoint.protocol(), listen_fd)),
           signals_(io_context_),
           tick_timer_(io_context_),
           handler_(handler),
           concurrency_(concurrency),
           timeout_(timeout),
           server_name_(server_name),
-          task_queue_length_pool_(concurrency_ - 1),
           middlewares_(middlewares),
           adaptor_ctx_(adaptor_ctx)
         {}
@@ -122,8 +137,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                         // initializing task timers
                         detail::task_timer task_timer(*io_context_pool_[i]);
                         task_timer.set_default_timeout(timeout_);
-                        task_timer_pool_[i] = &task_timer;
+                        {
+                            std::lock_guard<std::mutex> lock(task_timer_mutex_);
+                            task_timer_pool_[i] = &task_timer;
+                        }
                         task_queue_length_pool_[i] = 0;
+#ifdef __linux__
+                        // Named so per-thread CPU time can be told apart (at most 15 characters)
+                        pthread_setname_np(pthread_self(), ("crow-io-" + std::to_string(i)).c_str());
+#endif
 
                         init_count++;
                         while (1)
@@ -141,6 +163,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                                 CROW_LOG_ERROR << "Worker Crash: An uncaught exception occurred: " << e.what();
                             }
                         }
+
+                        // task_timer lives on this stack; unpublish it before it unwinds
+                        std::lock_guard<std::mutex> lock(task_timer_mutex_);
+                        task_timer_pool_[i] = nullptr;
                     }));
 
             if (tick_function_ && tick_interval_.count() > 0)
@@ -181,6 +207,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
               .join();
         }
 
+        /// Close the listening socket but keep serving the connections that are already open.
+        void stop_accepting()
+        {
+            asio::post(io_context_, [this] {
+                shutting_down_ = true;
+                error_code ec;
+                acceptor_.close(ec);
+            });
+        }
+
         void stop()
         {
             shutting_down_ = true; // Prevent the acceptor from taking new connections
@@ -201,6 +237,27 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             return acceptor_.local_endpoint().port();
         }
 
+        /// Per I/O worker thread, once run() has started them; empty before, and after they exit
+        std::vector<io_thread_stats> io_threads() const
+        {
+            std::vector<io_thread_stats> threads;
+            if (!server_started_)
+                return threads;
+            std::lock_guard<std::mutex> lock(task_timer_mutex_);
+            for (size_t i = 0; i < task_timer_pool_.size(); i++)
+            {
+                if (task_timer_pool_[i] == nullptr)
+                    return {};
+                threads.push_back({task_queue_length_pool_[i].load(), task_timer_pool_[i]->pending()});
+            }
+            return threads;
+        }
+
+        int native_listen_handle()
+        {
+            return static_cast<int>(acceptor_.native_handle());
+        }
+
         /// Wait until the server has properly started or until timeout
         std::cv_status wait_for_start(std::chrono::steady_clock::time_point wait_until)
         {
@@ -257,6 +314,9 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                   [this, p, &ic, context_idx](error_code ec) {
                       if (!ec)
                       {
+                          // Responses are written in one go, so Nagle only adds a delayed-ACK stall on keep-alive connections
+                          error_code nodelay_ec;
+                          p->socket().set_option(tcp::no_delay(true), nodelay_ec);
                           asio::post(ic,
                             [p] {
                                 p->start();
@@ -281,13 +341,18 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
     private:
+        // Declared first so it outlives io_context_pool_: connections still queued there when
+        // the server is destroyed decrement their thread's count
+        std::vector<std::atomic<unsigned int>> task_queue_length_pool_;
         std::vector<std::unique_ptr<asio::io_context>> io_context_pool_;
         asio::io_context io_context_;
+        // Entries point into the I/O threads' stacks and are cleared as those threads exit
         std::vector<detail::task_timer*> task_timer_pool_;
+        mutable std::mutex task_timer_mutex_;
         std::vector<std::function<std::string()>> get_cached_date_str_pool_;
         tcp::acceptor acceptor_;
         bool shutting_down_ = false;
-        bool server_started_{false};
+        std::atomic<bool> server_started_{false};
         std::condition_variable cv_started_;
         std::mutex start_mutex_;
         asio::signal_set signals_;
@@ -298,7 +363,6 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         uint16_t concurrency_{2};
         std::uint8_t timeout_;
         std::string server_name_;
-        std::vector<std::atomic<unsigned int>> task_queue_length_pool_;
 
         std::chrono::milliseconds tick_interval_;
         std::function<void()> tick_function_;
@@ -1693,6 +1693,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             }
 
             CROW_LOG_DEBUG << "Matched rule '" << rules[rule_index]->rule_ << "' " << static_cast<uint32_t>(req.method) << " / " << rules[rule_index]->get_methods();
+            req.matched_rule = &rules[rule_index]->rule_;
 
             try
             {
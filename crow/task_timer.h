@@ -11,6 +11,7 @@
 #include <asio/basic_waitable_timer.hpp>
 #endif
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <map>
@@ -62,6 +63,7 @@ namespace crow
             void cancel(identifier_type id)
             {
                 tasks_.erase(id);
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
                 CROW_LOG_DEBUG << "task_timer task cancelled: " << this << ' ' << id;
             }
 
@@ -92,6 +94,7 @@ namespace crow
                 tasks_.insert({++highest_id_,
                                {clock_type::now() + (timeout * tick_length_ms_),
                                 task}});
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
                 CROW_LOG_DEBUG << "task_timer scheduled: " << this << ' ' <<
                                   highest_id_;
                 return highest_id_;
@@ -118,6 +121,11 @@ namespace crow
                 return tick_length_ms_;
             }
 
+            /// Tasks scheduled and not yet run or cancelled; safe to read from any thread.
+            size_t pending() const {
+                return pending_.load(std::memory_order_relaxed);
+            }
+
         private:
             void process_tasks()
             {
@@ -137,6 +145,7 @@ namespace crow
 
                 for (const auto& task : finished_tasks)
                     tasks_.erase(task);
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
 
                 // If no task is currently scheduled, reset the issued ids back
                 // to 0.
@@ -158,6 +167,7 @@ namespace crow
             asio::io_context& io_context_;
             asio::basic_waitable_timer<clock_type> timer_;
             std::map<identifier_type, std::pair<time_type, task_type>> tasks_;
+            std::atomic<size_t> pending_{0};
 
             // A continuously increasing number to be issued to threads to
             // identify them. If no tasks are scheduled, it will be reset to 0.
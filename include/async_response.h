@@ -0,0 +1,22 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "crow_all.h"
+
+// Completes `res` from any thread. Crow's connection must only be touched from its own I/O
+// thread, so a response produced elsewhere is posted back there. Without an io_context
+// (in-process benchmarks) the request completes inline.
+inline void complete_response(const crow::request& req, crow::response& res, crow::response result) {
+    if (req.io_context == nullptr) {
+        res = std::move(result);
+        res.end();
+        return;
+    }
+    auto finished = std::make_shared<crow::response>(std::move(result));
+    asio::post(*req.io_context, [&res, finished] {
+        res = std::move(*finished);
+        res.end();
+    });
+}
@@ -1,18 +1,25 @@
 #pragma once
 #include "crow_all.h"
+#include "middlewares.h"
+#include "request_trace.h"
 #include "runtime_config.h"
 #include "service_state.h"
 
 struct AuthMiddleware {
     struct context {};
 
-    void before_handle(crow::request& req, crow::response& res, context&) {
+    template<typename AllContext>
+    void before_handle(crow::request& req, crow::response& res, context&, AllContext& all_ctx) {
         if (service_state::is_probe_path(req.url)) {
             return;
         }
+        request_trace::Timer auth(request_trace::Stage::Auth, &middleware_trace(all_ctx));
 
+        // The profiler exposes the process's code layout and costs CPU while it runs, so it
+        // takes the admin key like the /admin/ routes.
+        const bool admin = req.url.rfind("/admin/", 0) == 0 || req.url == "/debug/profile";
         const std::string api_key_header = req.get_header_value("Authorization");
-        if (api_key_header != runtime_config::api_key) {
+        if (api_key_header != (admin ? runtime_config::admin_api_key : runtime_config::api_key)) {
             res.code = 401;
             res.set_header("Content-Type", "application/json");
             res.write(R"({"error": "Unauthorized"})");
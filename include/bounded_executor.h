@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+#include "process_stats.h"
+
+// Fixed set of worker threads draining a bounded FIFO queue. submit() never blocks: once the
+// queue is full the task is refused and the caller sheds the request instead of piling up
+// work. With zero threads every task runs inline on the caller, which keeps the request path
+// synchronous for in-process benchmarks. Tasks must not throw. A running pool can be resized.
+class BoundedExecutor {
+public:
+    using Task = std::function<void()>;
+
+    BoundedExecutor(metrics::ExecutorStats& stats, int threads, int queue_capacity)
+        : stats_(stats), inline_(threads == 0), queue_capacity_(queue_capacity), target_threads_(threads), live_threads_(threads) {
+        stats_.threads.store(threads, std::memory_order_relaxed);
+        stats_.queue_capacity.store(queue_capacity, std::memory_order_relaxed);
+        for (int i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { run_worker(i); });
+        }
+    }
+
+    ~BoundedExecutor() {
+        stop();
+    }
+
+    BoundedExecutor(const BoundedExecutor&) = delete;
+    BoundedExecutor& operator=(const BoundedExecutor&) = delete;
+
+    bool submit(Task task) {
+        if (inline_) {
+            stats_.submitted.fetch_add(1, std::memory_order_relaxed);
+            run(task);
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || static_cast<int>(queue_.size()) >= queue_capacity_) {
+                stats_.rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            queue_.push_back(Queued{std::move(task), std::chrono::steady_clock::now()});
+            stats_.queue_depth.store(static_cast<int>(queue_.size()), std::memory_order_relaxed);
+        }
+        stats_.submitted.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+        return true;
+    }
+
+    // Changes the worker count and queue bound of a running pool. New workers start right away;
+    // surplus ones exit once they finish their current task, and the next resize() or stop()
+    // joins them. Queued tasks beyond a smaller bound still run. False for an inline pool or
+    // once stopped.
+    bool resize(int threads, int queue_capacity) {
+        if (threads < 1 || queue_capacity < 1) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || inline_) {
+                return false;
+            }
+            join_exited();
+            queue_capacity_ = queue_capacity;
+            target_threads_ = threads;
+            for (; live_threads_ < target_threads_; ++live_threads_) {
+                workers_.emplace_back([this, index = live_threads_] { run_worker(index); });
+            }
+        }
+        stats_.threads.store(threads, std::memory_order_relaxed);
+        stats_.queue_capacity.store(queue_capacity, std::memory_order_relaxed);
+        cv_.notify_all();
+        return true;
+    }
+
+    // Refuses new tasks, runs everything already queued, then joins the workers.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    const std::string& name() const {
+        return stats_.name;
+    }
+
+    // Threads started and not joined yet, retired ones included.
+    size_t worker_threads() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return workers_.size();
+    }
+
+private:
+    struct Queued {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    void run_worker(int index) {
+        process_stats::name_this_thread(stats_.name + "-" + std::to_string(index));
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty() || live_threads_ > target_threads_; });
+            if (live_threads_ > target_threads_) {
+                --live_threads_;
+                exited_.push_back(std::this_thread::get_id());
+                return;
+            }
+            if (queue_.empty()) {
+                return;
+            }
+            Queued next = std::move(queue_.front());
+            queue_.pop_front();
+            stats_.queue_depth.store(static_cast<int>(queue_.size()), std::memory_order_relaxed);
+            lock.unlock();
+
+            const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - next.enqueued_at).count();
+            stats_.queue_wait_us_total.fetch_add(waited, std::memory_order_relaxed);
+            int64_t seen_max = stats_.queue_wait_us_max.load(std::memory_order_relaxed);
+            while (waited > seen_max &&
+                   !stats_.queue_wait_us_max.compare_exchange_weak(seen_max, waited, std::memory_order_relaxed)) {
+            }
+            run(next.task);
+            lock.lock();
+        }
+    }
+
+    // Joins the workers a shrink retired. Called with mutex_ held: a retired worker records
+    // itself under the lock and releases it only by returning, so the join doesn't wait on it.
+    void join_exited() {
+        for (const std::thread::id id : exited_) {
+            for (auto worker = workers_.begin(); worker != workers_.end(); ++worker) {
+                if (worker->get_id() == id) {
+                    worker->join();
+                    workers_.erase(worker);
+                    break;
+                }
+            }
+        }
+        exited_.clear();
+    }
+
+    void run(Task& task) {
+        stats_.active.fetch_add(1, std::memory_order_relaxed);
+        task();
+        stats_.active.fetch_sub(1, std::memory_order_relaxed);
+        stats_.completed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    metrics::ExecutorStats& stats_;
+    const bool inline_;
+    int queue_capacity_;
+    int target_threads_;
+    int live_threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Queued> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+    std::vector<std::thread::id> exited_; // retired by a shrink, not joined yet
+};
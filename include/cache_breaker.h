@@ -0,0 +1,24 @@
+#pragma once
+
+#include "circuit_breaker.h"
+#include "metrics.h"
+
+namespace order_cache {
+    class Backend;
+}
+
+// Circuit breaker around every cache call. While a node's breaker is open, calls throw
+// order_cache::Unavailable straight away and a background thread pings the real backend;
+// once it answers, the breaker goes half-open and lets a few trial calls through.
+namespace cache_breaker {
+    struct Options {
+        CircuitBreaker::Options breaker;
+        int probe_interval_ms = 1000;
+    };
+
+    // Wraps `inner` in its own breaker that reports into `stats` (hits, misses, errors,
+    // short-circuits and breaker state). Call once per node; a single prober thread, started
+    // on the first call, pings every wrapped backend whose breaker is open.
+    order_cache::Backend* start(order_cache::Backend* inner, metrics::CacheNodeStats& stats, const Options& options);
+    void stop();
+}
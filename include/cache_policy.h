@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Decides how an order is cached: which version it is written with, how long it lives and
+// how its hits are counted. Versions follow the order's lifecycle (PENDING < PAID < deleted),
+// so a conditional write can't bring back a state the order has already left.
+namespace cache_policy {
+    enum class Policy { Pending = 0, Paid = 1, Tombstone = 2 };
+    constexpr int kPolicyCount = 3;
+
+    Policy for_status(const std::string& status);
+    const char* name(Policy policy);
+    int64_t version(Policy policy);
+
+    // Base TTL from runtime_config, spread by +/- cache_ttl_jitter_percent so entries written
+    // together (warmup, bursts of creates) don't all expire in the same second.
+    std::chrono::seconds ttl(Policy policy);
+
+    // "<version>:<payload>"; a tombstone has an empty payload. With CACHE_ENCODING=legacy the
+    // payload is written bare, the way instances from before versioned values wrote and read it.
+    std::string encode(Policy policy, const std::string& payload);
+
+    struct Decoded {
+        Policy policy;
+        std::string payload;
+    };
+    // nullopt for values this module did not write. A bare JSON order, from legacy mode or an
+    // older instance, decodes as PENDING or PAID by its status.
+    std::optional<Decoded> decode(const std::string& value);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+struct sqlite3;
+
+namespace order_cache {
+    class Backend;
+}
+
+// Startup cache warmup: preloads recent and PENDING orders into the cache and primes
+// SQLite's page cache on the request connection. While it runs, readiness reports
+// `warming` so traffic is only routed here once the cache is hot.
+namespace cache_warmup {
+    struct Options {
+        int max_orders = 10000;
+        int max_age_seconds = 3600;
+        int batch_size = 500;
+        int timeout_seconds = 30;
+    };
+
+    // Flips readiness to `warming` before returning, then loads in a background thread.
+    // `cache` may be null, in which case only the SQLite pages are primed.
+    void start(sqlite3* db, order_cache::Backend* cache, const Options& options);
+    void stop();
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Closed/open/half-open circuit breaker driven by error rate and latency.
+//
+// Closed: every call is allowed; outcomes are counted in a fixed window and the breaker opens
+// once at least `min_calls` were seen and the share of failed or slow calls reaches
+// `failure_rate`. Open: allow() rejects immediately. Nothing leaves this state on its own;
+// an out-of-band health probe calls probe_succeeded() to move to half-open. Half-open: up to
+// `half_open_calls` trial calls are let through; that many successes close the breaker and
+// any failure opens it again.
+class CircuitBreaker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State { Closed = 0, Open = 1, HalfOpen = 2 };
+
+    struct Options {
+        int window_ms = 10000;
+        int min_calls = 20;
+        double failure_rate = 0.5;
+        int slow_call_ms = 100;
+        int half_open_calls = 5;
+    };
+
+    using TransitionListener = std::function<void(State from, State to)>;
+
+    explicit CircuitBreaker(Options options, TransitionListener on_transition = nullptr)
+        : options_(options), on_transition_(std::move(on_transition)) {}
+
+    bool allow() {
+        const State current = state();
+        if (current == State::Closed) {
+            return true;
+        }
+        if (current == State::Open) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_.load(std::memory_order_relaxed) != State::HalfOpen) {
+            return state_.load(std::memory_order_relaxed) == State::Closed;
+        }
+        if (trial_calls_ >= options_.half_open_calls) {
+            return false;
+        }
+        ++trial_calls_;
+        return true;
+    }
+
+    // Reports the outcome of an allowed call. Calls slower than slow_call_ms count as failures.
+    void record(bool ok, std::chrono::milliseconds latency, Clock::time_point now = Clock::now()) {
+        const bool failed = !ok || latency.count() >= options_.slow_call_ms;
+        std::lock_guard<std::mutex> lock(mutex_);
+        switch (state_.load(std::memory_order_relaxed)) {
+            case State::Closed:
+                if (now - window_start_ >= std::chrono::milliseconds(options_.window_ms)) {
+                    window_start_ = now;
+                    calls_ = 0;
+                    failures_ = 0;
+                }
+                ++calls_;
+                failures_ += failed ? 1 : 0;
+                if (calls_ >= options_.min_calls &&
+                    static_cast<double>(failures_) >= options_.failure_rate * static_cast<double>(calls_)) {
+                    transition(State::Open);
+                }
+                break;
+            case State::HalfOpen:
+                if (failed) {
+                    transition(State::Open);
+                } else if (++trial_successes_ >= options_.half_open_calls) {
+                    transition(State::Closed);
+                }
+                break;
+            case State::Open:
+                break;
+        }
+    }
+
+    // Opens the breaker regardless of the window, e.g. when a health check fails.
+    void trip() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_.load(std::memory_order_relaxed) != State::Open) {
+            transition(State::Open);
+        }
+    }
+
+    // Called by the health prober once the dependency answers again.
+    void probe_succeeded() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_.load(std::memory_order_relaxed) == State::Open) {
+            transition(State::HalfOpen);
+        }
+    }
+
+    State state() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    uint64_t transitions() const {
+        return transitions_.load(std::memory_order_relaxed);
+    }
+
+    static const char* state_name(State state) {
+        switch (state) {
+            case State::Closed: return "closed";
+            case State::Open: return "open";
+            case State::HalfOpen: return "half_open";
+        }
+        return "unknown";
+    }
+
+private:
+    // Caller holds mutex_.
+    void transition(State to) {
+        const State from = state_.load(std::memory_order_relaxed);
+        state_.store(to, std::memory_order_release);
+        transitions_.fetch_add(1, std::memory_order_relaxed);
+        window_start_ = Clock::now();
+        calls_ = 0;
+        failures_ = 0;
+        trial_calls_ = 0;
+        trial_successes_ = 0;
+        if (on_transition_) {
+            on_transition_(from, to);
+        }
+    }
+
+    Options options_;
+    TransitionListener on_transition_;
+    std::mutex mutex_;
+    std::atomic<State> state_{State::Closed};
+    std::atomic<uint64_t> transitions_{0};
+    Clock::time_point window_start_ = Clock::now();
+    int calls_ = 0;
+    int failures_ = 0;
+    int trial_calls_ = 0;
+    int trial_successes_ = 0;
+};
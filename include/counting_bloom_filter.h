@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "hash_ring.h"
+
+// Bloom filter with 8-bit counters instead of bits, so keys can be removed again.
+// might_contain() never returns false for a key that was added and not removed; it returns
+// true for an absent key with roughly the configured probability while the filter holds no
+// more than `capacity` keys. A counter that reaches 255 sticks there, which can only cost
+// extra false positives. All operations are lock-free and safe to call concurrently.
+class CountingBloomFilter {
+public:
+    CountingBloomFilter(uint64_t capacity, double false_positive_rate) {
+        const double n = static_cast<double>(std::max<uint64_t>(1, capacity));
+        const double p = std::clamp(false_positive_rate, 1e-6, 0.5);
+        const double ln2 = std::log(2.0);
+        size_ = std::max<uint64_t>(64, static_cast<uint64_t>(std::ceil(-n * std::log(p) / (ln2 * ln2))));
+        hash_count_ = std::clamp(static_cast<int>(std::lround(static_cast<double>(size_) / n * ln2)), 1, 16);
+        counters_ = std::make_unique<std::atomic<uint8_t>[]>(size_);
+    }
+
+    // Rebuilds a filter from the counters() of another one, e.g. the filter a previous process
+    // handed over on a hot restart. nullptr when the input can't be one.
+    static std::unique_ptr<CountingBloomFilter> from_counters(int hash_count, std::string_view counters) {
+        if (counters.empty() || hash_count < 1 || hash_count > 16) {
+            return nullptr;
+        }
+        std::unique_ptr<CountingBloomFilter> restored(new CountingBloomFilter());
+        restored->size_ = counters.size();
+        restored->hash_count_ = hash_count;
+        restored->counters_ = std::make_unique<std::atomic<uint8_t>[]>(restored->size_);
+        for (uint64_t i = 0; i < restored->size_; ++i) {
+            restored->counters_[i].store(static_cast<uint8_t>(counters[i]), std::memory_order_relaxed);
+        }
+        return restored;
+    }
+
+    // One byte per counter. Only a consistent copy while nothing adds or removes keys.
+    std::string counters() const {
+        std::string out(size_, '\0');
+        for (uint64_t i = 0; i < size_; ++i) {
+            out[i] = static_cast<char>(counters_[i].load(std::memory_order_relaxed));
+        }
+        return out;
+    }
+
+    void add(std::string_view key) {
+        for_each_counter(key, [](std::atomic<uint8_t>& counter) {
+            uint8_t value = counter.load(std::memory_order_relaxed);
+            while (value < kSaturated &&
+                   !counter.compare_exchange_weak(value, static_cast<uint8_t>(value + 1), std::memory_order_relaxed)) {
+            }
+            return true;
+        });
+    }
+
+    // Only call for keys that were added; removing anything else can create false negatives.
+    void remove(std::string_view key) {
+        if (!might_contain(key)) {
+            return;
+        }
+        for_each_counter(key, [](std::atomic<uint8_t>& counter) {
+            uint8_t value = counter.load(std::memory_order_relaxed);
+            while (value > 0 && value < kSaturated &&
+                   !counter.compare_exchange_weak(value, static_cast<uint8_t>(value - 1), std::memory_order_relaxed)) {
+            }
+            return true;
+        });
+    }
+
+    bool might_contain(std::string_view key) const {
+        bool present = true;
+        for_each_counter(key, [&present](std::atomic<uint8_t>& counter) {
+            present = counter.load(std::memory_order_relaxed) > 0;
+            return present;
+        });
+        return present;
+    }
+
+    uint64_t size() const {
+        return size_;
+    }
+
+    int hash_count() const {
+        return hash_count_;
+    }
+
+private:
+    static constexpr uint8_t kSaturated = 255;
+
+    CountingBloomFilter() = default;
+
+    // Double hashing (Kirsch-Mitzenmacher): the i-th index is h1 + i * h2, both halves of one
+    // 64-bit hash. Stops early when `f` returns false.
+    template<typename F>
+    void for_each_counter(std::string_view key, F&& f) const {
+        const uint64_t h = HashRing::hash(key);
+        const uint64_t h1 = h & 0xffffffffULL;
+        const uint64_t h2 = (h >> 32) | 1;
+        for (int i = 0; i < hash_count_; ++i) {
+            if (!f(counters_[(h1 + static_cast<uint64_t>(i) * h2) % size_])) {
+                return;
+            }
+        }
+    }
+
+    uint64_t size_ = 0;
+    int hash_count_ = 1;
+    std::unique_ptr<std::atomic<uint8_t>[]> counters_;
+};
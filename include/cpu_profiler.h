@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// In-process sampling CPU profiler behind GET /debug/profile. While a profile runs, every
+// thread of the process has a CPU-time timer that sends it SIGPROF after each 1/hz seconds
+// of CPU it uses, and the signal handler copies the thread's stack into a buffer allocated
+// up front. Threads that wait or sleep aren't sampled, so the profile shows where CPU time
+// goes. Between profiles no timer exists, so an idle profiler costs nothing. Linux only.
+namespace cpu_profiler {
+    struct Options {
+        int seconds = 10;
+        int hz = 99;
+    };
+
+    enum class StartResult { Started, Busy, Unsupported, Failed };
+
+    struct Profile {
+        // Folded stacks: "outermost;...;leaf count" per line, heaviest first.
+        std::string folded;
+        int64_t samples = 0;
+        // Samples lost because the buffer was full.
+        int64_t dropped = 0;
+        int threads = 0;
+    };
+
+    // Folds stacks, each listed outermost frame first, into flame-graph input.
+    inline std::string fold(const std::vector<std::vector<std::string>>& stacks) {
+        std::map<std::string, int64_t> counts;
+        for (const auto& stack : stacks) {
+            std::string line;
+            for (const auto& frame : stack) {
+                if (!line.empty()) {
+                    line += ';';
+                }
+                line += frame;
+            }
+            if (!line.empty()) {
+                ++counts[line];
+            }
+        }
+        std::vector<std::pair<std::string, int64_t>> sorted(counts.begin(), counts.end());
+        std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.second > b.second;
+        });
+        std::string out;
+        for (const auto& [line, count] : sorted) {
+            out += line;
+            out += ' ';
+            out += std::to_string(count);
+            out += '\n';
+        }
+        return out;
+    }
+
+    // Starts sampling the threads that exist now. Only one profile runs at a time; a second
+    // start() gets Busy until stop().
+    StartResult start(const Options& options);
+
+    // Stops sampling and returns the symbolized profile.
+    Profile stop();
+}
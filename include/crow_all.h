@@ -2279,6 +2279,7 @@ namespace crow
             void cancel(identifier_type id)
             {
                 tasks_.erase(id);
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
                 CROW_LOG_DEBUG << "task_timer task cancelled: " << this << ' ' << id;
             }
 
@@ -2309,6 +2310,7 @@ namespace crow
                 tasks_.insert({++highest_id_,
                                {clock_type::now() + (timeout * tick_length_ms_),
                                 task}});
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
                 CROW_LOG_DEBUG << "task_timer scheduled: " << this << ' ' <<
                                   highest_id_;
                 return highest_id_;
@@ -2335,6 +2337,11 @@ namespace crow
                 return tick_length_ms_;
             }
 
+            /// Tasks scheduled and not yet run or cancelled; safe to read from any thread.
+            size_t pending() const {
+                return pending_.load(std::memory_order_relaxed);
+            }
+
         private:
             void process_tasks()
             {
@@ -2354,6 +2361,7 @@ namespace crow
 
                 for (const auto& task : finished_tasks)
                     tasks_.erase(task);
+                pending_.store(tasks_.size(), std::memory_order_relaxed);
 
                 // If no task is currently scheduled, reset the issued ids back
                 // to 0.
@@ -2375,6 +2383,7 @@ namespace crow
             asio::io_context& io_context_;
             asio::basic_waitable_timer<clock_type> timer_;
             std::map<identifier_type, std::pair<time_type, task_type>> tasks_;
+            std::atomic<size_t> pending_{0};
 
             // A continuously increasing number to be issued to threads to
             // identify them. If no tasks are scheduled, it will be reset to 0.
@@ -7914,6 +7923,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         void* middleware_context{};
         void* middleware_container{};
         asio::io_context* io_context{};
+        /// The rule the router matched (e.g. `/order/get/<string>`), or null before routing or if none did.
+        const std::string* matched_rule{};
 
         /// Construct an empty request. (sets the method to `GET`)
         request():
@@ -9619,6 +9630,14 @@ namespace crow
         bool skip_body = false;            ///< Whether this is a response to a HEAD request.
         bool manual_length_header = false; ///< Whether Crow should automatically add a "Content-Length" header.
 
+        /// Pull-based body producer used for chunked streaming responses.
+
+        ///
+        /// The source appends the next piece of the body to the buffer it is given and returns false once it has
+        /// nothing more to produce. Each piece is sent as one HTTP chunk, and the source is only asked for more data
+        /// after the socket has accepted the previous chunk. It runs on the connection's I/O thread.
+        using body_source_t = std::function<bool(std::string&)>;
+
         /// Set the value of an existing header in the response.
         void set_header(std::string key, std::string value)
         {
@@ -9742,6 +9761,7 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            body_source_ = std::move(r.body_source_);
             return *this;
         }
 
@@ -9758,6 +9778,7 @@ namespace crow
             headers.clear();
             completed_ = false;
             file_info = static_file_info{};
+            body_source_ = nullptr;
         }
 
         /// Return a "Temporary Redirect" response.
@@ -9833,6 +9854,23 @@ namespace crow
             end();
         }
 
+        /// Run `handler` once the connection has written this response, or given up writing it.
+        void on_written(std::function<void()> handler)
+        {
+            written_handler_ = std::move(handler);
+        }
+
+        /// Called by the connection after the last write of this response; runs the on_written handler once.
+        void notify_written()
+        {
+            if (written_handler_)
+            {
+                auto handler = std::move(written_handler_);
+                written_handler_ = nullptr;
+                handler();
+            }
+        }
+
         /// Check if the connection is still alive (usually by checking the socket status).
         bool is_alive()
         {
@@ -9890,11 +9928,31 @@ namespace crow
             }
         }
 
+        /// Check whether the response body is produced by a streaming source.
+        bool is_stream_type()
+        {
+            return static_cast<bool>(body_source_);
+        }
+
+        /// Stream the response body from a source using chunked transfer encoding.
+        void set_body_source(body_source_t source)
+        {
+            body_source_ = std::move(source);
+            body.clear();
+#ifdef CROW_ENABLE_COMPRESSION
+            compressed = false;
+#endif
+            set_header("Transfer-Encoding", "chunked");
+            headers.erase("Content-Length");
+        }
+
     private:
         bool completed_{};
         std::function<void()> complete_request_handler_;
         std::function<bool()> is_alive_helper_;
         static_file_info file_info;
+        body_source_t body_source_;
+        std::function<void()> written_handler_;
     };
 } // namespace crow
 
@@ -12854,6 +12912,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             }
 
             CROW_LOG_DEBUG << "Matched rule '" << rules[rule_index]->rule_ << "' " << static_cast<uint32_t>(req.method) << " / " << rules[rule_index]->get_methods();
+            req.matched_rule = &rules[rule_index]->rule_;
 
             try
             {
@@ -13241,6 +13300,55 @@ namespace crow
     static std::atomic<int> connectionCount;
 #endif
 
+    /// HTTP connections currently open, across every server in the process
+    inline std::atomic<int> open_connections{0};
+
+    /// Running totals across every server in the process, for metrics
+    struct connection_totals
+    {
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> closed{0};
+        std::atomic<uint64_t> requests{0};
+        /// Requests after the first on a keep-alive connection
+        std::atomic<uint64_t> reused{0};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+        /// Connections dropped because the request could not be parsed
+        std::atomic<uint64_t> parse_errors{0};
+    };
+    inline connection_totals connection_stats;
+
+    /// Optional callbacks around the work a connection does for a request on its I/O thread:
+    /// the middlewares and handler, then the after handlers. Parsing the request comes before
+    /// either. `leave` gets what `enter` returned. Set before the server starts.
+    struct request_scope_hooks
+    {
+        void* (*enter)(const request&) = nullptr;
+        void (*leave)(void*) = nullptr;
+    };
+    inline request_scope_hooks request_scope;
+
+    namespace detail
+    {
+        struct request_scope_guard
+        {
+            explicit request_scope_guard(const request& req):
+              token(request_scope.enter != nullptr ? request_scope.enter(req) : nullptr)
+            {}
+
+            ~request_scope_guard()
+            {
+                if (request_scope.leave != nullptr)
+                    request_scope.leave(token);
+            }
+
+            request_scope_guard(const request_scope_guard&) = delete;
+            request_scope_guard& operator=(const request_scope_guard&) = delete;
+
+            void* token;
+        };
+    } // namespace detail
+
     /// An HTTP connection.
     template<typename Adaptor, typename Handler, typename... Middlewares>
     class Connection : public std::enable_shared_from_this<Connection<Adaptor, Handler, Middlewares...>>
@@ -13276,6 +13384,12 @@ namespace crow
 
         ~Connection()
         {
+            if (started_)
+            {
+                open_connections--;
+                queue_length_--;
+                connection_stats.closed.fetch_add(1, std::memory_order_relaxed);
+            }
 #ifdef CROW_ENABLE_DEBUG
             connectionCount--;
             CROW_LOG_DEBUG << "Connection (" << this << ") freed, total: " << connectionCount;
@@ -13290,6 +13404,10 @@ namespace crow
 
         void start()
         {
+            // Counted from here: the server keeps one unaccepted connection waiting on the acceptor
+            started_ = true;
+            open_connections++;
+            connection_stats.accepted.fetch_add(1, std::memory_order_relaxed);
             auto self = this->shared_from_this();
             adaptor_.start([self](const error_code& ec) {
                 if (!ec)
@@ -13337,12 +13455,16 @@ namespace crow
             cancel_deadline_timer();
             bool is_invalid_request = false;
             add_keep_alive_ = false;
+            connection_stats.requests.fetch_add(1, std::memory_order_relaxed);
+            if (requests_handled_++ > 0)
+                connection_stats.reused.fetch_add(1, std::memory_order_relaxed);
 
             // Create context
             ctx_ = detail::context<Middlewares...>();
             req_.middleware_context = static_cast<void*>(&ctx_);
             req_.middleware_container = static_cast<void*>(middlewares_);
             req_.io_context = &adaptor_.get_io_context();
+            detail::request_scope_guard scope(req_);
 
             req_.remote_ip_address = adaptor_.remote_endpoint().address().to_string();
 
@@ -13415,12 +13537,15 @@ namespace crow
         /// Call the after handle middleware and send the write the response to the connection.
         void complete_request()
         {
+            // When a handler completes asynchronously, the handler that prepare_buffers() clears holds the last reference
+            auto self = this->shared_from_this();
             CROW_LOG_INFO << "Response: " << this << ' ' << req_.raw_url << ' ' << res.code << ' ' << close_connection_;
             res.is_alive_helper_ = nullptr;
 
             if (need_to_call_after_handlers_)
             {
                 need_to_call_after_handlers_ = false;
+                detail::request_scope_guard scope(req_);
 
                 // call all after_handler of middlewares
                 detail::after_handlers_call_helper<
@@ -13429,6 +13554,13 @@ namespace crow
                   decltype(ctx_),
                   decltype(*middlewares_)>({}, *middlewares_, ctx_, req_, res);
             }
+
+            // A response (or an after handler) asking for "Connection: close" ends keep-alive
+            if (utility::string_equals(res.get_header_value("connection"), "close"))
+            {
+                close_connection_ = true;
+                add_keep_alive_ = false;
+            }
 #ifdef CROW_ENABLE_COMPRESSION
             if (!res.body.empty() && handler_->compression_used())
             {
@@ -13464,6 +13596,10 @@ namespace crow
             {
                 do_write_static();
             }
+            else if (res.is_stream_type())
+            {
+                do_write_stream();
+            }
             else
             {
                 do_write_general();
@@ -13556,7 +13692,7 @@ namespace crow
                 buffers_.emplace_back(crlf.data(), crlf.size());
             }
 
-            if (!res.manual_length_header && !res.headers.count("content-length"))
+            if (!res.manual_length_header && !res.headers.count("content-length") && !res.is_stream_type())
             {
                 content_length_ = std::to_string(res.body.size());
                 static std::string content_length_tag = "Content-Length: ";
@@ -13591,7 +13727,7 @@ namespace crow
 
         void do_write_static()
         {
-            asio::write(adaptor_.socket(), buffers_);
+            count_sent(asio::write(adaptor_.socket(), buffers_));
 
             if (res.file_info.statResult == 0)
             {
@@ -13606,6 +13742,7 @@ namespace crow
                     is.read(buf, sizeof(buf));
                 }
             }
+            res.notify_written();
             if (close_connection_)
             {
                 adaptor_.shutdown_readwrite();
@@ -13619,6 +13756,93 @@ namespace crow
             parser_.clear();
         }
 
+        /// Write the headers, then one chunk at a time: the source is only asked for the next chunk
+        /// once the socket has taken the previous one. Every write runs under the connection
+        /// deadline, so a client that stops reading is disconnected instead of holding the
+        /// stream open, and the I/O thread serves other connections in between.
+        void do_write_stream()
+        {
+            streaming_ = true;
+            start_deadline();
+            auto self = this->shared_from_this();
+            asio::async_write(
+              adaptor_.socket(), buffers_,
+              [self](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  if (ec)
+                      self->finish_stream(ec);
+                  else
+                      self->write_next_chunk();
+              });
+        }
+
+        void write_next_chunk()
+        {
+            static const std::string last_chunk = "0\r\n\r\n";
+            stream_chunk_.clear();
+            bool more = adaptor_.is_open();
+            while (more && stream_chunk_.empty())
+            {
+                more = res.body_source_(stream_chunk_);
+            }
+
+            buffers_.clear();
+            if (!stream_chunk_.empty())
+            {
+                const int size_line_length = snprintf(stream_size_line_, sizeof(stream_size_line_), "%zx\r\n", stream_chunk_.size());
+                buffers_.emplace_back(stream_size_line_, size_line_length);
+                buffers_.emplace_back(stream_chunk_.data(), stream_chunk_.size());
+                buffers_.emplace_back(crlf.data(), crlf.size());
+            }
+            if (!more)
+            {
+                buffers_.emplace_back(last_chunk.data(), last_chunk.size());
+            }
+
+            start_deadline();
+            auto self = this->shared_from_this();
+            asio::async_write(
+              adaptor_.socket(), buffers_,
+              [self, more](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  if (!ec && more)
+                      self->write_next_chunk();
+                  else
+                      self->finish_stream(ec);
+              });
+        }
+
+        void finish_stream(const error_code& ec)
+        {
+            cancel_deadline_timer();
+            streaming_ = false;
+            res.notify_written();
+            if (ec)
+            {
+                CROW_LOG_ERROR << ec << " - happened while streaming response";
+                close_connection_ = true;
+            }
+            if (close_connection_)
+            {
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                CROW_LOG_DEBUG << this << " from write (stream)";
+            }
+
+            res.end();
+            res.clear();
+            buffers_.clear();
+            stream_chunk_.clear();
+            parser_.clear();
+
+            if (need_to_start_read_after_complete_ && !close_connection_)
+            {
+                need_to_start_read_after_complete_ = false;
+                start_deadline();
+                do_read();
+            }
+        }
+
         void do_write_general()
         {
             if (res.body.length() < res_stream_threshold_)
@@ -13627,6 +13851,7 @@ namespace crow
                 buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
 
                 do_write_sync(buffers_);
+                res.notify_written();
 
                 if (need_to_start_read_after_complete_)
                 {
@@ -13637,7 +13862,7 @@ namespace crow
             }
             else
             {
-                asio::write(adaptor_.socket(), buffers_); // Write the response start / headers
+                count_sent(asio::write(adaptor_.socket(), buffers_)); // Write the response start / headers
                 cancel_deadline_timer();
                 if (res.body.length() > 0)
                 {
@@ -13652,6 +13877,7 @@ namespace crow
                         transferred += to_transfer;
                     }
                 }
+                res.notify_written();
                 if (close_connection_)
                 {
                     adaptor_.shutdown_readwrite();
@@ -13675,11 +13901,16 @@ namespace crow
                   bool error_while_reading = true;
                   if (!ec)
                   {
+                      connection_stats.bytes_in.fetch_add(bytes_transferred, std::memory_order_relaxed);
                       bool ret = self->parser_.feed(self->buffer_.data(), bytes_transferred);
                       if (ret && self->adaptor_.is_open())
                       {
                           error_while_reading = false;
                       }
+                      else if (!ret)
+                      {
+                          connection_stats.parse_errors.fetch_add(1, std::memory_order_relaxed);
+                      }
                   }
 
                   if (error_while_reading)
@@ -13690,6 +13921,11 @@ namespace crow
                       self->adaptor_.close();
                       CROW_LOG_DEBUG << self << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(self->parser_.http_errno)) << '\"';
                   }
+                  else if (self->streaming_)
+                  {
+                      // The stream owns the deadline; reading resumes once it has been written
+                      self->need_to_start_read_after_complete_ = true;
+                  }
                   else if (self->close_connection_)
                   {
                       self->cancel_deadline_timer();
@@ -13714,7 +13950,9 @@ namespace crow
             auto self = this->shared_from_this();
             asio::async_write(
               adaptor_.socket(), buffers_,
-              [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
+              [self](const error_code& ec, std::size_t bytes_transferred) {
+                  self->count_sent(bytes_transferred);
+                  self->res.notify_written();
                   self->res.clear();
                   self->res_body_copy_.clear();
                   if (!self->continue_requested)
@@ -13745,7 +13983,7 @@ namespace crow
         inline void do_write_sync(std::vector<asio::const_buffer>& buffers)
         {
             error_code ec;
-            asio::write(adaptor_.socket(), buffers, ec);
+            count_sent(asio::write(adaptor_.socket(), buffers, ec));
 
             this->res.clear();
             this->res_body_copy_.clear();
@@ -13765,6 +14003,11 @@ namespace crow
             }
         }
 
+        void count_sent(std::size_t bytes)
+        {
+            connection_stats.bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
         void cancel_deadline_timer()
         {
             CROW_LOG_DEBUG << this << " timer cancelled: " << &task_timer_ << ' ' << task_id_;
@@ -13813,6 +14056,10 @@ namespace crow
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
+        bool streaming_{};
+
+        std::string stream_chunk_;
+        char stream_size_line_[24];
 
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
@@ -13823,6 +14070,8 @@ namespace crow
         size_t res_stream_threshold_;
 
         std::atomic<unsigned int>& queue_length_;
+        bool started_ = false;
+        unsigned int requests_handled_ = 0;
     };
 
 } // namespace crow
@@ -13850,6 +14099,10 @@ namespace crow
 #include <memory>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
 
 
 namespace crow // NOTE: Already documented in "crow/app.h"
@@ -13862,6 +14115,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 #endif
     using tcp = asio::ip::tcp;
 
+    /// One I/O worker thread of a server, for metrics
+    struct io_thread_stats
+    {
+        /// Connections assigned to the thread and not yet closed
+        unsigned int connections;
+        /// Connection deadlines its task_timer holds
+        size_t pending_timeouts;
+    };
+
     template<typename Handler, typename Adaptor = SocketAdaptor, typename... Middlewares>
     class Server
     {
@@ -13872,15 +14134,17 @@ namespace crow // NOTE: Already documented in "crow/app.h"
              std::tuple<Middlewares...>* middlewares = nullptr,
              uint16_t concurrency = 1,
              uint8_t timeout = 5,
-             typename Adaptor::context* adaptor_ctx = nullptr):
-          acceptor_(io_context_,endpoint),
+             typename Adaptor::context* adaptor_ctx = nullptr,
+             int listen_fd = -1):
+          // A listen_fd that is already bound and listening (e.g. inherited from another process) replaces binding endpoint
+          task_queue_length_pool_(concurrency - 1),
+          acceptor_(listen_fd < 0 ? tcp::acceptor(io_context_, endpoint) : tcp::acceptor(io_context_, endpoint.protocol(), listen_fd)),
           signals_(io_context_),
           tick_timer_(io_context_),
           handler_(handler),
           concurrency_(concurrency),
           timeout_(timeout),
           server_name_(server_name),
-          task_queue_length_pool_(concurrency_ - 1),
           middlewares_(middlewares),
           adaptor_ctx_(adaptor_ctx)
         {}
@@ -13946,8 +14210,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                         // initializing task timers
                         detail::task_timer task_timer(*io_context_pool_[i]);
                         task_timer.set_default_timeout(timeout_);
-                        task_timer_pool_[i] = &task_timer;
+                        {
+                            std::lock_guard<std::mutex> lock(task_timer_mutex_);
+                            task_timer_pool_[i] = &task_timer;
+                        }
                         task_queue_length_pool_[i] = 0;
+#ifdef __linux__
+                        // Named so per-thread CPU time can be told apart (at most 15 characters)
+                        pthread_setname_np(pthread_self(), ("crow-io-" + std::to_string(i)).c_str());
+#endif
 
                         init_count++;
                         while (1)
@@ -13965,6 +14236,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                                 CROW_LOG_ERROR << "Worker Crash: An uncaught exception occurred: " << e.what();
                             }
                         }
+
+                        // task_timer lives on this stack; unpublish it before it unwinds
+                        std::lock_guard<std::mutex> lock(task_timer_mutex_);
+                        task_timer_pool_[i] = nullptr;
                     }));
 
             if (tick_function_ && tick_interval_.count() > 0)
@@ -14005,6 +14280,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
               .join();
         }
 
+        /// Close the listening socket but keep serving the connections that are already open.
+        void stop_accepting()
+        {
+            asio::post(io_context_, [this] {
+                shutting_down_ = true;
+                error_code ec;
+                acceptor_.close(ec);
+            });
+        }
+
         void stop()
         {
             shutting_down_ = true; // Prevent the acceptor from taking new connections
@@ -14025,6 +14310,27 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             return acceptor_.local_endpoint().port();
         }
 
+        /// Per I/O worker thread, once run() has started them; empty before, and after they exit
+        std::vector<io_thread_stats> io_threads() const
+        {
+            std::vector<io_thread_stats> threads;
+            if (!server_started_)
+                return threads;
+            std::lock_guard<std::mutex> lock(task_timer_mutex_);
+            for (size_t i = 0; i < task_timer_pool_.size(); i++)
+            {
+                if (task_timer_pool_[i] == nullptr)
+                    return {};
+                threads.push_back({task_queue_length_pool_[i].load(), task_timer_pool_[i]->pending()});
+            }
+            return threads;
+        }
+
+        int native_listen_handle()
+        {
+            return static_cast<int>(acceptor_.native_handle());
+        }
+
         /// Wait until the server has properly started or until timeout
         std::cv_status wait_for_start(std::chrono::steady_clock::time_point wait_until)
         {
@@ -14081,6 +14387,9 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                   [this, p, &ic, context_idx](error_code ec) {
                       if (!ec)
                       {
+                          // Responses are written in one go, so Nagle only adds a delayed-ACK stall on keep-alive connections
+                          error_code nodelay_ec;
+                          p->socket().set_option(tcp::no_delay(true), nodelay_ec);
                           asio::post(ic,
                             [p] {
                                 p->start();
@@ -14105,13 +14414,18 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
     private:
+        // Declared first so it outlives io_context_pool_: connections still queued there when
+        // the server is destroyed decrement their thread's count
+        std::vector<std::atomic<unsigned int>> task_queue_length_pool_;
         std::vector<std::unique_ptr<asio::io_context>> io_context_pool_;
         asio::io_context io_context_;
+        // Entries point into the I/O threads' stacks and are cleared as those threads exit
         std::vector<detail::task_timer*> task_timer_pool_;
+        mutable std::mutex task_timer_mutex_;
         std::vector<std::function<std::string()>> get_cached_date_str_pool_;
         tcp::acceptor acceptor_;
         bool shutting_down_ = false;
-        bool server_started_{false};
+        std::atomic<bool> server_started_{false};
         std::condition_variable cv_started_;
         std::mutex start_mutex_;
         asio::signal_set signals_;
@@ -14122,7 +14436,6 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         uint16_t concurrency_{2};
         std::uint8_t timeout_;
         std::string server_name_;
-        std::vector<std::atomic<unsigned int>> task_queue_length_pool_;
 
         std::chrono::milliseconds tick_interval_;
         std::function<void()> tick_function_;
@@ -14459,6 +14772,25 @@ namespace crow
             return *this;
         }
 
+        /// \brief Accept on a socket that is already bound and listening (e.g. handed over by another process) instead of binding port()
+        self_t& listen_fd(int fd)
+        {
+            listen_fd_ = fd;
+            return *this;
+        }
+
+        /// \brief Get the native handle of the listening socket, or -1 before the server has started
+        int native_listen_handle()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                return ssl_server_ ? ssl_server_->native_listen_handle() : -1;
+            }
+#endif
+            return server_ ? server_->native_listen_handle() : -1;
+        }
+
         /// \brief The IP address that Crow will handle requests on (default is 0.0.0.0)
         self_t& bindaddr(std::string bindaddr)
         {
@@ -14640,7 +14972,7 @@ namespace crow
             if (ssl_used_)
             {
                 router_.using_ssl = true;
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_, listen_fd_)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
                 ssl_server_->signal_clear();
                 for (auto snum : signals_)
@@ -14653,7 +14985,7 @@ namespace crow
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, listen_fd_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
                 for (auto snum : signals_)
                 {
@@ -14675,6 +15007,33 @@ namespace crow
             });
         }
 
+        /// \brief Per I/O worker thread: open connections and pending connection deadlines; empty until the server runs
+        std::vector<io_thread_stats> io_threads()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                return ssl_server_ ? ssl_server_->io_threads() : std::vector<io_thread_stats>{};
+            }
+#endif
+            return server_ ? server_->io_threads() : std::vector<io_thread_stats>{};
+        }
+
+        /// \brief Stop taking new connections; open connections keep being served until stop()
+        void stop_accepting()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                if (ssl_server_) { ssl_server_->stop_accepting(); }
+            }
+            else
+#endif
+            {
+                if (server_) { server_->stop_accepting(); }
+            }
+        }
+
         /// \brief Stop the server
         void stop()
         {
@@ -14886,6 +15245,7 @@ namespace crow
         uint64_t max_payload_{UINT64_MAX};
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
+        int listen_fd_ = -1;
         size_t res_stream_threshold_ = 1048576;
         Router router_;
         bool static_routes_added_{false};
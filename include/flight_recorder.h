@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "request_trace.h"
+
+// Always-on flight recorder of recent hot-path events. Each thread that records owns a ring
+// of the last few thousand 16-byte events, written without locks, allocation or system calls
+// and stamped with the CPU's timestamp counter, so recording costs a few nanoseconds. The
+// rings are dumped to a file on SIGUSR1, on POST /admin/flight-recorder/dump, or after a
+// request slower than FLIGHT_RECORDER_SLOW_MS; tools/flight_decode prints a dump as a timeline.
+namespace flight_recorder {
+    enum class Type : uint16_t {
+        RequestStart = 1,
+        RequestEnd = 2,        // value: status code
+        CacheHit = 3,
+        CacheMiss = 4,
+        SqliteStep = 5,        // value: ticks the step took
+        ShedOverload = 6,
+        ShedShutdown = 7,
+        ShedQueueFull = 8,
+        DeadlineExceeded = 9,  // value: request_deadline::Stage
+    };
+
+    inline const char* type_name(Type type) {
+        switch (type) {
+            case Type::RequestStart: return "request_start";
+            case Type::RequestEnd: return "request_end";
+            case Type::CacheHit: return "cache_hit";
+            case Type::CacheMiss: return "cache_miss";
+            case Type::SqliteStep: return "sqlite_step";
+            case Type::ShedOverload: return "shed_overload";
+            case Type::ShedShutdown: return "shed_shutdown";
+            case Type::ShedQueueFull: return "shed_queue_full";
+            case Type::DeadlineExceeded: return "deadline_exceeded";
+        }
+        return "unknown";
+    }
+
+    struct Event {
+        uint64_t ticks = 0;
+        uint32_t value = 0;
+        uint16_t type = 0;
+        // Low 16 bits of the request id; 0 outside a request.
+        uint16_t request = 0;
+    };
+    static_assert(sizeof(Event) == 16, "events are written to dumps as 16 bytes");
+
+    // The timestamp counter where there is one (x86-64), steady-clock nanoseconds elsewhere.
+    inline uint64_t ticks() {
+#if (defined(_MSC_VER) && defined(_M_X64)) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    namespace detail {
+        // Written only by its thread. `head` counts every event ever recorded; a reader takes
+        // the last `capacity` before it and discards any the writer lapped meanwhile.
+        struct Ring {
+            explicit Ring(size_t capacity, uint32_t thread_number)
+                : events(new Event[capacity]), mask(capacity - 1), thread(thread_number) {}
+
+            std::unique_ptr<Event[]> events;
+            size_t mask;
+            uint32_t thread;
+            std::atomic<uint64_t> head{0};
+        };
+
+        inline std::atomic<bool> enabled{false};
+        inline thread_local Ring* ring = nullptr;
+
+        // Gives the calling thread its ring; nullptr once the ring limit is reached.
+        Ring* attach();
+    }
+
+    inline void record(Type type, uint32_t value, uint32_t request) {
+        if (!detail::enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        detail::Ring* ring = detail::ring != nullptr ? detail::ring : detail::attach();
+        if (ring == nullptr) {
+            return;
+        }
+        const uint64_t head = ring->head.load(std::memory_order_relaxed);
+        ring->events[head & ring->mask] =
+            Event{ticks(), value, static_cast<uint16_t>(type), static_cast<uint16_t>(request)};
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    // For the request whose trace the calling thread has in scope, e.g. in a storage stage.
+    inline void record(Type type, uint32_t value = 0) {
+        const request_trace::Trace* trace = request_trace::current();
+        record(type, value, trace != nullptr ? trace->id() : 0);
+    }
+
+    // Records `type` with the ticks elapsed since `start` as its value.
+    inline void record_since(Type type, uint64_t start) {
+        const uint64_t elapsed = ticks() - start;
+        record(type, static_cast<uint32_t>(std::min<uint64_t>(elapsed, UINT32_MAX)));
+    }
+
+    struct ThreadEvents {
+        uint32_t thread = 0;
+        // Oldest first.
+        std::vector<Event> events;
+    };
+
+    struct Dump {
+        std::string reason;
+        int64_t unix_ms = 0;  // when the dump was taken
+        uint64_t ticks = 0;   // the tick counter at that moment
+        double ticks_per_us = 1000.0;
+        std::vector<ThreadEvents> threads;
+    };
+
+    namespace detail {
+        template<typename T>
+        void put(std::string& out, T value) {
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                out += static_cast<char>((value >> (8 * i)) & 0xff);
+            }
+        }
+
+        template<typename T>
+        bool take(std::string_view& in, T& value) {
+            if (in.size() < sizeof(T)) {
+                return false;
+            }
+            value = 0;
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                value |= static_cast<T>(static_cast<unsigned char>(in[i])) << (8 * i);
+            }
+            in.remove_prefix(sizeof(T));
+            return true;
+        }
+
+        inline constexpr std::string_view kMagic = "FLTREC1\n";
+    }
+
+    // Layout, little-endian:
+    //
+    //   8 bytes  "FLTREC1\n"
+    //   u64      unix_ms, ticks; the bits of ticks_per_us as a double
+    //   u32      reason length, then the reason
+    //   u32      thread count, then per thread: thread number, event count, and the events
+    //            as u64 ticks, u32 value, u16 type, u16 request
+    inline std::string encode(const Dump& dump) {
+        std::string out(detail::kMagic);
+        detail::put(out, static_cast<uint64_t>(dump.unix_ms));
+        detail::put(out, dump.ticks);
+        uint64_t rate_bits = 0;
+        std::memcpy(&rate_bits, &dump.ticks_per_us, sizeof(rate_bits));
+        detail::put(out, rate_bits);
+        detail::put(out, static_cast<uint32_t>(dump.reason.size()));
+        out += dump.reason;
+        detail::put(out, static_cast<uint32_t>(dump.threads.size()));
+        for (const auto& thread : dump.threads) {
+            detail::put(out, thread.thread);
+            detail::put(out, static_cast<uint32_t>(thread.events.size()));
+            for (const Event& event : thread.events) {
+                detail::put(out, event.ticks);
+                detail::put(out, event.value);
+                detail::put(out, event.type);
+                detail::put(out, event.request);
+            }
+        }
+        return out;
+    }
+
+    inline std::optional<Dump> decode(std::string_view in) {
+        if (in.substr(0, detail::kMagic.size()) != detail::kMagic) {
+            return std::nullopt;
+        }
+        in.remove_prefix(detail::kMagic.size());
+        Dump dump;
+        uint64_t unix_ms = 0;
+        uint64_t rate_bits = 0;
+        uint32_t reason_size = 0;
+        uint32_t thread_count = 0;
+        if (!detail::take(in, unix_ms) || !detail::take(in, dump.ticks) || !detail::take(in, rate_bits) ||
+            !detail::take(in, reason_size) || in.size() < reason_size) {
+            return std::nullopt;
+        }
+        dump.unix_ms = static_cast<int64_t>(unix_ms);
+        std::memcpy(&dump.ticks_per_us, &rate_bits, sizeof(rate_bits));
+        dump.reason = std::string(in.substr(0, reason_size));
+        in.remove_prefix(reason_size);
+        if (!detail::take(in, thread_count)) {
+            return std::nullopt;
+        }
+        for (uint32_t t = 0; t < thread_count; ++t) {
+            ThreadEvents thread;
+            uint32_t event_count = 0;
+            if (!detail::take(in, thread.thread) || !detail::take(in, event_count) ||
+                in.size() / sizeof(Event) < event_count) {
+                return std::nullopt;
+            }
+            thread.events.resize(event_count);
+            for (Event& event : thread.events) {
+                detail::take(in, event.ticks);
+                detail::take(in, event.value);
+                detail::take(in, event.type);
+                detail::take(in, event.request);
+            }
+            dump.threads.push_back(std::move(thread));
+        }
+        if (!in.empty()) {
+            return std::nullopt;
+        }
+        return dump;
+    }
+
+    // One line per event, all threads merged oldest first: milliseconds before the dump,
+    // thread, request and event. request_end lines add the request's duration when its
+    // request_start is in the dump too.
+    inline std::string timeline(const Dump& dump) {
+        struct Line {
+            uint32_t thread;
+            Event event;
+        };
+        std::vector<Line> lines;
+        for (const auto& thread : dump.threads) {
+            for (const Event& event : thread.events) {
+                lines.push_back(Line{thread.thread, event});
+            }
+        }
+        std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) {
+            return a.event.ticks < b.event.ticks;
+        });
+
+        const double ticks_per_ms = dump.ticks_per_us * 1000.0;
+        const auto before_dump_ms = [&](uint64_t at) {
+            return (static_cast<double>(at) - static_cast<double>(dump.ticks)) / ticks_per_ms;
+        };
+        std::unordered_map<uint16_t, uint64_t> started;
+        std::string out;
+        char line[160];
+        std::snprintf(line, sizeof(line), "# reason=%s unix_ms=%lld threads=%zu events=%zu\n", dump.reason.c_str(),
+                      static_cast<long long>(dump.unix_ms), dump.threads.size(), lines.size());
+        out += line;
+        for (const Line& entry : lines) {
+            const Event& event = entry.event;
+            const auto type = static_cast<Type>(event.type);
+            int written = std::snprintf(line, sizeof(line), "%12.3f ms  t%-3u req %-5u %-18s", before_dump_ms(event.ticks),
+                                        entry.thread, static_cast<unsigned>(event.request), type_name(type));
+            std::string detail;
+            char value[64];
+            if (type == Type::RequestStart) {
+                started[event.request] = event.ticks;
+            } else if (type == Type::RequestEnd) {
+                std::snprintf(value, sizeof(value), " status=%u", event.value);
+                detail = value;
+                const auto it = started.find(event.request);
+                if (it != started.end()) {
+                    std::snprintf(value, sizeof(value), " took=%.3f ms",
+                                  static_cast<double>(event.ticks - it->second) / ticks_per_ms);
+                    detail += value;
+                    started.erase(it);
+                }
+            } else if (type == Type::SqliteStep) {
+                std::snprintf(value, sizeof(value), " took=%.3f ms", static_cast<double>(event.value) / ticks_per_ms);
+                detail = value;
+            } else if (type == Type::DeadlineExceeded) {
+                std::snprintf(value, sizeof(value), " stage=%u", event.value);
+                detail = value;
+            }
+            out.append(line, static_cast<size_t>(std::max(0, std::min<int>(written, sizeof(line) - 1))));
+            if (detail.empty()) {
+                out.erase(out.find_last_not_of(' ') + 1);
+            }
+            out += detail;
+            out += '\n';
+        }
+        return out;
+    }
+
+    struct Options {
+        // Events kept per thread, rounded up to a power of two.
+        size_t events_per_thread = 4096;
+        // Where dump files go.
+        std::string directory = "logs";
+    };
+
+    // Starts recording on every thread and the background thread that writes dumps.
+    void start(const Options& options);
+    void stop();
+
+    inline bool enabled() {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    struct DumpResult {
+        bool ok = false;
+        std::string path;
+        size_t threads = 0;
+        size_t events = 0;
+    };
+
+    // Writes every ring to a new file in the dump directory now.
+    DumpResult dump(const std::string& reason);
+
+    // Has the background thread write a dump, so the I/O threads and the signal handler
+    // never wait on the file.
+    void request_dump(const std::string& reason);
+
+    // Requests a dump for a request that took `duration_ms`, if that reaches
+    // FLIGHT_RECORDER_SLOW_MS and no slow-request dump was written in the last 30 seconds.
+    void check_latency(int64_t duration_ms);
+}
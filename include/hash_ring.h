@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Consistent-hash ring. Each node is placed at `virtual_nodes` points on a 64-bit ring and a
+// key belongs to the first point at or after its hash, so adding or removing one node only
+// moves the keys in that node's arcs. Not thread-safe to modify; build it once, then share.
+class HashRing {
+public:
+    explicit HashRing(int virtual_nodes = 160) : virtual_nodes_(std::max(1, virtual_nodes)) {}
+
+    // Returns the index of the new node.
+    size_t add_node(const std::string& name) {
+        const auto index = static_cast<uint32_t>(node_count_++);
+        for (int i = 0; i < virtual_nodes_; ++i) {
+            points_.emplace_back(hash(name + "#" + std::to_string(i)), index);
+        }
+        std::sort(points_.begin(), points_.end());
+        return index;
+    }
+
+    size_t node_count() const {
+        return node_count_;
+    }
+
+    // Index of the node owning `key`. The ring must have at least one node.
+    size_t node_for(std::string_view key) const {
+        const uint64_t h = hash(key);
+        auto it = std::lower_bound(
+            points_.begin(), points_.end(), h, [](const std::pair<uint64_t, uint32_t>& point, uint64_t value) {
+                return point.first < value;
+            });
+        if (it == points_.end()) {
+            it = points_.begin();
+        }
+        return it->second;
+    }
+
+    // FNV-1a followed by the murmur3 finalizer, which spreads FNV's weak high bits.
+    static uint64_t hash(std::string_view data) {
+        uint64_t h = 1469598103934665603ULL;
+        for (const unsigned char c : data) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    int virtual_nodes_;
+    size_t node_count_ = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> points_;
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "order_codec.h"
+#include "order_filter.h"
+
+// Zero-downtime binary upgrade. A running server listens on a Unix domain socket for its
+// successor (started by SIGUSR2, or by hand with the same HOT_RESTART_SOCKET):
+//
+//   1. the successor connects and receives the listening TCP socket (SCM_RIGHTS);
+//   2. it starts accepting on it and reports back, so both processes accept for a moment
+//      and the kernel keeps queueing connections throughout;
+//   3. the predecessor stops accepting, waits for its requests to finish and its connections
+//      to close, and sends a snapshot of its process-local state: the metric counters and
+//      the order filter;
+//   4. the successor merges the snapshot in and the predecessor exits.
+//
+// POSIX only; elsewhere the server never finds a predecessor and ignores the socket.
+namespace hot_restart {
+    struct Options {
+        std::string socket_path;
+        // Started by spawn_successor(); empty means the running executable.
+        std::string binary_path;
+        // How long a successor gets to start accepting once it has the listener.
+        std::chrono::milliseconds accept_timeout{10000};
+        // How long a successor waits for the snapshot, i.e. for the predecessor's drain.
+        std::chrono::milliseconds state_timeout{60000};
+    };
+
+    struct Snapshot {
+        // Cumulative counters by metric name, added to the successor's own.
+        std::vector<std::pair<std::string, int64_t>> counters;
+        // Left out when the drain cut requests off: they may still change the filter.
+        std::optional<order_filter::State> filter;
+        int64_t drain_ms = 0;
+        int64_t requests_cut_off = 0;
+        int64_t connections_dropped = 0;
+    };
+
+    // Layout of format 1, varints as in order_codec.h:
+    //
+    //   byte 0   format (0x01)
+    //   varint   drain_ms, requests_cut_off, connections_dropped
+    //   varint   counter count, then per counter: name length, name, value
+    //   byte     1 when a filter follows, else 0
+    //   varint   hash_count, items, capacity, counters length, then the counter bytes
+    constexpr uint8_t kFormatV1 = 0x01;
+
+    inline std::string encode(const Snapshot& snapshot) {
+        std::string out;
+        out += static_cast<char>(kFormatV1);
+        order_codec::put_varint(out, static_cast<uint64_t>(snapshot.drain_ms));
+        order_codec::put_varint(out, static_cast<uint64_t>(snapshot.requests_cut_off));
+        order_codec::put_varint(out, static_cast<uint64_t>(snapshot.connections_dropped));
+        order_codec::put_varint(out, snapshot.counters.size());
+        for (const auto& [name, value] : snapshot.counters) {
+            order_codec::put_varint(out, name.size());
+            out += name;
+            order_codec::put_varint(out, static_cast<uint64_t>(value));
+        }
+        out += static_cast<char>(snapshot.filter ? 1 : 0);
+        if (snapshot.filter) {
+            order_codec::put_varint(out, static_cast<uint64_t>(snapshot.filter->hash_count));
+            order_codec::put_varint(out, static_cast<uint64_t>(snapshot.filter->items));
+            order_codec::put_varint(out, static_cast<uint64_t>(snapshot.filter->capacity));
+            order_codec::put_varint(out, snapshot.filter->counters.size());
+            out += snapshot.filter->counters;
+        }
+        return out;
+    }
+
+    inline std::optional<Snapshot> decode(std::string_view in) {
+        const auto take = [&in](size_t size, std::string& out) {
+            if (in.size() < size) {
+                return false;
+            }
+            out.assign(in.data(), size);
+            in.remove_prefix(size);
+            return true;
+        };
+        if (in.empty() || static_cast<uint8_t>(in.front()) != kFormatV1) {
+            return std::nullopt;
+        }
+        in.remove_prefix(1);
+
+        Snapshot snapshot;
+        uint64_t drain_ms = 0;
+        uint64_t cut_off = 0;
+        uint64_t dropped = 0;
+        uint64_t count = 0;
+        if (!order_codec::get_varint(in, drain_ms) || !order_codec::get_varint(in, cut_off) ||
+            !order_codec::get_varint(in, dropped) || !order_codec::get_varint(in, count)) {
+            return std::nullopt;
+        }
+        snapshot.drain_ms = static_cast<int64_t>(drain_ms);
+        snapshot.requests_cut_off = static_cast<int64_t>(cut_off);
+        snapshot.connections_dropped = static_cast<int64_t>(dropped);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t size = 0;
+            uint64_t value = 0;
+            std::string name;
+            if (!order_codec::get_varint(in, size) || !take(size, name) || !order_codec::get_varint(in, value)) {
+                return std::nullopt;
+            }
+            snapshot.counters.emplace_back(std::move(name), static_cast<int64_t>(value));
+        }
+
+        if (in.empty()) {
+            return std::nullopt;
+        }
+        const bool has_filter = in.front() == 1;
+        in.remove_prefix(1);
+        if (has_filter) {
+            order_filter::State filter;
+            uint64_t hash_count = 0;
+            uint64_t items = 0;
+            uint64_t capacity = 0;
+            uint64_t size = 0;
+            if (!order_codec::get_varint(in, hash_count) || !order_codec::get_varint(in, items) ||
+                !order_codec::get_varint(in, capacity) || !order_codec::get_varint(in, size) ||
+                !take(size, filter.counters)) {
+                return std::nullopt;
+            }
+            filter.hash_count = static_cast<int>(hash_count);
+            filter.items = static_cast<int64_t>(items);
+            filter.capacity = static_cast<int64_t>(capacity);
+            snapshot.filter = std::move(filter);
+        }
+        return in.empty() ? std::optional<Snapshot>(std::move(snapshot)) : std::nullopt;
+    }
+
+#ifndef _WIN32
+    // Frames on the handoff socket: a type byte, a 4-byte length and the payload. The listener
+    // frame carries the TCP socket as SCM_RIGHTS ancillary data. Both sides of a handover use
+    // these; they work on any connected stream socket, including a socketpair.
+    inline constexpr char kListenerFrame = 'L';
+    inline constexpr char kAcceptingFrame = 'A';
+    inline constexpr char kSnapshotFrame = 'S';
+    inline constexpr size_t kFrameHeader = 5;
+    inline constexpr uint32_t kMaxFrame = 1u << 30;
+
+    inline bool wait_readable(int fd, std::chrono::steady_clock::time_point deadline) {
+        while (true) {
+            const auto remaining =
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                return false;
+            }
+            pollfd pfd{fd, POLLIN, 0};
+            const int rc = poll(&pfd, 1, static_cast<int>(std::min<int64_t>(remaining, INT_MAX)));
+            if (rc > 0) {
+                return true;
+            }
+            if (rc < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    inline bool write_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            const ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    inline bool send_frame(int fd, char type, const std::string& payload, int pass_fd = -1) {
+        char header[kFrameHeader];
+        header[0] = type;
+        const auto size = static_cast<uint32_t>(payload.size());
+        std::memcpy(header + 1, &size, sizeof(size));
+
+        iovec iov{header, sizeof(header)};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        if (pass_fd >= 0) {
+            std::memset(control, 0, sizeof(control));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+        }
+        ssize_t sent = -1;
+        do {
+            sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0) {
+            return false;
+        }
+        const auto header_sent = static_cast<size_t>(sent);
+        return write_all(fd, header + header_sent, sizeof(header) - header_sent) &&
+               write_all(fd, payload.data(), payload.size());
+    }
+
+    // Reads one frame of `type`. A descriptor passed along with it lands in *received_fd.
+    inline bool recv_frame(int fd, char type, std::chrono::steady_clock::time_point deadline, std::string& payload,
+                           int* received_fd = nullptr) {
+        char header[kFrameHeader];
+        size_t got = 0;
+        while (got < sizeof(header)) {
+            if (!wait_readable(fd, deadline)) {
+                return false;
+            }
+            iovec iov{header + got, sizeof(header) - got};
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            const ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                    int passed = -1;
+                    std::memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+                    if (received_fd != nullptr && *received_fd < 0) {
+                        *received_fd = passed;
+                    } else {
+                        close(passed);
+                    }
+                }
+            }
+            got += static_cast<size_t>(n);
+        }
+        uint32_t size = 0;
+        std::memcpy(&size, header + 1, sizeof(size));
+        if (header[0] != type || size > kMaxFrame) {
+            return false;
+        }
+
+        payload.resize(size);
+        got = 0;
+        while (got < size) {
+            if (!wait_readable(fd, deadline)) {
+                return false;
+            }
+            const ssize_t n = recv(fd, &payload[got], size - got, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            got += static_cast<size_t>(n);
+        }
+        return true;
+    }
+#endif
+
+    // This process's state to hand over / merged into this process's own.
+    Snapshot capture(int64_t drain_ms, int64_t requests_cut_off, int64_t connections_dropped);
+    void apply(const Snapshot& snapshot);
+
+    // Successor side. connect() receives the listener of the server on options.socket_path,
+    // or returns nullopt (a cold start) when none answers there. Once the server accepts on
+    // the listener, complete() reports that and waits for the predecessor's snapshot.
+    struct Takeover {
+        int channel = -1;
+        int listen_fd = -1;
+        std::chrono::steady_clock::time_point started;
+    };
+    std::optional<Takeover> connect(const Options& options);
+    std::optional<Snapshot> complete(Takeover& takeover, const Options& options);
+
+    // Predecessor side. Serves options.socket_path on a background thread until stop(). For a
+    // successor it sends listen_fd(); once the successor accepts, drain() stops this server
+    // accepting, waits for it to go idle and returns the snapshot, which is sent
+    // before stop_server() runs. If the successor fails first, this server keeps going.
+    bool start(const Options& options,
+               std::function<int()> listen_fd,
+               std::function<Snapshot()> drain,
+               std::function<void()> stop_server);
+    void stop();
+
+    // Starts options.binary_path as a successor process; it takes over on its own.
+    bool spawn_successor(const Options& options);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// HDR-style log-linear histogram. Values below 2^sub_bucket_bits are recorded exactly;
+// above that every power-of-two range is split into 2^(sub_bucket_bits - 1) linear
+// sub-buckets, so the relative error stays below 2^-(sub_bucket_bits - 1) at any scale.
+// Not thread-safe: keep one per thread and merge() them when reporting.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(int sub_bucket_bits = 11, int max_value_bits = 40)
+        : sub_bucket_bits_(sub_bucket_bits),
+          half_count_(int64_t{1} << (sub_bucket_bits - 1)),
+          max_value_((int64_t{1} << max_value_bits) - 1),
+          counts_(static_cast<size_t>(index_for(max_value_) + 1), 0) {}
+
+    void record(int64_t value, uint64_t count = 1) {
+        value = std::clamp<int64_t>(value, 0, max_value_);
+        counts_[static_cast<size_t>(index_for(value))] += count;
+        total_ += count;
+        sum_ += static_cast<double>(value) * static_cast<double>(count);
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        const size_t n = std::min(counts_.size(), other.counts_.size());
+        for (size_t i = 0; i < n; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<int64_t>::max();
+        max_ = 0;
+    }
+
+    uint64_t count() const { return total_; }
+    int64_t min() const { return total_ == 0 ? 0 : min_; }
+    int64_t max() const { return max_; }
+    double mean() const { return total_ == 0 ? 0.0 : sum_ / static_cast<double>(total_); }
+
+    // Returns the highest value equivalent to the bucket holding the requested percentile (0-100].
+    int64_t value_at_percentile(double percentile) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        const double clamped = std::clamp(percentile, 0.0, 100.0);
+        const uint64_t target = std::max<uint64_t>(
+            1, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(total_) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::min(highest_equivalent(static_cast<int64_t>(i)), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    int64_t index_for(int64_t value) const {
+        if (value < (half_count_ << 1)) {
+            return value;
+        }
+        int msb = 0;
+        for (int64_t v = value; v > 1; v >>= 1) {
+            ++msb;
+        }
+        const int shift = msb - sub_bucket_bits_ + 1;
+        return shift * half_count_ + (value >> shift);
+    }
+
+    int64_t highest_equivalent(int64_t index) const {
+        if (index < (half_count_ << 1)) {
+            return index;
+        }
+        const int64_t shift = index / half_count_ - 1;
+        const int64_t mantissa = index - shift * half_count_;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    int sub_bucket_bits_;
+    int64_t half_count_;
+    int64_t max_value_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    double sum_ = 0;
+    int64_t min_ = std::numeric_limits<int64_t>::max();
+    int64_t max_ = 0;
+};
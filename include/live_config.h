@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Performance settings that can change while the server runs, through POST /admin/config or
+// by editing CONFIG_FILE and sending SIGHUP. Settings are named after the environment
+// variables that set them at startup. A change is validated as a whole before any of it
+// applies, and each value lands in the atomic its readers already load, so request threads
+// pick it up on their next read without taking a lock.
+namespace live_config {
+    using Settings = std::vector<std::pair<std::string, std::string>>;
+
+    inline std::string_view trim(std::string_view text) {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // Parses KEY=VALUE lines, trimming both sides; blank lines and lines starting with '#'
+    // are skipped. Returns false, with the offending line in `error`, on a line without a key.
+    inline bool parse(std::string_view text, Settings& out, std::string& error) {
+        while (!text.empty()) {
+            const auto end = text.find('\n');
+            const std::string_view line = trim(text.substr(0, end));
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            if (line.empty() || line.front() == '#') {
+                continue;
+            }
+            const auto equals = line.find('=');
+            if (equals == std::string_view::npos || trim(line.substr(0, equals)).empty()) {
+                error = "expected KEY=VALUE, got \"" + std::string(line) + "\"";
+                return false;
+            }
+            out.emplace_back(std::string(trim(line.substr(0, equals))), std::string(trim(line.substr(equals + 1))));
+        }
+        return true;
+    }
+
+    // A whole decimal integer within [min, max]; nullopt otherwise.
+    inline std::optional<int> parse_int(std::string_view text, int min, int max) {
+        int value = 0;
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size() || value < min || value > max) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    struct Result {
+        bool ok = false;
+        std::string error;
+        // "NAME=value" for each setting whose value changed.
+        std::vector<std::string> changed;
+        int64_t generation = 0;
+    };
+
+    // One applied change, for GET /admin/config.
+    struct Generation {
+        int64_t number = 0;
+        int64_t applied_at = 0; // unix seconds
+        std::string source;
+        std::vector<std::string> changed;
+    };
+
+    // Applies every setting or, when one is unknown or invalid, none. A change that alters at
+    // least one value becomes a new generation; `source` says where it came from in the log.
+    Result apply(const Settings& settings, const std::string& source);
+
+    // The file reload() reads; empty disables it.
+    void set_file(const std::string& path);
+    // Applies the settings in the file; SIGHUP and POST /admin/config/reload land here.
+    Result reload(const std::string& source);
+
+    // Current value of every setting, in a fixed order.
+    Settings current();
+    // The most recent generations, oldest first.
+    std::vector<Generation> history();
+}
@@ -2,6 +2,9 @@
 #include <atomic>
 #include <algorithm>
 #include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
 
 namespace metrics {
     inline std::atomic<int> total_requests{0};
@@ -9,14 +12,106 @@ namespace metrics {
     inline std::atomic<int> orders_paid{0};
     inline std::atomic<int> cache_hits{0};
     inline std::atomic<int> cache_misses{0};
+    // Indexed by cache_policy::Policy (pending, paid, tombstone).
+    inline std::atomic<int64_t> cache_policy_hits[3]{};
+    inline std::atomic<int64_t> cache_policy_misses[3]{};
+    inline std::atomic<int64_t> cache_policy_writes[3]{};
+    inline std::atomic<int64_t> cache_policy_stale_writes[3]{};
     inline std::atomic<int> overload_rejections{0};
     inline std::atomic<int> shutdown_rejections{0};
     inline std::atomic<int> redis_errors{0};
     inline std::atomic<int> sqlite_errors{0};
     inline std::atomic<int> in_flight_requests{0};
+    // Indexed by request_deadline::Stage (queue, sqlite, redis).
+    inline std::atomic<int64_t> request_deadline_exceeded[3]{};
     inline std::atomic<int64_t> request_duration_ms_total{0};
     inline std::atomic<int64_t> request_duration_ms_max{0};
     inline std::atomic<int64_t> request_duration_samples{0};
+    inline std::atomic<int64_t> export_rows_total{0};
+    inline std::atomic<int64_t> export_last_rows_per_second{0};
+    inline std::atomic<int> exports_completed{0};
+    inline std::atomic<int> exports_aborted{0};
+    inline std::atomic<int64_t> orders_archived{0};
+    inline std::atomic<int> archive_runs{0};
+    inline std::atomic<int> archive_errors{0};
+    inline std::atomic<int> archive_vacuum_slices{0};
+    inline std::atomic<int> archive_hits{0};
+    inline std::atomic<int64_t> hot_orders_rows{0};
+    inline std::atomic<int64_t> archive_orders_rows{0};
+    inline std::atomic<int64_t> archive_lag_seconds{0};
+    inline std::atomic<int64_t> order_filter_short_circuits{0};
+    inline std::atomic<int64_t> order_filter_false_positives{0};
+    inline std::atomic<int64_t> order_filter_items{0};
+    inline std::atomic<int64_t> order_filter_capacity{0};
+    inline std::atomic<int> redis_breaker_transitions{0};
+    inline std::atomic<int64_t> redis_short_circuits{0};
+    inline std::atomic<int> redis_probes{0};
+    inline std::atomic<int> redis_probe_failures{0};
+    inline std::atomic<int> redis_pool_size{0};
+    inline std::atomic<int> redis_pool_in_use{0};
+    inline std::atomic<int64_t> redis_pool_checkouts{0};
+    inline std::atomic<int64_t> redis_pool_exhausted{0};
+    inline std::atomic<int64_t> redis_pool_timeouts{0};
+    inline std::atomic<int64_t> redis_pool_wait_us_total{0};
+    inline std::atomic<int64_t> redis_pool_wait_us_max{0};
+    // Hot restarts this server lineage went through, and how the last one went.
+    inline std::atomic<int> hot_restarts{0};
+    inline std::atomic<int64_t> hot_restart_handover_ms{0};
+    inline std::atomic<int64_t> hot_restart_state_ms{0};
+    inline std::atomic<int64_t> hot_restart_drain_ms{0};
+    inline std::atomic<int64_t> hot_restart_requests_cut_off{0};
+    inline std::atomic<int64_t> hot_restart_connections_dropped{0};
+    // Live configuration (see live_config.h): the generation in effect, when it was applied
+    // (unix seconds; 0 while the startup configuration is unchanged) and changes refused.
+    inline std::atomic<int64_t> config_generation{0};
+    inline std::atomic<int64_t> config_generation_timestamp_seconds{0};
+    inline std::atomic<int64_t> config_changes_rejected{0};
+    // Sampled request traces queued for TRACE_FILE, and those dropped with the writer behind.
+    inline std::atomic<int64_t> traces_exported{0};
+    inline std::atomic<int64_t> traces_dropped{0};
+    inline std::atomic<int64_t> flight_recorder_dumps{0};
+
+    // One entry per cache node, registered at startup before the server accepts requests.
+    struct CacheNodeStats {
+        explicit CacheNodeStats(std::string node_name) : name(std::move(node_name)) {}
+
+        std::string name;
+        std::atomic<int64_t> hits{0};
+        std::atomic<int64_t> misses{0};
+        std::atomic<int64_t> errors{0};
+        std::atomic<int64_t> short_circuits{0};
+        std::atomic<int> breaker_state{0};
+    };
+    inline std::deque<CacheNodeStats> cache_nodes;
+
+    // One entry per worker pool (see bounded_executor.h), registered at startup.
+    struct ExecutorStats {
+        explicit ExecutorStats(std::string pool_name) : name(std::move(pool_name)) {}
+
+        std::string name;
+        std::atomic<int> threads{0};
+        std::atomic<int> queue_capacity{0};
+        std::atomic<int> queue_depth{0};
+        std::atomic<int> active{0};
+        std::atomic<int64_t> submitted{0};
+        std::atomic<int64_t> rejected{0};
+        std::atomic<int64_t> completed{0};
+        std::atomic<int64_t> queue_wait_us_total{0};
+        std::atomic<int64_t> queue_wait_us_max{0};
+    };
+    inline std::deque<ExecutorStats> executors;
+
+    inline void observe_redis_pool_wait_us(int64_t wait_us) {
+        redis_pool_checkouts.fetch_add(1, std::memory_order_relaxed);
+        if (wait_us == 0) {
+            return;
+        }
+        redis_pool_wait_us_total.fetch_add(wait_us, std::memory_order_relaxed);
+        auto current_max = redis_pool_wait_us_max.load(std::memory_order_relaxed);
+        while (wait_us > current_max && !redis_pool_wait_us_max.compare_exchange_weak(
+                   current_max, wait_us, std::memory_order_relaxed, std::memory_order_relaxed)) {
+        }
+    }
 
     inline void observe_request_duration_ms(int64_t duration_ms) {
         request_duration_ms_total.fetch_add(duration_ms, std::memory_order_relaxed);
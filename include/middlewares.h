@@ -0,0 +1,151 @@
+#pragma once
+#include "crow_all.h"
+#include <chrono>
+#include <string>
+#include <spdlog/spdlog.h>
+#include "alloc_stats.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "order_utils.h"
+#include "request_trace.h"
+#include "runtime_config.h"
+#include "service_state.h"
+
+struct LoggingMiddleware;
+
+// The request's trace, kept in LoggingMiddleware's context; for the middlewares after it.
+template<typename AllContext>
+request_trace::Trace& middleware_trace(AllContext& all_ctx) {
+    return all_ctx.template get<LoggingMiddleware>().trace;
+}
+
+struct ErrorHandlerMiddleware {
+    struct context {}; // Required even if unused
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx) {
+        // Do nothing before request
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        if (res.code >= 400) {
+            // Log the error
+            spdlog::warn("Error {} on {} {}", res.code, crow::method_name(req.method), req.url);
+
+            // If response body is empty, fill with JSON error
+            if (res.body.empty()) {
+                std::string error_msg;
+
+                switch (res.code) {
+                    case 400: error_msg = "Bad Request"; break;
+                    case 404: error_msg = "Not Found"; break;
+                    case 500: error_msg = "Internal Server Error"; break;
+                    default:  error_msg = "HTTP Error"; break;
+                }
+
+                crow::json::wvalue json;
+                json["error"] = error_msg;
+                json["code"] = res.code;
+                res.set_header("Content-Type", "application/json");
+                res.body = json.dump(); 
+            }
+        }
+    }
+};
+
+struct LifecycleMiddleware {
+    struct context {
+        bool counted_inflight = false;
+    };
+
+    template<typename AllContext>
+    void before_handle(crow::request& req, crow::response& res, context& ctx, AllContext& all_ctx) {
+        if (service_state::is_probe_path(req.url)) {
+            return;
+        }
+        request_trace::Timer admission(request_trace::Stage::Admission, &middleware_trace(all_ctx));
+
+        // Counted before the shutdown check, so a drain that sees no requests in flight after
+        // clearing handing_over knows every later request is turned away.
+        const int current_inflight = metrics::in_flight_requests.fetch_add(1) + 1;
+        if (service_state::shutting_down.load() && !service_state::handing_over.load()) {
+            metrics::in_flight_requests.fetch_sub(1);
+            service_state::notify_request_finished();
+            metrics::shutdown_rejections.fetch_add(1, std::memory_order_relaxed);
+            flight_recorder::record(flight_recorder::Type::ShedShutdown, 503, middleware_trace(all_ctx).id());
+            res = json_error(503, "Server is shutting down");
+            res.set_header("Retry-After", "5");
+            res.set_header("Connection", "close");
+            res.end();
+            return;
+        }
+
+        ctx.counted_inflight = true;
+        if (current_inflight > service_state::max_inflight_requests.load(std::memory_order_relaxed)) {
+            metrics::in_flight_requests.fetch_sub(1, std::memory_order_relaxed);
+            ctx.counted_inflight = false;
+            metrics::overload_rejections.fetch_add(1, std::memory_order_relaxed);
+            flight_recorder::record(flight_recorder::Type::ShedOverload, 503, middleware_trace(all_ctx).id());
+            res = json_error(503, "Server overloaded");
+            res.set_header("Retry-After", "1");
+            res.end();
+        }
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        if (ctx.counted_inflight) {
+            // Counted out once the response is on the wire, so a drain that sees no requests in
+            // flight can't cut a final write short.
+            res.on_written([] {
+                metrics::in_flight_requests.fetch_sub(1);
+                service_state::notify_request_finished();
+            });
+        }
+        // Keep-alive clients reconnect elsewhere instead of reusing a connection that is about
+        // to be closed.
+        if (service_state::shutting_down.load(std::memory_order_relaxed)) {
+            res.set_header("Connection", "close");
+        }
+    }
+};
+
+struct LoggingMiddleware {
+    struct context {
+        std::chrono::steady_clock::time_point start_time;
+        request_trace::Trace trace;
+        alloc_stats::Account allocations; // charged only while ALLOC_TRACKING is on
+    };
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx) {
+    //Crow calls this function internally as part of its request lifecycle, and it expects all three parameters to be there.
+        ctx.start_time = std::chrono::steady_clock::now();
+        ctx.trace.set_id(request_trace::next_request_id());
+        flight_recorder::record(flight_recorder::Type::RequestStart, 0, ctx.trace.id());
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        auto end_time = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - ctx.start_time).count();
+        metrics::total_requests.fetch_add(1, std::memory_order_relaxed);
+        metrics::observe_request_duration_ms(duration);
+        flight_recorder::record(flight_recorder::Type::RequestEnd, static_cast<uint32_t>(res.code), ctx.trace.id());
+        flight_recorder::check_latency(duration);
+
+        spdlog::info("{} {} {} ({} ms)", crow::method_name(req.method), req.url, res.code, duration);
+
+        if (runtime_config::server_timing.load(std::memory_order_relaxed)) {
+            res.set_header("Server-Timing", request_trace::server_timing(ctx.trace, end_time - ctx.start_time));
+        }
+        if (runtime_config::alloc_tracking.load(std::memory_order_relaxed)) {
+            // Stop charging, so the headers show what the route recorded.
+            alloc_stats::Scope untracked(nullptr);
+            static const std::string unmatched = "unmatched";
+            alloc_stats::record(req.matched_rule != nullptr ? *req.matched_rule : unmatched, ctx.allocations);
+            res.set_header("X-Allocations", std::to_string(ctx.allocations.allocations.load(std::memory_order_relaxed)));
+            res.set_header("X-Allocated-Bytes", std::to_string(ctx.allocations.bytes.load(std::memory_order_relaxed)));
+        }
+        if (request_trace::sample()) {
+            request_trace::export_request(ctx.trace, std::string(crow::method_name(req.method)) + " " + req.url,
+                                          ctx.start_time, end_time - ctx.start_time, res.code);
+        }
+    }
+};
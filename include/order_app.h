@@ -0,0 +1,33 @@
+#pragma once
+#include "crow_all.h"
+#include "alloc_stats.h"
+#include "auth_middleware.h"
+#include "middlewares.h"
+#include "request_trace.h"
+
+using OrderApp = crow::App<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware>;
+
+// The trace LoggingMiddleware keeps for `req`, or nullptr for a request that didn't come
+// through the middleware chain.
+inline request_trace::Trace* request_trace_of(const crow::request& req) {
+    if (req.middleware_context == nullptr) {
+        return nullptr;
+    }
+    return &static_cast<OrderApp::context_t*>(req.middleware_context)->get<LoggingMiddleware>().trace;
+}
+
+// The allocation account LoggingMiddleware keeps for `req` while ALLOC_TRACKING is on;
+// nullptr when it is off or the request didn't come through the middleware chain.
+inline alloc_stats::Account* alloc_account_of(const crow::request& req) {
+    if (req.middleware_context == nullptr || !runtime_config::alloc_tracking.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return &static_cast<OrderApp::context_t*>(req.middleware_context)->get<LoggingMiddleware>().allocations;
+}
+
+// Charges what Crow's I/O threads do for a request (middlewares, handler, after handlers) to
+// its allocation account. The executor stages in order_routes.cpp charge their own part.
+void track_request_allocations();
+
+// Adds the probe, order and metrics routes. Shared by the server and the in-process benchmarks.
+void register_routes(OrderApp& app);
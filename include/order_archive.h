@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+struct sqlite3;
+
+// Hot/cold tiering: PAID orders older than a configurable age are moved from the hot
+// `orders` table into a separate archive database file by a background thread. Its batch size
+// and interval are runtime_config settings, read on every run.
+namespace order_archive {
+    struct Options {
+        std::string db_path = "orders.db";
+        std::string archive_path = "orders_archive.db";
+        int archive_after_seconds = 7 * 24 * 3600;
+        int vacuum_pages_per_slice = 256;
+    };
+
+    // Attaches the archive file to `db` as schema `archive`, creating its table if needed.
+    bool attach(sqlite3* db, const std::string& archive_path);
+    bool is_attached();
+
+    void start(const Options& options);
+    void stop();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace order_cache {
+    inline std::string order_key(const std::string& order_no) {
+        return "order:" + order_no;
+    }
+
+    // Versioned values start with "<version>:". A conditional write never replaces a value
+    // whose version is higher; -1 means the value carries no version and may be replaced.
+    inline int64_t value_version(const std::string& value) {
+        const auto colon = value.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            return -1;
+        }
+        char* end = nullptr;
+        const long long version = std::strtoll(value.c_str(), &end, 10);
+        return end == value.c_str() + colon ? version : -1;
+    }
+
+    struct VersionedEntry {
+        std::string key;
+        std::string value; // already prefixed with "<version>:"
+        int64_t version = 0;
+        std::chrono::seconds ttl{0};
+    };
+
+    // Thrown when a call is refused without reaching the store, e.g. by an open circuit breaker.
+    class Unavailable : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Key/value store the order routes cache through. Production uses Redis; benchmarks and
+    // tests can swap in InMemoryBackend. Failures are reported by throwing std::exception.
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+        virtual void set(const std::string& key, const std::string& value, std::chrono::seconds ttl) = 0;
+        virtual std::optional<std::string> get(const std::string& key) = 0;
+        virtual void del(const std::string& key) = 0;
+        virtual void ping() = 0;
+
+        // Stores `value` unless the key already holds a higher version, atomically with respect
+        // to other writers. Returns false when the write lost to a newer one.
+        virtual bool set_if_newer(
+            const std::string& key, const std::string& value, int64_t version, std::chrono::seconds ttl) = 0;
+
+        // set_if_newer for many entries. Backends that can batch round trips override this.
+        virtual void set_many(const std::vector<VersionedEntry>& entries) {
+            for (const auto& entry : entries) {
+                set_if_newer(entry.key, entry.value, entry.version, entry.ttl);
+            }
+        }
+    };
+
+    // In-process stand-in with the same TTL semantics as Redis SET EX, for running the full
+    // request path without a Redis server.
+    class InMemoryBackend : public Backend {
+    public:
+        void set(const std::string& key, const std::string& value, std::chrono::seconds ttl) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_[key] = Entry{value, std::chrono::steady_clock::now() + ttl};
+        }
+
+        std::optional<std::string> get(const std::string& key) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = entries_.find(key);
+            if (it == entries_.end()) {
+                return std::nullopt;
+            }
+            if (it->second.expires_at <= std::chrono::steady_clock::now()) {
+                entries_.erase(it);
+                return std::nullopt;
+            }
+            return it->second.value;
+        }
+
+        void del(const std::string& key) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.erase(key);
+        }
+
+        void ping() override {}
+
+        bool set_if_newer(const std::string& key, const std::string& value, int64_t version, std::chrono::seconds ttl) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            const auto it = entries_.find(key);
+            if (it != entries_.end() && it->second.expires_at > now && value_version(it->second.value) > version) {
+                return false;
+            }
+            entries_[key] = Entry{value, now + ttl};
+            return true;
+        }
+
+    private:
+        struct Entry {
+            std::string value;
+            std::chrono::steady_clock::time_point expires_at;
+        };
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+    };
+}
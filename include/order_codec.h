@@ -0,0 +1,107 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Compact binary form of a cached order. The order number is the cache key, so it is not
+// repeated in the value. Layout of format 1:
+//
+//   byte 0   format (0x01)
+//   byte 1   status (0 PENDING, 1 PAID)
+//   varint   amount in minor units (cents), zigzag-encoded
+//   varint   created_at, unix seconds
+//   varint   paid_at, unix seconds, 0 when unpaid
+//
+// JSON payloads always start with '{', so readers tell the formats apart by the first byte
+// and both can sit in the cache side by side during a rollout. A reader that meets a format
+// newer than it knows treats the entry as a miss.
+namespace order_codec {
+    constexpr uint8_t kFormatV1 = 0x01;
+
+    struct Order {
+        double amount = 0;
+        std::string_view status;
+        int64_t created_at = 0;
+        int64_t paid_at = 0;
+    };
+
+    inline bool is_json(std::string_view payload) {
+        return !payload.empty() && payload.front() == '{';
+    }
+
+    inline void put_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    inline bool get_varint(std::string_view& in, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+            const auto byte = static_cast<uint8_t>(in.front());
+            in.remove_prefix(1);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // nullopt when the order can't be represented exactly (unknown status, sub-cent or
+    // out-of-range amount); the caller then caches JSON instead.
+    inline std::optional<std::string> encode(const Order& order) {
+        uint8_t status = 0;
+        if (order.status == "PENDING") {
+            status = 0;
+        } else if (order.status == "PAID") {
+            status = 1;
+        } else {
+            return std::nullopt;
+        }
+        const double cents = order.amount * 100.0;
+        if (!(std::fabs(cents) < 1e15) || std::fabs(cents - std::round(cents)) > 1e-6 ||
+            order.created_at < 0 || order.paid_at < 0) {
+            return std::nullopt;
+        }
+        const auto minor = static_cast<int64_t>(std::llround(cents));
+
+        std::string out;
+        out.reserve(24);
+        out += static_cast<char>(kFormatV1);
+        out += static_cast<char>(status);
+        put_varint(out, (static_cast<uint64_t>(minor) << 1) ^ static_cast<uint64_t>(minor >> 63));
+        put_varint(out, static_cast<uint64_t>(order.created_at));
+        put_varint(out, static_cast<uint64_t>(order.paid_at));
+        return out;
+    }
+
+    inline std::optional<Order> decode(std::string_view payload) {
+        if (payload.size() < 2 || static_cast<uint8_t>(payload[0]) != kFormatV1) {
+            return std::nullopt;
+        }
+        const auto status = static_cast<uint8_t>(payload[1]);
+        if (status > 1) {
+            return std::nullopt;
+        }
+        payload.remove_prefix(2);
+        uint64_t zigzag = 0;
+        uint64_t created_at = 0;
+        uint64_t paid_at = 0;
+        if (!get_varint(payload, zigzag) || !get_varint(payload, created_at) || !get_varint(payload, paid_at)) {
+            return std::nullopt;
+        }
+        const auto minor = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+
+        Order order;
+        order.amount = static_cast<double>(minor) / 100.0;
+        order.status = status == 1 ? "PAID" : "PENDING";
+        order.created_at = static_cast<int64_t>(created_at);
+        order.paid_at = static_cast<int64_t>(paid_at);
+        return order;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct sqlite3;
+
+// Membership filter over every existing order number (hot and archive tables). Lookups for
+// order numbers the filter has never seen are answered 404 without touching Redis or
+// SQLite. Built once at startup, then kept current by create and delete; orders inserted
+// behind the server's back (e.g. tools/order_loader against a live database) are only
+// picked up on the next start.
+namespace order_filter {
+    struct Options {
+        double false_positive_rate = 0.01;
+        int64_t min_capacity = 100000;
+    };
+
+    // Sizes the filter for twice the current row count (at least min_capacity) so it stays
+    // near the target rate as orders grow. Call before the server accepts requests. On
+    // failure the filter stays disabled and might_contain() always returns true.
+    bool build(sqlite3* db, const Options& options);
+
+    // Hot restart (see hot_restart.h): instead of scanning the tables, a successor process
+    // awaits the predecessor's filter. Until restore() (or build(), as the fallback) installs
+    // one, the filter is disabled and the creates and deletes served meanwhile are journaled,
+    // then applied on top of the installed filter.
+    void await_handoff();
+
+    struct State {
+        int hash_count = 0;
+        std::string counters;
+        int64_t items = 0;
+        int64_t capacity = 0;
+    };
+    // Only consistent while no create or delete is running. nullopt while disabled.
+    std::optional<State> state();
+    bool restore(const State& state);
+
+    bool enabled();
+    bool might_contain(const std::string& order_no);
+    void add(const std::string& order_no);
+    void remove(const std::string& order_no);
+}
@@ -1,9 +1,25 @@
 #pragma once
+#include "bounded_executor.h"
 #include "crow_all.h"
+#include "route_coroutine.h"
 #include <string>
 
-crow::response create_order(const crow::request& req);
-crow::response get_order(const std::string& order_no);
-crow::response pay_order(const crow::request& req);
-crow::response list_orders(const crow::request& req);
-crow::response delete_order(const std::string& order_no);
+// Order handlers hand their SQLite and Redis work to storage_executors and complete `res`
+// asynchronously, so Crow's I/O threads never block on storage.
+void create_order(const crow::request& req, crow::response& res);
+#ifdef ORDER_SERVICE_COROUTINES
+// Converted handlers; register them through route_coro::route().
+route_coro::Response get_order(const crow::request& req, std::string order_no);
+#else
+void get_order(const crow::request& req, crow::response& res, const std::string& order_no);
+#endif
+void pay_order(const crow::request& req, crow::response& res);
+void list_orders(const crow::request& req, crow::response& res);
+void delete_order(const crow::request& req, crow::response& res, const std::string& order_no);
+
+// Reads bounded keyset slices on its own read-only connection while the response is written,
+// so it stays on the I/O thread and never holds a lock on the shared connection.
+crow::response export_orders(const crow::request& req);
+
+// 503 with Retry-After, for a request shed because `executor`'s queue is full.
+crow::response storage_busy(const BoundedExecutor& executor);
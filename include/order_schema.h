@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Single source of truth for the orders table layout. The hot database, the archive
+// database and the bulk loader all create their tables through these helpers.
+namespace order_schema {
+    inline std::string create_orders_table_sql(const std::string& schema = "main") {
+        return "CREATE TABLE IF NOT EXISTS " + schema + R"(.orders(
+            order_no TEXT PRIMARY KEY,
+            amount REAL,
+            status TEXT,
+            created_at INTEGER,
+            paid_at INTEGER
+        );)";
+    }
+
+    inline std::string create_orders_indexes_sql(const std::string& schema = "main") {
+        return "CREATE INDEX IF NOT EXISTS " + schema + ".idx_orders_created_at ON orders(created_at);"
+               "CREATE INDEX IF NOT EXISTS " + schema + ".idx_orders_status_paid_at ON orders(status, paid_at);";
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "crow_all.h"
+#include <ctime>
+#include <optional>
+#include <string>
+
+std::string generate_order_no();
+std::string format_time(time_t t);
+crow::response json_error(int code, const std::string& message);
+
+// Order body as returned by GET /order/get.
+crow::json::wvalue order_json(const std::string& order_no, double amount, const std::string& status, time_t created_at, time_t paid_at);
+
+// Cache value for an order: the compact binary form from order_codec.h while
+// runtime_config::cache_binary_encoding is set and the order fits it, JSON otherwise.
+std::string order_cache_payload(const std::string& order_no, double amount, const std::string& status, time_t created_at, time_t paid_at);
+
+// Response body for a cached value in any format this build understands; nullopt otherwise.
+std::optional<std::string> render_cached_order(const std::string& order_no, const std::string& payload);
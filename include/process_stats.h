@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+// Process resource usage read from the kernel when /metrics asks for it, so nothing is
+// counted between scrapes. Threads are told apart by name: Crow names its I/O threads
+// crow-io-N and executor pools name theirs <pool>-N. Linux only; elsewhere it reads zero.
+namespace process_stats {
+    // Names the calling thread; the kernel keeps the first 15 characters.
+    inline void name_this_thread(const std::string& name) {
+#ifdef __linux__
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#else
+        (void)name;
+#endif
+    }
+
+    int64_t resident_bytes();
+    // User plus system time of the whole process.
+    double cpu_seconds();
+
+    struct ThreadCpu {
+        std::string name;
+        // Threads with this name now; the time of threads that exited is gone.
+        int threads = 0;
+        double cpu_seconds = 0;
+    };
+
+    // CPU time of the live threads, summed per name, sorted by name.
+    std::vector<ThreadCpu> threads();
+}
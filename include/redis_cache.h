@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "order_cache.h"
+
+namespace order_cache {
+    struct RedisOptions {
+        std::string host = "127.0.0.1";
+        int port = 6379;
+        int pool_size = 1;
+        int pool_wait_timeout_ms = 100;
+        int connect_timeout_ms = 200;
+        int socket_timeout_ms = 200;   // applies to both reads and writes
+        int connection_lifetime_ms = 0; // 0 keeps connections forever
+    };
+
+    // Creates a pooled Redis client. Construction does not touch the network; call ping()
+    // to find out whether the server is reachable. Every call checks a connection out of
+    // the pool through a gate that records wait time and exhaustion in metrics::redis_pool_*.
+    std::unique_ptr<Backend> make_redis_backend(const RedisOptions& options);
+}
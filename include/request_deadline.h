@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+// Per-request deadlines. Handlers derive one from the request, check it before each storage
+// stage runs, and install it for the stage's thread with a Scope so storage code deeper down
+// can bound or abort its work without the deadline being threaded through every call.
+namespace request_deadline {
+    using Clock = std::chrono::steady_clock;
+
+    // Where deadline-exceeded work was cut off: still waiting in an executor queue, inside a
+    // SQLite statement, or before a Redis call.
+    enum class Stage { Queue = 0, Sqlite = 1, Redis = 2 };
+    inline constexpr size_t kStageCount = 3;
+
+    inline const char* stage_name(Stage stage) {
+        switch (stage) {
+            case Stage::Queue: return "queue";
+            case Stage::Sqlite: return "sqlite";
+            case Stage::Redis: return "redis";
+        }
+        return "unknown";
+    }
+
+    // A default-constructed deadline never expires.
+    struct Deadline {
+        Clock::time_point at = Clock::time_point::max();
+
+        static Deadline after(std::chrono::milliseconds budget) {
+            return Deadline{Clock::now() + budget};
+        }
+
+        bool expired(Clock::time_point now = Clock::now()) const {
+            return now >= at;
+        }
+
+        std::chrono::milliseconds remaining(Clock::time_point now = Clock::now()) const {
+            if (at == Clock::time_point::max()) {
+                return std::chrono::milliseconds::max();
+            }
+            return std::max(std::chrono::milliseconds(0), std::chrono::duration_cast<std::chrono::milliseconds>(at - now));
+        }
+    };
+
+    namespace detail {
+        inline thread_local const Deadline* current = nullptr;
+        inline thread_local bool interrupted = false;
+    }
+
+    // Makes `deadline` the calling thread's deadline until the scope ends. Never keep one
+    // across a co_await: the coroutine may resume on another thread.
+    class Scope {
+    public:
+        explicit Scope(const Deadline& deadline)
+            : previous_(detail::current), previous_interrupted_(detail::interrupted) {
+            detail::current = &deadline;
+            detail::interrupted = false;
+        }
+
+        ~Scope() {
+            detail::current = previous_;
+            detail::interrupted = previous_interrupted_;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const Deadline* previous_;
+        bool previous_interrupted_;
+    };
+
+    // The calling thread's deadline, or nullptr outside any Scope.
+    inline const Deadline* current() {
+        return detail::current;
+    }
+
+    inline bool current_expired() {
+        return detail::current != nullptr && detail::current->expired();
+    }
+
+    // Whether a SQLite statement was aborted for the current scope's deadline.
+    inline bool interrupted() {
+        return detail::interrupted;
+    }
+
+    // sqlite3_progress_handler callback. It runs on the thread stepping the statement, so it
+    // only aborts that request's statement; sqlite3_interrupt() would abort every statement
+    // on the shared connection.
+    inline int sqlite_progress(void*) {
+        if (current_expired()) {
+            detail::interrupted = true;
+            return 1;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Per-request stage timing. LoggingMiddleware keeps a Trace for every request; the middlewares
+// after it time themselves into it, run_stage installs it with a Scope on the executor thread
+// running a storage stage, and code deeper down times its part with a Timer. When the request
+// ends its spans become a Server-Timing header and, for sampled requests, trace events.
+namespace request_trace {
+    using Clock = std::chrono::steady_clock;
+
+    enum class Stage { Parse = 0, Auth = 1, Admission = 2, Queue = 3, Cache = 4, Db = 5, Serialize = 6 };
+    inline constexpr size_t kStageCount = 7;
+
+    inline const char* stage_name(Stage stage) {
+        switch (stage) {
+            case Stage::Parse: return "parse";
+            case Stage::Auth: return "auth";
+            case Stage::Admission: return "admission";
+            case Stage::Queue: return "queue";
+            case Stage::Cache: return "cache";
+            case Stage::Db: return "db";
+            case Stage::Serialize: return "serialize";
+        }
+        return "unknown";
+    }
+
+    // A small number for the calling thread, stable for its lifetime; trace viewers group
+    // events into one lane per number.
+    inline uint32_t thread_number() {
+        static std::atomic<uint32_t> next{1};
+        thread_local const uint32_t number = next.fetch_add(1, std::memory_order_relaxed);
+        return number;
+    }
+
+    struct Span {
+        Stage stage = Stage::Parse;
+        Clock::time_point start;
+        Clock::duration duration{};
+        uint32_t thread = 0;
+    };
+
+    // The stages of a request run one after another, possibly on different threads, and each
+    // hand-off goes through an executor queue or a post() to the I/O thread, so spans are
+    // appended without a lock. A request with more than kMaxSpans spans keeps the first ones.
+    class Trace {
+    public:
+        static constexpr size_t kMaxSpans = 16;
+
+        void add(Stage stage, Clock::time_point start, Clock::time_point end = Clock::now()) {
+            if (count_ < kMaxSpans) {
+                spans_[count_++] = Span{stage, start, end - start, thread_number()};
+            }
+        }
+
+        size_t size() const {
+            return count_;
+        }
+
+        // Tags the request's flight recorder events; 0 for none.
+        uint32_t id() const {
+            return id_;
+        }
+
+        void set_id(uint32_t id) {
+            id_ = id;
+        }
+
+        const Span& operator[](size_t index) const {
+            return spans_[index];
+        }
+
+        // Time spent in `stage` over all of its spans.
+        Clock::duration total(Stage stage) const {
+            Clock::duration sum{};
+            for (size_t i = 0; i < count_; ++i) {
+                if (spans_[i].stage == stage) {
+                    sum += spans_[i].duration;
+                }
+            }
+            return sum;
+        }
+
+    private:
+        std::array<Span, kMaxSpans> spans_{};
+        size_t count_ = 0;
+        uint32_t id_ = 0;
+    };
+
+    inline uint32_t next_request_id() {
+        static std::atomic<uint32_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    namespace detail {
+        inline thread_local Trace* current = nullptr;
+    }
+
+    // Makes `trace` the calling thread's trace until the scope ends; a null trace records
+    // nothing. Never keep one across a co_await: the coroutine may resume on another thread.
+    class Scope {
+    public:
+        explicit Scope(Trace* trace) : previous_(detail::current) {
+            detail::current = trace;
+        }
+
+        ~Scope() {
+            detail::current = previous_;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Trace* previous_;
+    };
+
+    // The calling thread's trace, or nullptr outside any Scope.
+    inline Trace* current() {
+        return detail::current;
+    }
+
+    // Records the time until finish(), or until it goes out of scope, as a span of `stage`.
+    class Timer {
+    public:
+        explicit Timer(Stage stage, Trace* trace = current())
+            : trace_(trace), stage_(stage), start_(trace != nullptr ? Clock::now() : Clock::time_point()) {}
+
+        ~Timer() {
+            finish();
+        }
+
+        void finish() {
+            if (trace_ != nullptr) {
+                trace_->add(stage_, start_);
+                trace_ = nullptr;
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Trace* trace_;
+        Stage stage_;
+        Clock::time_point start_;
+    };
+
+    inline double to_ms(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // Server-Timing header value: one metric per stage the request went through, in stage
+    // order with its spans summed, then the whole request as "total". Milliseconds.
+    inline std::string server_timing(const Trace& trace, Clock::duration total) {
+        std::string header;
+        char metric[64];
+        for (size_t stage = 0; stage < kStageCount; ++stage) {
+            bool seen = false;
+            for (size_t i = 0; i < trace.size() && !seen; ++i) {
+                seen = trace[i].stage == static_cast<Stage>(stage);
+            }
+            if (!seen) {
+                continue;
+            }
+            std::snprintf(metric, sizeof(metric), "%s;dur=%.3f, ", stage_name(static_cast<Stage>(stage)),
+                          to_ms(trace.total(static_cast<Stage>(stage))));
+            header += metric;
+        }
+        std::snprintf(metric, sizeof(metric), "total;dur=%.3f", to_ms(total));
+        return header + metric;
+    }
+
+    inline std::string json_escape(const std::string& text) {
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // The request as trace events in the Chrome trace event format: a complete ("X") event
+    // named `name` covering the whole request on `thread`, then one per span on the thread
+    // that ran it. Timestamps are steady-clock microseconds. Every event ends in ",\n", so the
+    // events of many requests appended after a "[" form the format's JSON array form, whose
+    // closing bracket trace viewers don't require.
+    inline std::string trace_events(const Trace& trace, const std::string& name, Clock::time_point start,
+                                    Clock::duration total, int status, uint32_t thread, int pid) {
+        const auto micros = [](Clock::duration duration) {
+            return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        };
+        std::string events = "{\"name\":\"" + json_escape(name) + "\"";
+        char event[256];
+        std::snprintf(event, sizeof(event),
+                      ",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%u,\"args\":{\"status\":%d}},\n",
+                      micros(start.time_since_epoch()), micros(total), pid, thread, status);
+        events += event;
+        for (size_t i = 0; i < trace.size(); ++i) {
+            const Span& span = trace[i];
+            std::snprintf(event, sizeof(event),
+                          "{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%u},\n",
+                          stage_name(span.stage), micros(span.start.time_since_epoch()), micros(span.duration), pid,
+                          span.thread);
+            events += event;
+        }
+        return events;
+    }
+
+    // Starts writing sampled requests' trace events to `path` from a background thread,
+    // appending to an existing file.
+    void start_export(const std::string& path);
+    // Writes out what is queued and stops the writer.
+    void stop_export();
+
+    // Whether to export the request that just finished: true for the share of requests set
+    // by TRACE_SAMPLE_PERCENT while export runs.
+    bool sample();
+
+    // Queues a finished request's trace events for the writer. Requests that arrive while the
+    // writer is too far behind are dropped and counted.
+    void export_request(const Trace& trace, const std::string& name, Clock::time_point start,
+                        Clock::duration total, int status);
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+// C++20 coroutine route handlers. Only built with ORDER_SERVICE_COROUTINES (the CMake option
+// of the same name), which also switches the build to C++20; the callback handlers in
+// order_routes.cpp stay the default.
+#ifdef ORDER_SERVICE_COROUTINES
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "async_response.h"
+#include "bounded_executor.h"
+#include "crow_all.h"
+#include "order_utils.h"
+
+namespace route_coro {
+// Return type of a coroutine handler. `co_return` a crow::response from any thread and it is
+// sent from the connection's I/O thread. The coroutine starts when Crow calls the route and
+// frees its own frame once it finishes, so nothing waits on it.
+class Response {
+public:
+    struct promise_type {
+        const crow::request* req = nullptr;
+        crow::response* res = nullptr;
+
+        Response get_return_object() {
+            return Response(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_value(crow::response value) {
+            complete_response(*req, *res, std::move(value));
+        }
+        void unhandled_exception() {
+            try {
+                throw;
+            } catch (const std::exception& err) {
+                spdlog::error("Unhandled error in coroutine route: {}", err.what());
+            } catch (...) {
+                spdlog::error("Unhandled error in coroutine route");
+            }
+            complete_response(*req, *res, json_error(500, "Internal server error"));
+        }
+    };
+
+    Response(Response&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Response(const Response&) = delete;
+    Response& operator=(const Response&) = delete;
+
+    ~Response() {
+        // Only a coroutine that was never started is still owned here.
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    void start(const crow::request& req, crow::response& res) && {
+        auto handle = std::exchange(handle_, {});
+        handle.promise().req = &req;
+        handle.promise().res = &res;
+        handle.resume();
+    }
+
+private:
+    explicit Response(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// `co_await resume_on(executor)` continues the coroutine on one of the executor's threads.
+// It evaluates to false, without switching, when the executor's queue is full, and the handler
+// is expected to shed the request. Bind the result to a local before testing it: GCC 12
+// miscompiles a co_await inside an `if` condition, and the first resume then traps.
+//   const bool queued = co_await route_coro::resume_on(storage_executors::sqlite());
+class ResumeOn {
+public:
+    explicit ResumeOn(BoundedExecutor& executor) : executor_(executor) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // Set before submitting: once queued, the worker may resume and finish the coroutine,
+        // destroying this awaiter, before submit() even returns.
+        queued_ = true;
+        if (executor_.submit([handle] { handle.resume(); })) {
+            return true;
+        }
+        queued_ = false;
+        return false;
+    }
+
+    bool await_resume() const noexcept {
+        return queued_;
+    }
+
+private:
+    BoundedExecutor& executor_;
+    bool queued_ = false;
+};
+
+inline ResumeOn resume_on(BoundedExecutor& executor) {
+    return ResumeOn(executor);
+}
+
+// `co_await resume_on_io(req)` continues the coroutine on the connection's I/O thread.
+class ResumeOnIo {
+public:
+    explicit ResumeOnIo(const crow::request& req) : req_(req) {}
+
+    bool await_ready() const noexcept {
+        return req_.io_context == nullptr;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        asio::post(*req_.io_context, [handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    const crow::request& req_;
+};
+
+inline ResumeOnIo resume_on_io(const crow::request& req) {
+    return ResumeOnIo(req);
+}
+
+// `co_await sleep_for(req, delay)` suspends on a timer of the connection's io_context, so the
+// I/O thread keeps serving other connections meanwhile. Without an io_context it blocks.
+class SleepFor {
+public:
+    SleepFor(const crow::request& req, std::chrono::steady_clock::duration delay) : req_(req), delay_(delay) {}
+
+    bool await_ready() const {
+        if (delay_ <= std::chrono::steady_clock::duration::zero()) {
+            return true;
+        }
+        if (req_.io_context == nullptr) {
+            std::this_thread::sleep_for(delay_);
+            return true;
+        }
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        timer_ = std::make_unique<asio::steady_timer>(*req_.io_context, delay_);
+        timer_->async_wait([handle](const crow::error_code&) { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    const crow::request& req_;
+    std::chrono::steady_clock::duration delay_;
+    std::unique_ptr<asio::steady_timer> timer_;
+};
+
+inline SleepFor sleep_for(const crow::request& req, std::chrono::steady_clock::duration delay) {
+    return SleepFor(req, delay);
+}
+
+// Adapts a coroutine handler to the (request, response&, args...) form Crow calls:
+//   CROW_ROUTE(app, "/order/get/<string>")(route_coro::route(get_order));
+// Route arguments are taken by value so they live in the coroutine frame.
+template<typename... Args>
+auto route(Response (*handler)(const crow::request&, Args...)) {
+    return [handler](const crow::request& req, crow::response& res, Args... args) {
+        handler(req, std::move(args)...).start(req, res);
+    };
+}
+}
+
+#endif
@@ -5,5 +5,20 @@
 
 namespace runtime_config {
     inline std::string api_key = "1234567";
-    inline std::atomic<int> cache_ttl_seconds{300};
+    inline std::string admin_api_key = "1234567";            // /admin/ routes
+    inline std::atomic<int> cache_ttl_seconds{300};          // PENDING orders
+    inline std::atomic<int> cache_paid_ttl_seconds{86400};   // PAID orders never change again
+    inline std::atomic<int> cache_tombstone_ttl_seconds{60}; // deleted orders
+    inline std::atomic<int> cache_ttl_jitter_percent{10};
+    inline std::atomic<bool> cache_binary_encoding{true};    // false writes JSON, e.g. mid-rollout
+    inline std::atomic<bool> cache_legacy_values{false};     // bare JSON, no version, for pre-versioning readers
+    inline std::atomic<int> request_timeout_ms{2000};        // order routes; 0 disables
+    inline std::atomic<int> list_timeout_ms{10000};          // full-table scans get longer
+    inline std::atomic<int> export_timeout_ms{300000};       // a whole /order/export stream
+    inline std::atomic<int> archive_batch_size{500};         // orders moved per archiver transaction
+    inline std::atomic<int> archive_interval_seconds{60};    // pause between archiver runs
+    inline std::atomic<bool> server_timing{false};           // Server-Timing header on responses
+    inline std::atomic<bool> alloc_tracking{false};          // per-request allocation accounts and X-Allocations
+    inline std::atomic<int> trace_sample_percent{0};         // requests exported to TRACE_FILE
+    inline std::atomic<int> flight_recorder_slow_ms{1000};   // slower requests dump the flight recorder; 0 disables
 }
@@ -1,21 +1,49 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
 
 namespace service_state {
     inline std::atomic<bool> shutting_down{false};
+    // Set with shutting_down when a hot-restart successor already accepts connections: the
+    // draining process then still serves requests on its open connections (closing each
+    // after the response) instead of rejecting them.
+    inline std::atomic<bool> handing_over{false};
     inline std::atomic<bool> db_ready{false};
     inline std::atomic<bool> redis_available{false};
     inline std::atomic<int> max_inflight_requests{64};
+    inline std::atomic<bool> warming_up{false};
+    inline std::atomic<int64_t> warmup_orders_total{0};
+    inline std::atomic<int64_t> warmup_orders_loaded{0};
+
+    // Signalled as requests finish once shutting_down is set, so the shutdown drain wakes when
+    // the last in-flight request completes instead of polling for it.
+    inline std::mutex drain_mutex;
+    inline std::condition_variable drain_cv;
+
+    inline void notify_request_finished() {
+        if (shutting_down.load()) {
+            std::lock_guard<std::mutex> lock(drain_mutex);
+            drain_cv.notify_all();
+        }
+    }
+
+    // PROFILE_ENDPOINT_PUBLIC=1 treats /debug/profile like a probe: no API key, and it isn't
+    // counted in flight or turned away while shutting down.
+    inline std::atomic<bool> profile_endpoint_public{false};
 
     inline bool is_probe_path(const std::string& path) {
-        return path == "/healthcheck" || path == "/readiness" || path == "/metrics";
+        return path == "/healthcheck" || path == "/readiness" || path == "/metrics" ||
+               (path == "/debug/profile" && profile_endpoint_public.load(std::memory_order_relaxed));
     }
 
     inline bool is_ready() {
         return db_ready.load(std::memory_order_relaxed) &&
-               !shutting_down.load(std::memory_order_relaxed);
+               !shutting_down.load(std::memory_order_relaxed) &&
+               !warming_up.load(std::memory_order_relaxed);
     }
 
     inline const char* readiness_status() {
@@ -25,6 +53,9 @@ namespace service_state {
         if (shutting_down.load(std::memory_order_relaxed)) {
             return "shutting_down";
         }
+        if (warming_up.load(std::memory_order_relaxed)) {
+            return "warming";
+        }
         if (!redis_available.load(std::memory_order_relaxed)) {
             return "degraded";
         }
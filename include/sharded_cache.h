@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "hash_ring.h"
+#include "order_cache.h"
+
+namespace order_cache {
+    // Spreads keys over several backends with a consistent-hash ring (see hash_ring.h).
+    // `nodes` and `names` are parallel; the names place each node on the ring, so keep them
+    // stable across restarts. A failing node is not routed around: its keys miss and the
+    // routes fall back to SQLite, while every other node keeps serving its share.
+    class ShardedBackend : public Backend {
+    public:
+        ShardedBackend(std::vector<Backend*> nodes, const std::vector<std::string>& names, int virtual_nodes)
+            : nodes_(std::move(nodes)), ring_(virtual_nodes) {
+            for (const auto& name : names) {
+                ring_.add_node(name);
+            }
+        }
+
+        void set(const std::string& key, const std::string& value, std::chrono::seconds ttl) override {
+            node_for(key)->set(key, value, ttl);
+        }
+
+        std::optional<std::string> get(const std::string& key) override {
+            return node_for(key)->get(key);
+        }
+
+        void del(const std::string& key) override {
+            node_for(key)->del(key);
+        }
+
+        bool set_if_newer(const std::string& key, const std::string& value, int64_t version, std::chrono::seconds ttl) override {
+            return node_for(key)->set_if_newer(key, value, version, ttl);
+        }
+
+        // Batches per node. A failing node doesn't stop the others; the first error is rethrown
+        // once every node had its turn.
+        void set_many(const std::vector<VersionedEntry>& entries) override {
+            std::vector<std::vector<VersionedEntry>> batches(nodes_.size());
+            for (const auto& entry : entries) {
+                batches[ring_.node_for(entry.key)].push_back(entry);
+            }
+            for_each_node([&](size_t i) {
+                if (!batches[i].empty()) {
+                    nodes_[i]->set_many(batches[i]);
+                }
+            });
+        }
+
+        void ping() override {
+            for_each_node([&](size_t i) { nodes_[i]->ping(); });
+        }
+
+        // Index into `nodes` of the node that owns `key`.
+        size_t node_index(const std::string& key) const {
+            return ring_.node_for(key);
+        }
+
+    private:
+        Backend* node_for(const std::string& key) const {
+            return nodes_[ring_.node_for(key)];
+        }
+
+        template<typename F>
+        void for_each_node(F&& f) {
+            std::exception_ptr first_error;
+            for (size_t i = 0; i < nodes_.size(); ++i) {
+                try {
+                    f(i);
+                } catch (const std::exception&) {
+                    if (!first_error) {
+                        first_error = std::current_exception();
+                    }
+                }
+            }
+            if (first_error) {
+                std::rethrow_exception(first_error);
+            }
+        }
+
+        std::vector<Backend*> nodes_;
+        HashRing ring_;
+    };
+
+    inline std::unique_ptr<Backend> make_sharded_backend(
+        std::vector<Backend*> nodes,
+        const std::vector<std::string>& names,
+        int virtual_nodes) {
+        return std::make_unique<ShardedBackend>(std::move(nodes), names, virtual_nodes);
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Per-statement SQLite statistics. Every SQL text the routes run is declared once as a
+// Statement with a short label. A Query prepares one, times its steps and, when it is
+// finalized, adds the execution and SQLite's own counters for it (sqlite3_stmt_status) to the
+// statement's totals. Connections registered with watch() also report their page cache hits
+// and misses and the time spent waiting on SQLITE_BUSY. /metrics exports all of it by label.
+namespace sql_stats {
+    // Upper bounds of the execution time buckets, in microseconds; a last bucket takes the rest.
+    inline constexpr std::array<int64_t, 11> kBucketBoundsUs{25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000, 250000};
+    inline constexpr size_t kBucketCount = kBucketBoundsUs.size() + 1;
+
+    inline size_t bucket_for(int64_t micros) {
+        size_t bucket = 0;
+        while (bucket < kBucketBoundsUs.size() && micros > kBucketBoundsUs[bucket]) {
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // What sqlite3_stmt_status reports for one execution.
+    struct Counters {
+        int64_t fullscan_steps = 0;
+        int64_t sorts = 0;
+        int64_t autoindexes = 0;
+        int64_t vm_steps = 0;
+    };
+
+    class Statement;
+
+    namespace detail {
+        // Filled while static constructors run, read-only once main() starts.
+        inline std::vector<Statement*>& registry() {
+            static std::vector<Statement*> statements;
+            return statements;
+        }
+    }
+
+    class Statement {
+    public:
+        // Declare statements at namespace scope, so all of them are registered, and exported
+        // with zeroes, before the first request.
+        Statement(const char* label, const char* sql) : label_(label), sql_(sql) {
+            detail::registry().push_back(this);
+        }
+
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+
+        const char* label() const {
+            return label_;
+        }
+
+        const char* sql() const {
+            return sql_;
+        }
+
+        // One execution that spent `micros` in sqlite3_step.
+        void record(int64_t micros, bool failed, const Counters& counters) {
+            executions.fetch_add(1, std::memory_order_relaxed);
+            if (failed) {
+                errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            duration_us_total.fetch_add(micros, std::memory_order_relaxed);
+            buckets[bucket_for(micros)].fetch_add(1, std::memory_order_relaxed);
+            fullscan_steps.fetch_add(counters.fullscan_steps, std::memory_order_relaxed);
+            sorts.fetch_add(counters.sorts, std::memory_order_relaxed);
+            autoindexes.fetch_add(counters.autoindexes, std::memory_order_relaxed);
+            vm_steps.fetch_add(counters.vm_steps, std::memory_order_relaxed);
+        }
+
+        std::atomic<int64_t> executions{0};
+        // Executions where a step failed or prepare did; deadline aborts included.
+        std::atomic<int64_t> errors{0};
+        std::atomic<int64_t> duration_us_total{0};
+        std::array<std::atomic<int64_t>, kBucketCount> buckets{};
+        std::atomic<int64_t> fullscan_steps{0};
+        std::atomic<int64_t> sorts{0};
+        std::atomic<int64_t> autoindexes{0};
+        std::atomic<int64_t> vm_steps{0};
+
+    private:
+        const char* label_;
+        const char* sql_;
+    };
+
+    inline const std::vector<Statement*>& statements() {
+        return detail::registry();
+    }
+
+    // A prepared Statement, finalized when the Query goes out of scope. step() is
+    // sqlite3_step, timed; finalizing records the execution if it stepped at all.
+    class Query {
+    public:
+        // Prepares `statement` on `db`. On failure ok() is false, sqlite3_errmsg(db) says why
+        // and the statement counts an error.
+        Query(sqlite3* db, Statement& statement);
+        ~Query();
+
+        Query(Query&& other) noexcept;
+        Query(const Query&) = delete;
+        Query& operator=(const Query&) = delete;
+        Query& operator=(Query&&) = delete;
+
+        bool ok() const {
+            return stmt_ != nullptr;
+        }
+
+        sqlite3_stmt* get() const {
+            return stmt_;
+        }
+
+        int step();
+
+        // Records the execution and finalizes the statement now.
+        void finalize();
+
+    private:
+        Statement* statement_;
+        sqlite3_stmt* stmt_ = nullptr;
+        int64_t step_ns_ = 0;
+        bool stepped_ = false;
+        bool failed_ = false;
+    };
+
+    // How long to sleep before retry `count` (0-based) of a lock, so that the retries give up
+    // after `timeout_ms` in total; 0 means give up now. The same schedule as SQLite's own
+    // sqlite3_busy_timeout: short sleeps first, then 100 ms at a time.
+    inline int busy_delay_ms(int count, int timeout_ms) {
+        static constexpr int delays[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};
+        static constexpr int totals[] = {0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228};
+        constexpr int last = static_cast<int>(sizeof(delays) / sizeof(delays[0])) - 1;
+        int delay = delays[count < last ? count : last];
+        const int prior = count <= last ? totals[count] : totals[last] + delays[last] * (count - last);
+        if (prior + delay > timeout_ms) {
+            delay = timeout_ms - prior;
+        }
+        return delay > 0 ? delay : 0;
+    }
+
+    // Registers `db` as `name` and makes it wait up to `busy_timeout_ms` for a lock, like
+    // sqlite3_busy_timeout, counting the waits.
+    void watch(sqlite3* db, const std::string& name, int busy_timeout_ms);
+    // Changes how long watched `db` waits for a lock from now on. Call it from the thread that
+    // uses the connection.
+    void set_busy_timeout(sqlite3* db, int busy_timeout_ms);
+    // Call before closing a watched connection.
+    void unwatch(sqlite3* db);
+
+    struct ConnectionStats {
+        std::string name;
+        int64_t cache_hits = 0;
+        int64_t cache_misses = 0;
+        int64_t cache_writes = 0;
+        int64_t cache_used_bytes = 0;
+        int64_t busy_waits = 0;
+        int64_t busy_wait_us_total = 0;
+        int64_t busy_timeouts = 0;
+    };
+
+    // The connections still open.
+    std::vector<ConnectionStats> connections();
+}
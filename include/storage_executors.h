@@ -0,0 +1,28 @@
+#pragma once
+
+#include "bounded_executor.h"
+
+// Bulkheads for blocking storage work. Route handlers hand SQLite and Redis calls to these
+// pools so Crow's I/O threads never block on them, and each dependency has its own threads
+// and queue: a Redis slowdown fills the Redis queue and leaves SQLite work untouched.
+namespace storage_executors {
+    struct Options {
+        int sqlite_threads = 2;
+        int sqlite_queue = 1024;
+        int redis_threads = 2;
+        int redis_queue = 1024;
+    };
+
+    void start(const Options& options);
+    // Resizes the running pools; false, with both pools left as they were, before start() or
+    // after stop().
+    bool resize(const Options& options);
+    // The sizes start() or the last resize() set.
+    Options options();
+    // Runs what's already queued, then joins. Call after the server stopped accepting.
+    void stop();
+
+    // Before start() these run tasks inline on the caller; after stop() they refuse them.
+    BoundedExecutor& sqlite();
+    BoundedExecutor& redis();
+}
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "alloc_stats.h"
+
+#if defined(__GLIBC__) || defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+namespace {
+constexpr size_t kSlots = 256;
+
+struct alignas(64) Slot {
+    atomic<uint64_t> allocations{0};
+    atomic<uint64_t> frees{0};
+    atomic<uint64_t> allocated_bytes{0};
+    atomic<uint64_t> freed_bytes{0};
+};
+
+// Constant-initialized, so allocations made by other static constructors are counted too.
+// Each thread takes a slot of its own. When it exits the slot goes on a free list, counts
+// and all, for the next new thread, so the totals keep what exited threads counted and
+// only threads beyond kSlots alive at once share one slot and pay for atomic adds.
+Slot slots[kSlots];
+atomic<size_t> slots_taken{0};
+Slot shared_slot;
+thread_local Slot* thread_slot = nullptr;
+thread_local alloc_stats::Account* thread_account = nullptr;
+
+// Fixed-size, since it is used from inside operator new. The mutex also orders the exited
+// thread's last plain stores before the next owner's.
+mutex free_slots_mutex;
+size_t free_slots[kSlots];
+size_t free_slot_count = 0;
+
+mutex routes_mutex;
+map<string, alloc_stats::RouteStats> route_stats;
+
+size_t take_slot() {
+    {
+        lock_guard<mutex> lock(free_slots_mutex);
+        if (free_slot_count > 0) {
+            return free_slots[--free_slot_count];
+        }
+    }
+    return slots_taken.fetch_add(1, memory_order_relaxed);
+}
+
+// Gives the thread's slot back when the thread exits. Allocations made by thread_local
+// destructors that run after this one are counted in the shared slot.
+struct SlotOwner {
+    size_t index = kSlots;
+
+    ~SlotOwner() {
+        thread_slot = &shared_slot;
+        if (index < kSlots) {
+            lock_guard<mutex> lock(free_slots_mutex);
+            free_slots[free_slot_count++] = index;
+        }
+    }
+};
+
+Slot& slot() {
+    if (thread_slot == nullptr) {
+        thread_local SlotOwner owner;
+        owner.index = take_slot();
+        thread_slot = owner.index < kSlots ? &slots[owner.index] : &shared_slot;
+    }
+    return *thread_slot;
+}
+
+// Only the owning thread writes its slot, so a plain load and store (no locked instruction)
+// is enough; the shared slot needs the real read-modify-write.
+void add(Slot& counters, atomic<uint64_t> Slot::*counter, uint64_t value) {
+    atomic<uint64_t>& total = counters.*counter;
+    if (&counters == &shared_slot) {
+        total.fetch_add(value, memory_order_relaxed);
+    } else {
+        total.store(total.load(memory_order_relaxed) + value, memory_order_relaxed);
+    }
+}
+
+size_t block_size(void* p, size_t requested, size_t alignment) {
+#if defined(__GLIBC__)
+    (void)requested;
+    (void)alignment;
+    return malloc_usable_size(p);
+#elif defined(_MSC_VER)
+    (void)requested;
+    return alignment == 0 ? _msize(p) : _aligned_msize(p, alignment, 0);
+#else
+    (void)p;
+    (void)alignment;
+    return requested;
+#endif
+}
+
+void counted_allocation(void* p, size_t size, size_t alignment) {
+    Slot& counters = slot();
+    add(counters, &Slot::allocations, 1);
+    const size_t bytes = block_size(p, size, alignment);
+    add(counters, &Slot::allocated_bytes, bytes);
+    if (alloc_stats::Account* account = thread_account) {
+        account->allocations.fetch_add(1, memory_order_relaxed);
+        account->bytes.fetch_add(bytes, memory_order_relaxed);
+    }
+}
+
+void counted_free(void* p, size_t alignment) {
+    Slot& counters = slot();
+    add(counters, &Slot::frees, 1);
+    add(counters, &Slot::freed_bytes, block_size(p, 0, alignment));
+}
+
+// operator new's contract: retry through the new handler until it gives up, then fail.
+void* allocate(size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        if (void* p = malloc(size)) {
+            counted_allocation(p, size, 0);
+            return p;
+        }
+        new_handler handler = get_new_handler();
+        if (handler == nullptr) {
+            return nullptr;
+        }
+        handler();
+    }
+}
+
+void* allocate_aligned(size_t size, align_val_t align) {
+    const size_t alignment = static_cast<size_t>(align);
+    // aligned_alloc wants a multiple of the alignment.
+    size = size == 0 ? alignment : (size + alignment - 1) / alignment * alignment;
+    while (true) {
+#ifdef _MSC_VER
+        void* p = _aligned_malloc(size, alignment);
+#else
+        void* p = aligned_alloc(alignment, size);
+#endif
+        if (p != nullptr) {
+            counted_allocation(p, size, alignment);
+            return p;
+        }
+        new_handler handler = get_new_handler();
+        if (handler == nullptr) {
+            return nullptr;
+        }
+        handler();
+    }
+}
+
+void release(void* p) {
+    if (p == nullptr) {
+        return;
+    }
+    counted_free(p, 0);
+    free(p);
+}
+
+void release_aligned(void* p, align_val_t align) {
+    if (p == nullptr) {
+        return;
+    }
+    counted_free(p, static_cast<size_t>(align));
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+}
+
+namespace alloc_stats {
+Totals totals() {
+    Totals totals;
+    const size_t taken = min(slots_taken.load(memory_order_relaxed), kSlots);
+    auto sum = [&totals](const Slot& counters) {
+        totals.allocations += counters.allocations.load(memory_order_relaxed);
+        totals.frees += counters.frees.load(memory_order_relaxed);
+        totals.allocated_bytes += counters.allocated_bytes.load(memory_order_relaxed);
+        totals.freed_bytes += counters.freed_bytes.load(memory_order_relaxed);
+    };
+    for (size_t i = 0; i < taken; ++i) {
+        sum(slots[i]);
+    }
+    sum(shared_slot);
+    return totals;
+}
+
+Account* current() {
+    return thread_account;
+}
+
+Account* exchange(Account* account) {
+    Account* previous = thread_account;
+    thread_account = account;
+    return previous;
+}
+
+void record(const string& route, const Account& account) {
+    const uint64_t allocations = account.allocations.load(memory_order_relaxed);
+    const uint64_t bytes = account.bytes.load(memory_order_relaxed);
+    lock_guard<mutex> lock(routes_mutex);
+    RouteStats& stats = route_stats[route];
+    if (stats.route.empty()) {
+        stats.route = route;
+    }
+    stats.requests += 1;
+    stats.allocations += allocations;
+    stats.bytes += bytes;
+    stats.max_allocations = max(stats.max_allocations, allocations);
+}
+
+vector<RouteStats> routes() {
+    lock_guard<mutex> lock(routes_mutex);
+    vector<RouteStats> result;
+    result.reserve(route_stats.size());
+    for (const auto& entry : route_stats) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+}
+
+void* operator new(size_t size) {
+    if (void* p = allocate(size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size, align_val_t align) {
+    if (void* p = allocate_aligned(size, align)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size, align_val_t align) {
+    return operator new(size, align);
+}
+
+void* operator new(size_t size, align_val_t align, const nothrow_t&) noexcept {
+    try {
+        return allocate_aligned(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, align_val_t align, const nothrow_t& tag) noexcept {
+    return operator new(size, align, tag);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, align_val_t align) noexcept {
+    release_aligned(p, align);
+}
+
+void operator delete[](void* p, align_val_t align) noexcept {
+    release_aligned(p, align);
+}
+
+void operator delete(void* p, size_t, align_val_t align) noexcept {
+    release_aligned(p, align);
+}
+
+void operator delete[](void* p, size_t, align_val_t align) noexcept {
+    release_aligned(p, align);
+}
+
+void operator delete(void* p, align_val_t align, const nothrow_t&) noexcept {
+    release_aligned(p, align);
+}
+
+void operator delete[](void* p, align_val_t align, const nothrow_t&) noexcept {
+    release_aligned(p, align);
+}
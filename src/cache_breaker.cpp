@@ -0,0 +1,173 @@
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "cache_breaker.h"
+#include "metrics.h"
+#include "order_cache.h"
+#include "service_state.h"
+
+using namespace std;
+using namespace metrics;
+using namespace service_state;
+
+namespace {
+bool any_breaker_open() {
+    for (const auto& node : cache_nodes) {
+        if (node.breaker_state.load(memory_order_relaxed) == static_cast<int>(CircuitBreaker::State::Open)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class GuardedBackend : public order_cache::Backend {
+public:
+    GuardedBackend(order_cache::Backend* inner, CacheNodeStats& stats, const CircuitBreaker::Options& options)
+        : inner_(inner), stats_(stats), breaker_(options, [this](CircuitBreaker::State from, CircuitBreaker::State to) {
+              on_transition(from, to);
+          }) {}
+
+    void set(const string& key, const string& value, chrono::seconds ttl) override {
+        call([&] { inner_->set(key, value, ttl); });
+    }
+
+    optional<string> get(const string& key) override {
+        optional<string> value;
+        call([&] { value = inner_->get(key); });
+        (value ? stats_.hits : stats_.misses).fetch_add(1, memory_order_relaxed);
+        return value;
+    }
+
+    void del(const string& key) override {
+        call([&] { inner_->del(key); });
+    }
+
+    bool set_if_newer(const string& key, const string& value, int64_t version, chrono::seconds ttl) override {
+        bool stored = false;
+        call([&] { stored = inner_->set_if_newer(key, value, version, ttl); });
+        return stored;
+    }
+
+    void set_many(const vector<order_cache::VersionedEntry>& entries) override {
+        call([&] { inner_->set_many(entries); });
+    }
+
+    // A failed ping is a failed health check, so it opens the breaker outright.
+    void ping() override {
+        try {
+            inner_->ping();
+        } catch (const exception&) {
+            stats_.errors.fetch_add(1, memory_order_relaxed);
+            breaker_.trip();
+            throw;
+        }
+    }
+
+    // Probes the real backend; used by the reconnect thread while the breaker is open.
+    void probe() {
+        redis_probes.fetch_add(1, memory_order_relaxed);
+        try {
+            inner_->ping();
+            breaker_.probe_succeeded();
+        } catch (const exception& err) {
+            redis_probe_failures.fetch_add(1, memory_order_relaxed);
+            spdlog::debug("Redis probe of {} failed: {}", stats_.name, err.what());
+        }
+    }
+
+    CircuitBreaker& breaker() {
+        return breaker_;
+    }
+
+private:
+    template<typename F>
+    void call(F&& f) {
+        if (!breaker_.allow()) {
+            redis_short_circuits.fetch_add(1, memory_order_relaxed);
+            stats_.short_circuits.fetch_add(1, memory_order_relaxed);
+            throw order_cache::Unavailable("Redis circuit breaker is open for " + stats_.name);
+        }
+        const auto start = chrono::steady_clock::now();
+        try {
+            f();
+        } catch (const exception&) {
+            stats_.errors.fetch_add(1, memory_order_relaxed);
+            breaker_.record(false, elapsed_since(start));
+            throw;
+        }
+        breaker_.record(true, elapsed_since(start));
+    }
+
+    void on_transition(CircuitBreaker::State from, CircuitBreaker::State to) {
+        stats_.breaker_state.store(static_cast<int>(to), memory_order_relaxed);
+        redis_breaker_transitions.fetch_add(1, memory_order_relaxed);
+        // Degraded while any node's key range is being served from SQLite only.
+        redis_available.store(!any_breaker_open(), memory_order_relaxed);
+        spdlog::warn(
+            "Redis circuit breaker for {}: {} -> {}",
+            stats_.name,
+            CircuitBreaker::state_name(from),
+            CircuitBreaker::state_name(to));
+    }
+
+    static chrono::milliseconds elapsed_since(chrono::steady_clock::time_point start) {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    }
+
+    order_cache::Backend* inner_;
+    CacheNodeStats& stats_;
+    CircuitBreaker breaker_;
+};
+
+vector<unique_ptr<GuardedBackend>> guarded;
+mutex prober_mutex;
+condition_variable prober_cv;
+bool prober_stopping = false;
+thread prober_thread;
+
+void prober_loop(chrono::milliseconds interval) {
+    unique_lock<mutex> lock(prober_mutex);
+    while (!prober_cv.wait_for(lock, interval, [] { return prober_stopping; })) {
+        for (auto& backend : guarded) {
+            if (backend->breaker().state() == CircuitBreaker::State::Open) {
+                lock.unlock();
+                backend->probe();
+                lock.lock();
+            }
+        }
+    }
+}
+}
+
+namespace cache_breaker {
+order_cache::Backend* start(order_cache::Backend* inner, CacheNodeStats& stats, const Options& options) {
+    lock_guard<mutex> lock(prober_mutex);
+    guarded.push_back(make_unique<GuardedBackend>(inner, stats, options.breaker));
+    if (!prober_thread.joinable()) {
+        prober_stopping = false;
+        prober_thread = thread(prober_loop, chrono::milliseconds(options.probe_interval_ms));
+    }
+    return guarded.back().get();
+}
+
+void stop() {
+    {
+        lock_guard<mutex> lock(prober_mutex);
+        prober_stopping = true;
+    }
+    prober_cv.notify_all();
+    if (prober_thread.joinable()) {
+        prober_thread.join();
+    }
+}
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "cache_policy.h"
+#include "order_cache.h"
+#include "order_codec.h"
+#include "runtime_config.h"
+
+using namespace std;
+
+namespace cache_policy {
+Policy for_status(const string& status) {
+    return status == "PAID" ? Policy::Paid : Policy::Pending;
+}
+
+const char* name(Policy policy) {
+    switch (policy) {
+        case Policy::Pending: return "pending";
+        case Policy::Paid: return "paid";
+        case Policy::Tombstone: return "tombstone";
+    }
+    return "unknown";
+}
+
+int64_t version(Policy policy) {
+    return static_cast<int64_t>(policy) + 1;
+}
+
+chrono::seconds ttl(Policy policy) {
+    int base = 0;
+    switch (policy) {
+        case Policy::Pending: base = runtime_config::cache_ttl_seconds.load(memory_order_relaxed); break;
+        case Policy::Paid: base = runtime_config::cache_paid_ttl_seconds.load(memory_order_relaxed); break;
+        case Policy::Tombstone: base = runtime_config::cache_tombstone_ttl_seconds.load(memory_order_relaxed); break;
+    }
+    const int spread = base * clamp(runtime_config::cache_ttl_jitter_percent.load(memory_order_relaxed), 0, 100) / 100;
+    if (spread == 0) {
+        return chrono::seconds(max(1, base));
+    }
+    thread_local minstd_rand rng(random_device{}());
+    return chrono::seconds(max(1, base + uniform_int_distribution<int>(-spread, spread)(rng)));
+}
+
+string encode(Policy policy, const string& payload) {
+    if (runtime_config::cache_legacy_values.load(memory_order_relaxed)) {
+        return payload;
+    }
+    string value = to_string(version(policy));
+    value += ':';
+    value += payload;
+    return value;
+}
+
+optional<Decoded> decode(const string& value) {
+    const int64_t v = order_cache::value_version(value);
+    if (v == -1 && order_codec::is_json(value)) {
+        // The body order_json() renders, so the status appears exactly like this.
+        return Decoded{value.find("\"status\":\"PAID\"") != string::npos ? Policy::Paid : Policy::Pending, value};
+    }
+    if (v < 1 || v > kPolicyCount) {
+        return nullopt;
+    }
+    return Decoded{static_cast<Policy>(v - 1), value.substr(value.find(':') + 1)};
+}
+}
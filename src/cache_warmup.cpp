@@ -0,0 +1,154 @@
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+#include <spdlog/spdlog.h>
+
+#include "cache_policy.h"
+#include "cache_warmup.h"
+#include "metrics.h"
+#include "order_cache.h"
+#include "order_utils.h"
+#include "service_state.h"
+
+using namespace std;
+using namespace metrics;
+using namespace service_state;
+
+namespace {
+atomic<bool> warmup_stopping{false};
+thread warmup_thread;
+
+int64_t query_int64(sqlite3* db, const char* sql, int64_t first = 0, int64_t second = 0) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite_errors.fetch_add(1, memory_order_relaxed);
+        spdlog::error("Warmup prepare failed: {}", sqlite3_errmsg(db));
+        return 0;
+    }
+    const int64_t binds[] = {first, second};
+    for (int i = 0; i < sqlite3_bind_parameter_count(stmt) && i < 2; ++i) {
+        sqlite3_bind_int64(stmt, i + 1, binds[i]);
+    }
+    const int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// Walks the indexes the request path uses so their pages are in this connection's page
+// cache (and the OS cache) before the first lookup. Only as much as fits in cache_size stays.
+// The primary key is primed through the orders created since the cutoff, the ones warmup
+// loads, rather than scanned end to end.
+void prime_index_pages(sqlite3* db, int64_t cutoff) {
+    query_int64(db, "SELECT COUNT(*) FROM orders INDEXED BY idx_orders_created_at WHERE created_at >= ?;", cutoff);
+    query_int64(db,
+                "SELECT COUNT(*) FROM orders WHERE order_no IN "
+                "(SELECT order_no FROM orders INDEXED BY idx_orders_created_at WHERE created_at >= ?);",
+                cutoff);
+    query_int64(db, "SELECT COUNT(*) FROM orders INDEXED BY idx_orders_status_paid_at WHERE status = 'PENDING';");
+}
+
+void load_orders(sqlite3* db, order_cache::Backend* cache, const cache_warmup::Options& options, int64_t cutoff) {
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(options.timeout_seconds);
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "SELECT order_no, amount, status, created_at, paid_at FROM orders "
+        "WHERE status = 'PENDING' OR created_at >= ? ORDER BY created_at DESC LIMIT ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite_errors.fetch_add(1, memory_order_relaxed);
+        spdlog::error("Warmup prepare failed: {}", sqlite3_errmsg(db));
+        return;
+    }
+    sqlite3_bind_int64(stmt, 1, cutoff);
+    sqlite3_bind_int(stmt, 2, options.max_orders);
+
+    vector<order_cache::VersionedEntry> batch;
+    batch.reserve(options.batch_size);
+    bool more = true;
+    while (more && !warmup_stopping.load(memory_order_relaxed)) {
+        if (chrono::steady_clock::now() > deadline) {
+            spdlog::warn("Cache warmup timed out after {}s", options.timeout_seconds);
+            break;
+        }
+        batch.clear();
+        while (static_cast<int>(batch.size()) < options.batch_size) {
+            if (sqlite3_step(stmt) != SQLITE_ROW) {
+                more = false;
+                break;
+            }
+            const string order_no = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            const string status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            const string payload = order_cache_payload(
+                order_no, sqlite3_column_double(stmt, 1), status, sqlite3_column_int64(stmt, 3), sqlite3_column_int64(stmt, 4));
+            // Versioned like any other write, so a row read before a concurrent pay or delete
+            // can't overwrite what that request cached.
+            const auto policy = cache_policy::for_status(status);
+            batch.push_back({order_cache::order_key(order_no),
+                             cache_policy::encode(policy, payload),
+                             cache_policy::version(policy),
+                             cache_policy::ttl(policy)});
+        }
+        if (batch.empty()) {
+            break;
+        }
+        // With several nodes a failure usually covers only one node's share of the batch, so
+        // keep going; once a node's breaker opens its writes are refused without a round trip.
+        try {
+            cache->set_many(batch);
+        } catch (const exception& err) {
+            redis_errors.fetch_add(1, memory_order_relaxed);
+            spdlog::warn("Cache warmup write failed: {}", err.what());
+            continue;
+        }
+        warmup_orders_loaded.fetch_add(static_cast<int64_t>(batch.size()), memory_order_relaxed);
+    }
+    sqlite3_finalize(stmt);
+}
+
+void run_warmup(sqlite3* db, order_cache::Backend* cache, cache_warmup::Options options) {
+    const auto start = chrono::steady_clock::now();
+    const int64_t cutoff = static_cast<int64_t>(time(nullptr)) - options.max_age_seconds;
+
+    prime_index_pages(db, cutoff);
+    if (cache != nullptr) {
+        warmup_orders_total.store(
+            query_int64(db,
+                        "SELECT COUNT(*) FROM (SELECT 1 FROM orders WHERE status = 'PENDING' OR created_at >= ? LIMIT ?);",
+                        cutoff,
+                        options.max_orders),
+            memory_order_relaxed);
+        load_orders(db, cache, options, cutoff);
+    }
+
+    const auto elapsed_ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    spdlog::info(
+        "Cache warmup finished: {}/{} orders loaded in {} ms",
+        warmup_orders_loaded.load(memory_order_relaxed),
+        warmup_orders_total.load(memory_order_relaxed),
+        elapsed_ms);
+    warming_up.store(false, memory_order_relaxed);
+}
+}
+
+namespace cache_warmup {
+void start(sqlite3* db, order_cache::Backend* cache, const Options& options) {
+    warmup_stopping.store(false, memory_order_relaxed);
+    warmup_orders_total.store(0, memory_order_relaxed);
+    warmup_orders_loaded.store(0, memory_order_relaxed);
+    warming_up.store(true, memory_order_relaxed);
+    warmup_thread = thread(run_warmup, db, cache, options);
+}
+
+void stop() {
+    warmup_stopping.store(true, memory_order_relaxed);
+    if (warmup_thread.joinable()) {
+        warmup_thread.join();
+    }
+}
+}
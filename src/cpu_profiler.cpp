@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "cpu_profiler.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+// Older glibc headers leave this to the kernel's.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+namespace {
+constexpr int kMaxFrames = 64;
+// The signal handler and the kernel's signal trampoline sit on top of every sampled stack.
+constexpr int kSkipFrames = 2;
+constexpr size_t kMaxSamples = 1 << 15;
+
+struct Sample {
+    atomic<bool> ready{false};
+    int depth = 0;
+    void* frames[kMaxFrames];
+};
+
+// Touched by the signal handler, so only atomics and the buffer they guard. A handler
+// announces itself in handlers_running before it reads `sampling`; stop() clears `sampling`
+// and then waits for handlers_running to drop to zero before reading the buffer.
+atomic<bool> sampling{false};
+atomic<int> handlers_running{0};
+atomic<size_t> next_sample{0};
+atomic<int64_t> dropped_samples{0};
+Sample* samples = nullptr;
+size_t sample_capacity = 0;
+
+// Owned by whoever holds `busy`.
+atomic<bool> busy{false};
+unique_ptr<Sample[]> sample_buffer;
+vector<timer_t> timers;
+
+void on_sigprof(int, siginfo_t*, void*) {
+    handlers_running.fetch_add(1);
+    const int saved_errno = errno;
+    if (sampling.load()) {
+        const size_t slot = next_sample.fetch_add(1, memory_order_relaxed);
+        if (slot < sample_capacity) {
+            samples[slot].depth = backtrace(samples[slot].frames, kMaxFrames);
+            samples[slot].ready.store(true, memory_order_release);
+        } else {
+            dropped_samples.fetch_add(1, memory_order_relaxed);
+        }
+    }
+    errno = saved_errno;
+    handlers_running.fetch_sub(1);
+}
+
+// The handler stays installed once set: a SIGPROF still pending after a profile would
+// otherwise hit the default action and terminate the process.
+bool install_handler() {
+    static const bool installed = [] {
+        // backtrace() loads libgcc's unwinder on its first call; do that here rather than
+        // inside a signal handler.
+        void* warmup[1];
+        backtrace(warmup, 1);
+
+        struct sigaction action {};
+        action.sa_sigaction = on_sigprof;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        return sigaction(SIGPROF, &action, nullptr) == 0;
+    }();
+    return installed;
+}
+
+vector<pid_t> thread_ids() {
+    vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (dir == nullptr) {
+        return tids;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        const long tid = strtol(entry->d_name, nullptr, 10);
+        if (tid > 0) {
+            tids.push_back(static_cast<pid_t>(tid));
+        }
+    }
+    closedir(dir);
+    return tids;
+}
+
+// The CPU-time clock of any thread in this process, as the kernel encodes it
+// (MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED)); pthread_getcpuclockid() only takes pthread_ts.
+clockid_t thread_cpu_clock(pid_t tid) {
+    return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6);
+}
+
+void delete_timers() {
+    for (timer_t timer : timers) {
+        timer_delete(timer);
+    }
+    timers.clear();
+}
+
+string symbolize(void* address) {
+    Dl_info info{};
+    if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        string name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+        free(demangled);
+        return name;
+    }
+    char buffer[64];
+    if (info.dli_fname != nullptr) {
+        // Not an exported symbol, e.g. a static function in a binary linked without -rdynamic.
+        string module = info.dli_fname;
+        module = module.substr(module.find_last_of('/') + 1);
+        snprintf(buffer, sizeof(buffer), "+0x%zx",
+                 static_cast<size_t>(static_cast<char*>(address) - static_cast<char*>(info.dli_fbase)));
+        return module + buffer;
+    }
+    snprintf(buffer, sizeof(buffer), "%p", address);
+    return buffer;
+}
+}
+
+namespace cpu_profiler {
+StartResult start(const Options& options) {
+    if (busy.exchange(true)) {
+        return StartResult::Busy;
+    }
+    if (!install_handler()) {
+        busy.store(false);
+        return StartResult::Failed;
+    }
+
+    const vector<pid_t> tids = thread_ids();
+    sample_capacity = min(kMaxSamples,
+                          static_cast<size_t>(options.seconds) * static_cast<size_t>(options.hz) * max<size_t>(1, tids.size()));
+    sample_buffer = make_unique<Sample[]>(sample_capacity);
+    samples = sample_buffer.get();
+    next_sample.store(0);
+    dropped_samples.store(0);
+    sampling.store(true);
+
+    const long period_ns = 1000000000L / max(1, options.hz);
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period_ns / 1000000000L;
+    spec.it_interval.tv_nsec = period_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    for (const pid_t tid : tids) {
+        sigevent event{};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_notify_thread_id = tid;
+        timer_t timer;
+        // A thread that exited since the listing just has no timer.
+        if (timer_create(thread_cpu_clock(tid), &event, &timer) != 0) {
+            continue;
+        }
+        timers.push_back(timer);
+        timer_settime(timer, 0, &spec, nullptr);
+    }
+    if (timers.empty()) {
+        sampling.store(false);
+        sample_buffer.reset();
+        busy.store(false);
+        return StartResult::Failed;
+    }
+    spdlog::info("CPU profile started: {} threads at {} Hz for {} s", timers.size(), options.hz, options.seconds);
+    return StartResult::Started;
+}
+
+Profile stop() {
+    Profile profile;
+    if (!busy.load()) {
+        return profile;
+    }
+    sampling.store(false);
+    profile.threads = static_cast<int>(timers.size());
+    delete_timers();
+    while (handlers_running.load() > 0) {
+    }
+
+    const size_t taken = min(next_sample.load(), sample_capacity);
+    unordered_map<void*, string> names;
+    vector<vector<string>> stacks;
+    stacks.reserve(taken);
+    for (size_t i = 0; i < taken; ++i) {
+        const Sample& sample = samples[i];
+        if (!sample.ready.load(memory_order_acquire) || sample.depth <= kSkipFrames) {
+            continue;
+        }
+        vector<string> stack;
+        for (int frame = sample.depth - 1; frame >= kSkipFrames; --frame) {
+            // Return addresses point past the call; step back into it so the call site's
+            // function is named. The first kept frame is the interrupted instruction itself.
+            void* address = sample.frames[frame];
+            if (frame > kSkipFrames) {
+                address = static_cast<char*>(address) - 1;
+            }
+            auto it = names.find(address);
+            if (it == names.end()) {
+                it = names.emplace(address, symbolize(address)).first;
+            }
+            stack.push_back(it->second);
+        }
+        stacks.push_back(move(stack));
+    }
+    profile.samples = static_cast<int64_t>(stacks.size());
+    profile.dropped = dropped_samples.load();
+    profile.folded = fold(stacks);
+
+    samples = nullptr;
+    sample_capacity = 0;
+    sample_buffer.reset();
+    spdlog::info("CPU profile finished: {} samples, {} dropped", profile.samples, profile.dropped);
+    busy.store(false);
+    return profile;
+}
+}
+#else
+namespace cpu_profiler {
+StartResult start(const Options&) {
+    return StartResult::Unsupported;
+}
+
+Profile stop() {
+    return Profile{};
+}
+}
+#endif
@@ -0,0 +1,196 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "runtime_config.h"
+
+using namespace std;
+
+namespace {
+// Threads beyond this many record nothing; rings outlive their threads so a dump still shows
+// what a retired executor thread did last.
+constexpr size_t kMaxRings = 256;
+constexpr int64_t kSlowDumpIntervalMs = 30000;
+
+mutex rings_mutex;
+vector<unique_ptr<flight_recorder::detail::Ring>> rings;
+size_t ring_capacity = 4096;
+string directory;
+
+// Calibrates ticks against the steady clock: ticks per microsecond over the recorder's lifetime.
+uint64_t start_ticks = 0;
+chrono::steady_clock::time_point start_time;
+
+mutex dump_mutex;
+mutex pending_mutex;
+condition_variable dump_wanted;
+deque<string> pending;
+bool stopping = false;
+thread dumper;
+atomic<int64_t> last_slow_dump_ms{0};
+
+int64_t now_ms() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t round_up_to_power_of_two(size_t value) {
+    size_t capacity = 1;
+    while (capacity < value) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// The ring's recent events, oldest first. Events the writer overwrote while they were being
+// copied are left out.
+vector<flight_recorder::Event> snapshot(const flight_recorder::detail::Ring& ring) {
+    const size_t capacity = ring.mask + 1;
+    const uint64_t end = ring.head.load(memory_order_acquire);
+    const uint64_t begin = end > capacity ? end - capacity : 0;
+    vector<flight_recorder::Event> events;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t i = begin; i < end; ++i) {
+        events.push_back(ring.events[i & ring.mask]);
+    }
+    const uint64_t now = ring.head.load(memory_order_acquire);
+    const uint64_t lapped = now > capacity ? now - capacity : 0;
+    if (lapped > begin) {
+        events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(min(lapped - begin, end - begin)));
+    }
+    return events;
+}
+
+void dump_loop() {
+    unique_lock<mutex> lock(pending_mutex);
+    while (true) {
+        dump_wanted.wait(lock, [] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            return;
+        }
+        const string reason = move(pending.front());
+        pending.clear();
+        lock.unlock();
+        flight_recorder::dump(reason);
+        lock.lock();
+    }
+}
+}
+
+namespace flight_recorder {
+namespace detail {
+Ring* attach() {
+    lock_guard<mutex> lock(rings_mutex);
+    if (ring != nullptr || rings.size() >= kMaxRings) {
+        return ring;
+    }
+    rings.push_back(make_unique<Ring>(ring_capacity, request_trace::thread_number()));
+    ring = rings.back().get();
+    return ring;
+}
+}
+
+void start(const Options& options) {
+    {
+        lock_guard<mutex> lock(rings_mutex);
+        ring_capacity = round_up_to_power_of_two(max<size_t>(16, options.events_per_thread));
+        directory = options.directory;
+        start_ticks = ticks();
+        start_time = chrono::steady_clock::now();
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        stopping = false;
+    }
+    dumper = thread(dump_loop);
+    detail::enabled.store(true);
+    spdlog::info("Flight recorder on: {} events per thread, dumps to {}", ring_capacity, options.directory);
+}
+
+void stop() {
+    if (!detail::enabled.exchange(false)) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        stopping = true;
+    }
+    dump_wanted.notify_one();
+    dumper.join();
+}
+
+DumpResult dump(const string& reason) {
+    lock_guard<mutex> dump_lock(dump_mutex);
+    DumpResult result;
+    Dump dump;
+    dump.reason = reason;
+    dump.unix_ms = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    dump.ticks = ticks();
+    {
+        lock_guard<mutex> lock(rings_mutex);
+        const auto elapsed_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_time).count();
+        if (elapsed_us > 0 && dump.ticks > start_ticks) {
+            dump.ticks_per_us = static_cast<double>(dump.ticks - start_ticks) / static_cast<double>(elapsed_us);
+        }
+        for (const auto& ring : rings) {
+            ThreadEvents thread;
+            thread.thread = ring->thread;
+            thread.events = snapshot(*ring);
+            result.events += thread.events.size();
+            dump.threads.push_back(move(thread));
+        }
+    }
+    result.threads = dump.threads.size();
+
+    error_code ec;
+    filesystem::create_directories(directory, ec);
+    result.path = (filesystem::path(directory) / ("flight-" + to_string(dump.unix_ms) + "-" + reason + ".bin")).string();
+    ofstream out(result.path, ios::binary | ios::trunc);
+    const string bytes = encode(dump);
+    out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    result.ok = static_cast<bool>(out);
+    if (!result.ok) {
+        spdlog::error("Flight recorder dump to {} failed", result.path);
+        return result;
+    }
+    metrics::flight_recorder_dumps.fetch_add(1, memory_order_relaxed);
+    spdlog::info("Flight recorder dump ({}): {} events from {} threads in {}", reason, result.events, result.threads,
+                 result.path);
+    return result;
+}
+
+void request_dump(const string& reason) {
+    if (!detail::enabled.load()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        pending.push_back(reason);
+    }
+    dump_wanted.notify_one();
+}
+
+void check_latency(int64_t duration_ms) {
+    const int threshold_ms = runtime_config::flight_recorder_slow_ms.load(memory_order_relaxed);
+    if (threshold_ms <= 0 || duration_ms < threshold_ms) {
+        return;
+    }
+    const int64_t now = now_ms();
+    int64_t last = last_slow_dump_ms.load(memory_order_relaxed);
+    if (last != 0 && now - last < kSlowDumpIntervalMs) {
+        return;
+    }
+    if (last_slow_dump_ms.compare_exchange_strong(last, now)) {
+        request_dump("slow");
+    }
+}
+}
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "cache_policy.h"
+#include "hot_restart.h"
+#include "metrics.h"
+#include "order_filter.h"
+#include "request_deadline.h"
+
+using namespace std;
+using namespace metrics;
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+namespace {
+using Clock = chrono::steady_clock;
+
+int64_t elapsed_ms(Clock::time_point since) {
+    return chrono::duration_cast<chrono::milliseconds>(Clock::now() - since).count();
+}
+
+// Calls f(name, counter) for every cumulative counter a snapshot carries, named as on
+// /metrics. Gauges (in-flight requests, pool sizes, filter items...) describe the process
+// itself and are not carried over.
+template<typename F>
+void for_each_counter(F&& f) {
+    f("total_requests", total_requests);
+    f("orders_created", orders_created);
+    f("orders_paid", orders_paid);
+    f("cache_hits", cache_hits);
+    f("cache_misses", cache_misses);
+    for (int i = 0; i < cache_policy::kPolicyCount; ++i) {
+        const string label = string("{policy=\"") + cache_policy::name(static_cast<cache_policy::Policy>(i)) + "\"}";
+        f("cache_policy_hits" + label, cache_policy_hits[i]);
+        f("cache_policy_misses" + label, cache_policy_misses[i]);
+        f("cache_policy_writes" + label, cache_policy_writes[i]);
+        f("cache_policy_stale_writes" + label, cache_policy_stale_writes[i]);
+    }
+    f("overload_rejections", overload_rejections);
+    f("shutdown_rejections", shutdown_rejections);
+    f("redis_errors", redis_errors);
+    f("sqlite_errors", sqlite_errors);
+    for (size_t stage = 0; stage < request_deadline::kStageCount; ++stage) {
+        f(string("request_deadline_exceeded{stage=\"") +
+              request_deadline::stage_name(static_cast<request_deadline::Stage>(stage)) + "\"}",
+          request_deadline_exceeded[stage]);
+    }
+    f("http_request_duration_ms_total", request_duration_ms_total);
+    f("http_request_duration_ms_count", request_duration_samples);
+    f("export_rows_total", export_rows_total);
+    f("exports_completed", exports_completed);
+    f("exports_aborted", exports_aborted);
+    f("orders_archived", orders_archived);
+    f("archive_runs", archive_runs);
+    f("archive_errors", archive_errors);
+    f("archive_hits", archive_hits);
+    f("order_filter_short_circuits", order_filter_short_circuits);
+    f("order_filter_false_positives", order_filter_false_positives);
+    f("redis_breaker_transitions", redis_breaker_transitions);
+    f("redis_short_circuits", redis_short_circuits);
+    f("redis_probes", redis_probes);
+    f("redis_probe_failures", redis_probe_failures);
+    f("redis_pool_checkouts", redis_pool_checkouts);
+    f("redis_pool_exhausted", redis_pool_exhausted);
+    f("redis_pool_timeouts", redis_pool_timeouts);
+    f("redis_pool_wait_us_total", redis_pool_wait_us_total);
+    for (auto& node : cache_nodes) {
+        const string label = "{node=\"" + node.name + "\"}";
+        f("redis_node_hits" + label, node.hits);
+        f("redis_node_misses" + label, node.misses);
+        f("redis_node_errors" + label, node.errors);
+        f("redis_node_short_circuits" + label, node.short_circuits);
+    }
+    for (auto& pool : executors) {
+        const string label = "{pool=\"" + pool.name + "\"}";
+        f("executor_submitted" + label, pool.submitted);
+        f("executor_rejected" + label, pool.rejected);
+        f("executor_completed" + label, pool.completed);
+        f("executor_queue_wait_us_total" + label, pool.queue_wait_us_total);
+    }
+    f("hot_restarts", hot_restarts);
+    f("config_changes_rejected", config_changes_rejected);
+    f("traces_exported", traces_exported);
+    f("traces_dropped", traces_dropped);
+    f("flight_recorder_dumps", flight_recorder_dumps);
+}
+
+#ifndef _WIN32
+bool fill_address(const string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        spdlog::error("Hot restart socket path must be 1-{} characters: '{}'", sizeof(addr.sun_path) - 1, path);
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+string running_executable() {
+    char path[PATH_MAX];
+    const ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return n > 0 ? string(path, static_cast<size_t>(n)) : string();
+}
+
+struct Server {
+    hot_restart::Options options;
+    function<int()> listen_fd;
+    function<hot_restart::Snapshot()> drain;
+    function<void()> stop_server;
+    int socket_fd = -1;
+    atomic<bool> stopping{false};
+    bool handed_off = false;
+    thread worker;
+};
+unique_ptr<Server> server;
+
+// Returns true once this process has handed over and is stopping.
+bool hand_over(Server& s, int channel) {
+    const auto started = Clock::now();
+    const int listen_fd = s.listen_fd();
+    if (listen_fd < 0 || !hot_restart::send_frame(channel, hot_restart::kListenerFrame, string(), listen_fd)) {
+        spdlog::error("Hot restart: could not pass the listening socket to the successor");
+        return false;
+    }
+    string ignored;
+    if (!hot_restart::recv_frame(channel, hot_restart::kAcceptingFrame, started + s.options.accept_timeout, ignored)) {
+        spdlog::error("Hot restart: successor did not start accepting within {} ms; keeping on serving",
+                      s.options.accept_timeout.count());
+        return false;
+    }
+    s.handed_off = true;
+    spdlog::info("Hot restart: successor accepts connections after {} ms; draining", elapsed_ms(started));
+
+    const hot_restart::Snapshot snapshot = s.drain();
+    const string payload = hot_restart::encode(snapshot);
+    if (!hot_restart::send_frame(channel, hot_restart::kSnapshotFrame, payload)) {
+        spdlog::error("Hot restart: could not send the state snapshot");
+    }
+    spdlog::info("Hot restart: handed over {} counters and {} bytes of state in {} ms",
+                 snapshot.counters.size(), payload.size(), elapsed_ms(started));
+    s.stop_server();
+    return true;
+}
+
+void serve(Server& s) {
+    while (!s.stopping.load()) {
+        const int channel = accept4(s.socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (channel < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (!s.stopping.load()) {
+                spdlog::error("Hot restart socket accept failed: {}", strerror(errno));
+            }
+            return;
+        }
+        const bool done = hand_over(s, channel);
+        close(channel);
+        if (done) {
+            return;
+        }
+    }
+}
+#endif
+}
+
+namespace hot_restart {
+Snapshot capture(int64_t drain_ms, int64_t requests_cut_off, int64_t connections_dropped) {
+    Snapshot snapshot;
+    snapshot.drain_ms = drain_ms;
+    snapshot.requests_cut_off = requests_cut_off;
+    snapshot.connections_dropped = connections_dropped;
+    for_each_counter([&snapshot](const string& name, const auto& counter) {
+        snapshot.counters.emplace_back(name, static_cast<int64_t>(counter.load()));
+    });
+    // Requests that were cut off may still add or remove orders; the successor then builds
+    // its own filter rather than start from one that could miss an order.
+    if (requests_cut_off == 0) {
+        snapshot.filter = order_filter::state();
+    }
+    return snapshot;
+}
+
+void apply(const Snapshot& snapshot) {
+    unordered_map<string, int64_t> values(snapshot.counters.begin(), snapshot.counters.end());
+    for_each_counter([&values](const string& name, auto& counter) {
+        const auto it = values.find(name);
+        if (it != values.end()) {
+            counter.fetch_add(static_cast<typename std::decay_t<decltype(counter)>::value_type>(it->second));
+        }
+    });
+    hot_restart_drain_ms.store(snapshot.drain_ms);
+    hot_restart_requests_cut_off.store(snapshot.requests_cut_off);
+    hot_restart_connections_dropped.store(snapshot.connections_dropped);
+    if (snapshot.filter) {
+        order_filter::restore(*snapshot.filter);
+    }
+}
+
+#ifndef _WIN32
+optional<Takeover> connect(const Options& options) {
+    sockaddr_un addr;
+    if (!fill_address(options.socket_path, addr)) {
+        return nullopt;
+    }
+    Takeover takeover;
+    takeover.started = Clock::now();
+    takeover.channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (takeover.channel < 0) {
+        return nullopt;
+    }
+    if (::connect(takeover.channel, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        // Nobody serving there (or a stale file from a crashed server): a cold start.
+        close(takeover.channel);
+        return nullopt;
+    }
+    string ignored;
+    if (!recv_frame(takeover.channel, kListenerFrame, takeover.started + options.accept_timeout, ignored,
+                    &takeover.listen_fd) ||
+        takeover.listen_fd < 0) {
+        spdlog::error("Hot restart: predecessor on {} did not pass its listening socket", options.socket_path);
+        if (takeover.listen_fd >= 0) {
+            close(takeover.listen_fd);
+        }
+        close(takeover.channel);
+        return nullopt;
+    }
+    spdlog::info("Hot restart: took over the listening socket from the server on {}", options.socket_path);
+    return takeover;
+}
+
+optional<Snapshot> complete(Takeover& takeover, const Options& options) {
+    hot_restarts.fetch_add(1);
+    const bool announced = send_frame(takeover.channel, kAcceptingFrame, string());
+    const auto handover_ms = elapsed_ms(takeover.started);
+    hot_restart_handover_ms.store(handover_ms);
+
+    string payload;
+    optional<Snapshot> snapshot;
+    if (announced && recv_frame(takeover.channel, kSnapshotFrame, Clock::now() + options.state_timeout, payload)) {
+        snapshot = decode(payload);
+    }
+    close(takeover.channel);
+    takeover.channel = -1;
+    if (!snapshot) {
+        spdlog::error("Hot restart: no state snapshot from the predecessor; starting with cold state");
+        return nullopt;
+    }
+    hot_restart_state_ms.store(elapsed_ms(takeover.started));
+    spdlog::info("Hot restart: accepting after {} ms, predecessor drained in {} ms with {} requests cut off and "
+                 "{} connections dropped, state received after {} ms",
+                 handover_ms, snapshot->drain_ms, snapshot->requests_cut_off, snapshot->connections_dropped,
+                 hot_restart_state_ms.load());
+    return snapshot;
+}
+
+bool start(const Options& options, function<int()> listen_fd, function<Snapshot()> drain, function<void()> stop_server) {
+    sockaddr_un addr;
+    if (server != nullptr || !fill_address(options.socket_path, addr)) {
+        return false;
+    }
+    auto s = make_unique<Server>();
+    s->options = options;
+    if (s->options.binary_path.empty()) {
+        s->options.binary_path = running_executable();
+    }
+    s->listen_fd = move(listen_fd);
+    s->drain = move(drain);
+    s->stop_server = move(stop_server);
+    s->socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s->socket_fd < 0) {
+        return false;
+    }
+    // Replaces the predecessor's socket file; its own socket lives on unnamed until it exits.
+    unlink(options.socket_path.c_str());
+    const mode_t previous_umask = umask(0077); // only this user may take the server over
+    const bool bound = bind(s->socket_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    umask(previous_umask);
+    if (!bound || listen(s->socket_fd, 1) != 0) {
+        spdlog::error("Hot restart socket {} unavailable: {}", options.socket_path, strerror(errno));
+        close(s->socket_fd);
+        return false;
+    }
+    Server* raw = s.get();
+    s->worker = thread([raw] { serve(*raw); });
+    server = move(s);
+    spdlog::info("Hot restart: waiting for a successor on {}", options.socket_path);
+    return true;
+}
+
+void stop() {
+    if (server == nullptr) {
+        return;
+    }
+    server->stopping.store(true);
+    shutdown(server->socket_fd, SHUT_RDWR); // wakes the blocked accept()
+    if (server->worker.joinable()) {
+        server->worker.join();
+    }
+    close(server->socket_fd);
+    if (!server->handed_off) {
+        unlink(server->options.socket_path.c_str());
+    }
+    server.reset();
+}
+
+bool spawn_successor(const Options& options) {
+    const string binary = options.binary_path.empty()
+        ? (server != nullptr ? server->options.binary_path : running_executable())
+        : options.binary_path;
+    if (binary.empty()) {
+        spdlog::error("Hot restart: no successor binary to start");
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    // Nothing but stdio is inherited; the listener is passed over the handoff socket.
+    posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+    char* const argv[] = {const_cast<char*>(binary.c_str()), nullptr};
+    pid_t pid = 0;
+    const int rc = posix_spawn(&pid, binary.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        spdlog::error("Hot restart: could not start {}: {}", binary, strerror(rc));
+        return false;
+    }
+    spdlog::info("Hot restart: started successor {} (pid {})", binary, pid);
+    return true;
+}
+#else
+optional<Takeover> connect(const Options&) {
+    return nullopt;
+}
+
+optional<Snapshot> complete(Takeover&, const Options&) {
+    return nullopt;
+}
+
+bool start(const Options&, function<int()>, function<Snapshot()>, function<void()>) {
+    spdlog::warn("Hot restart is not supported on this platform");
+    return false;
+}
+
+void stop() {}
+
+bool spawn_successor(const Options&) {
+    return false;
+}
+#endif
+}
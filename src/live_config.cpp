@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "live_config.h"
+#include "metrics.h"
+#include "runtime_config.h"
+#include "service_state.h"
+#include "storage_executors.h"
+
+using namespace std;
+
+namespace {
+// A reloadable setting. Writers are serialized by apply_mutex; readers elsewhere only ever
+// load the atomic a setting stores into. store() returns false when a valid value still
+// can't be applied, e.g. an executor that refuses to resize.
+struct Setting {
+    const char* name;
+    function<bool(const string&)> valid;
+    function<bool(const string&)> store;
+    function<string()> load;
+};
+
+Setting int_setting(const char* name, atomic<int>& target, int min, int max) {
+    return Setting{
+        name,
+        [min, max](const string& value) { return live_config::parse_int(value, min, max).has_value(); },
+        [&target, min, max](const string& value) {
+            target.store(*live_config::parse_int(value, min, max), memory_order_relaxed);
+            return true;
+        },
+        [&target] { return to_string(target.load(memory_order_relaxed)); }};
+}
+
+// Executor sizes resize the running pools in place.
+Setting executor_setting(const char* name, int storage_executors::Options::*field, int max) {
+    return Setting{
+        name,
+        [max](const string& value) { return live_config::parse_int(value, 1, max).has_value(); },
+        [field, max](const string& value) {
+            auto options = storage_executors::options();
+            options.*field = *live_config::parse_int(value, 1, max);
+            return storage_executors::resize(options);
+        },
+        [field] { return to_string(storage_executors::options().*field); }};
+}
+
+string lowercase(string value) {
+    transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
+        return static_cast<char>(tolower(c));
+    });
+    return value;
+}
+
+const vector<Setting>& settings() {
+    static const vector<Setting> all = {
+        Setting{
+            "LOG_LEVEL",
+            [](const string& value) {
+                const string level = lowercase(value);
+                return level == "off" || spdlog::level::from_str(level) != spdlog::level::off;
+            },
+            [](const string& value) {
+                spdlog::set_level(spdlog::level::from_str(lowercase(value)));
+                return true;
+            },
+            [] {
+                const auto name = spdlog::level::to_string_view(spdlog::get_level());
+                return string(name.data(), name.size());
+            }},
+        int_setting("CACHE_TTL_SECONDS", runtime_config::cache_ttl_seconds, 1, INT_MAX),
+        int_setting("CACHE_PAID_TTL_SECONDS", runtime_config::cache_paid_ttl_seconds, 1, INT_MAX),
+        int_setting("CACHE_TOMBSTONE_TTL_SECONDS", runtime_config::cache_tombstone_ttl_seconds, 1, INT_MAX),
+        int_setting("CACHE_TTL_JITTER_PERCENT", runtime_config::cache_ttl_jitter_percent, 0, 100),
+        Setting{
+            "CACHE_ENCODING",
+            [](const string& value) { return value == "binary" || value == "json" || value == "legacy"; },
+            [](const string& value) {
+                runtime_config::cache_legacy_values.store(value == "legacy", memory_order_relaxed);
+                runtime_config::cache_binary_encoding.store(value == "binary", memory_order_relaxed);
+                return true;
+            },
+            [] {
+                if (runtime_config::cache_legacy_values.load(memory_order_relaxed)) {
+                    return string("legacy");
+                }
+                return string(runtime_config::cache_binary_encoding.load(memory_order_relaxed) ? "binary" : "json");
+            }},
+        int_setting("REQUEST_TIMEOUT_MS", runtime_config::request_timeout_ms, 0, INT_MAX),
+        int_setting("LIST_TIMEOUT_MS", runtime_config::list_timeout_ms, 0, INT_MAX),
+        int_setting("EXPORT_TIMEOUT_MS", runtime_config::export_timeout_ms, 0, INT_MAX),
+        int_setting("MAX_INFLIGHT_REQUESTS", service_state::max_inflight_requests, 1, INT_MAX),
+        executor_setting("SQLITE_EXECUTOR_THREADS", &storage_executors::Options::sqlite_threads, 256),
+        executor_setting("SQLITE_EXECUTOR_QUEUE", &storage_executors::Options::sqlite_queue, 1 << 20),
+        executor_setting("REDIS_EXECUTOR_THREADS", &storage_executors::Options::redis_threads, 256),
+        executor_setting("REDIS_EXECUTOR_QUEUE", &storage_executors::Options::redis_queue, 1 << 20),
+        int_setting("ARCHIVE_BATCH_SIZE", runtime_config::archive_batch_size, 1, INT_MAX),
+        int_setting("ARCHIVE_INTERVAL_SECONDS", runtime_config::archive_interval_seconds, 1, INT_MAX),
+        Setting{
+            "SERVER_TIMING",
+            [](const string& value) { return value == "0" || value == "1"; },
+            [](const string& value) {
+                runtime_config::server_timing.store(value == "1", memory_order_relaxed);
+                return true;
+            },
+            [] { return string(runtime_config::server_timing.load(memory_order_relaxed) ? "1" : "0"); }},
+        int_setting("TRACE_SAMPLE_PERCENT", runtime_config::trace_sample_percent, 0, 100),
+        Setting{
+            "ALLOC_TRACKING",
+            [](const string& value) { return value == "0" || value == "1"; },
+            [](const string& value) {
+                runtime_config::alloc_tracking.store(value == "1", memory_order_relaxed);
+                return true;
+            },
+            [] { return string(runtime_config::alloc_tracking.load(memory_order_relaxed) ? "1" : "0"); }},
+        int_setting("FLIGHT_RECORDER_SLOW_MS", runtime_config::flight_recorder_slow_ms, 0, INT_MAX),
+    };
+    return all;
+}
+
+const Setting* find_setting(const string& name) {
+    for (const auto& setting : settings()) {
+        if (name == setting.name) {
+            return &setting;
+        }
+    }
+    return nullptr;
+}
+
+constexpr size_t kHistorySize = 16;
+
+mutex apply_mutex;
+string config_file;
+deque<live_config::Generation> generations;
+
+live_config::Result reject(const string& source, const string& error) {
+    metrics::config_changes_rejected.fetch_add(1, memory_order_relaxed);
+    spdlog::warn("Config change from {} rejected: {}", source, error);
+    live_config::Result result;
+    result.error = error;
+    result.generation = metrics::config_generation.load();
+    return result;
+}
+}
+
+namespace live_config {
+Result apply(const Settings& changes, const string& source) {
+    lock_guard<mutex> lock(apply_mutex);
+    for (const auto& [name, value] : changes) {
+        const Setting* setting = find_setting(name);
+        if (setting == nullptr) {
+            return reject(source, "unknown setting " + name);
+        }
+        if (!setting->valid(value)) {
+            return reject(source, "invalid value \"" + value + "\" for " + name);
+        }
+    }
+
+    Result result;
+    result.ok = true;
+    vector<pair<const Setting*, string>> previous;
+    for (const auto& [name, value] : changes) {
+        const Setting* setting = find_setting(name);
+        const string before = setting->load();
+        if (!setting->store(value)) {
+            // Put back what this change already applied, newest first.
+            for (auto undo = previous.rbegin(); undo != previous.rend(); ++undo) {
+                undo->first->store(undo->second);
+            }
+            return reject(source, "could not apply " + name + "=" + value);
+        }
+        previous.emplace_back(setting, before);
+        const string after = setting->load();
+        if (after != before) {
+            result.changed.push_back(name + "=" + after);
+        }
+    }
+    if (result.changed.empty()) {
+        result.generation = metrics::config_generation.load();
+        return result;
+    }
+
+    Generation generation;
+    generation.number = metrics::config_generation.load() + 1;
+    generation.applied_at = static_cast<int64_t>(time(nullptr));
+    generation.source = source;
+    generation.changed = result.changed;
+    ostringstream summary;
+    for (size_t i = 0; i < result.changed.size(); ++i) {
+        summary << (i == 0 ? "" : ", ") << result.changed[i];
+    }
+    spdlog::info("Config generation {} from {}: {}", generation.number, source, summary.str());
+
+    metrics::config_generation_timestamp_seconds.store(generation.applied_at);
+    metrics::config_generation.store(generation.number);
+    result.generation = generation.number;
+    generations.push_back(move(generation));
+    if (generations.size() > kHistorySize) {
+        generations.pop_front();
+    }
+    return result;
+}
+
+void set_file(const string& path) {
+    lock_guard<mutex> lock(apply_mutex);
+    config_file = path;
+}
+
+Result reload(const string& source) {
+    string path;
+    {
+        lock_guard<mutex> lock(apply_mutex);
+        path = config_file;
+    }
+    if (path.empty()) {
+        return reject(source, "CONFIG_FILE is not set");
+    }
+    ifstream in(path);
+    if (!in) {
+        return reject(source, "can't read " + path);
+    }
+    ostringstream text;
+    text << in.rdbuf();
+
+    Settings changes;
+    string error;
+    if (!parse(text.str(), changes, error)) {
+        return reject(source, path + ": " + error);
+    }
+    return live_config::apply(changes, source + " (" + path + ")");
+}
+
+Settings current() {
+    lock_guard<mutex> lock(apply_mutex);
+    Settings values;
+    for (const auto& setting : settings()) {
+        values.emplace_back(setting.name, setting.load());
+    }
+    return values;
+}
+
+vector<Generation> history() {
+    lock_guard<mutex> lock(apply_mutex);
+    return vector<Generation>(generations.begin(), generations.end());
+}
+}
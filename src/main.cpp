@@ -3,22 +3,41 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <thread>
 #include <csignal>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
+#include <vector>
 #include <sqlite3.h>
-#include <sw/redis++/redis++.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <cstdlib>
-#include "order_routes.h"
-#include "auth_middleware.h"
+#include "cache_breaker.h"
+#include "cache_warmup.h"
+#include "flight_recorder.h"
+#include "hot_restart.h"
+#include "live_config.h"
+#include "order_app.h"
 #include "metrics.h"
+#include "order_archive.h"
+#include "order_cache.h"
+#include "order_filter.h"
+#include "order_schema.h"
+#include "redis_cache.h"
+#include "request_deadline.h"
+#include "request_trace.h"
 #include "runtime_config.h"
 #include "service_state.h"
+#include "sharded_cache.h"
+#include "sql_stats.h"
+#include "storage_executors.h"
 
-using namespace sw::redis;
 using namespace std;
 using namespace metrics;
 using namespace service_state;
@@ -54,125 +73,71 @@ inline bool is_valid_order_no(const crow::json::rvalue& val) {
 //instead of calling it via the normal function-call mechanism. It’s often used for small, frequently used
 
 
-crow::response json_error(int code, const std::string& message) {
-    crow::json::wvalue err;
-    err["error"] = message;
-    return crow::response(code, err);
-}
-
 sqlite3* db = nullptr;
-Redis* redis = nullptr;
+order_cache::Backend* cache = nullptr;
 namespace { //everything inside is only visible in this .cpp file
-    unique_ptr<Redis> redis_owner;
-    atomic<bool> shutdown_signal_received{false};
-
-    void signal_handler(int /*signal_number*/) {
-        shutdown_signal_received.store(true, memory_order_relaxed);
-    }
-}
-
-struct ErrorHandlerMiddleware {
-    struct context {}; // Required even if unused
-
-    void before_handle(crow::request& req, crow::response& res, context& ctx) {
-        // Do nothing before request
-    }
-
-    void after_handle(crow::request& req, crow::response& res, context& ctx) {
-        if (res.code >= 400) {
-            // Log the error
-            spdlog::warn("Error {} on {} {}", res.code, crow::method_name(req.method), req.url);
-
-            // If response body is empty, fill with JSON error
-            if (res.body.empty()) {
-                std::string error_msg;
-
-                switch (res.code) {
-                    case 400: error_msg = "Bad Request"; break;
-                    case 404: error_msg = "Not Found"; break;
-                    case 500: error_msg = "Internal Server Error"; break;
-                    default:  error_msg = "HTTP Error"; break;
-                }
-
-                crow::json::wvalue json;
-                json["error"] = error_msg;
-                json["code"] = res.code;
-                res.set_header("Content-Type", "application/json");
-                res.body = json.dump(); 
+    vector<unique_ptr<order_cache::Backend>> cache_owners;
+
+    // Stops taking new connections and waits, up to max_drain, for the requests already in
+    // flight to finish and, with wait_for_connections, for the open connections to close.
+    // Returns the drain time in ms, or nullopt when a drain has already started.
+    optional<int64_t> drain(OrderApp& app, chrono::milliseconds max_drain, bool wait_for_connections) {
+        if (shutting_down.exchange(true)) {
+            return nullopt;
+        }
+        const auto started = chrono::steady_clock::now();
+        const auto deadline = started + max_drain;
+        spdlog::info("Draining {} in-flight requests on {} connections (up to {} ms).",
+                     in_flight_requests.load(), crow::open_connections.load(), max_drain.count());
+        app.wait_for_server_start();
+        app.stop_accepting();
+        const auto drained = [wait_for_connections] {
+            return in_flight_requests.load() <= 0 && (!wait_for_connections || crow::open_connections.load() <= 0);
+        };
+        {
+            unique_lock<mutex> lock(drain_mutex);
+            while (!drained() && chrono::steady_clock::now() < deadline) {
+                // Finished requests wake the wait; closed connections aren't signalled, so they
+                // are rechecked every few milliseconds.
+                drain_cv.wait_until(lock, wait_for_connections ? min(deadline, chrono::steady_clock::now() + chrono::milliseconds(10)) : deadline);
             }
         }
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
     }
-};
-
-struct LifecycleMiddleware {
-    struct context {
-        bool counted_inflight = false;
-    };
-
-    void before_handle(crow::request& req, crow::response& res, context& ctx) {
-        if (is_probe_path(req.url)) {
-            return;
-        }
-
-        if (shutting_down.load(memory_order_relaxed)) {
-            shutdown_rejections.fetch_add(1, memory_order_relaxed);
-            res = json_error(503, "Server is shutting down");
-            res.set_header("Retry-After", "5");
-            res.end();
-            return;
-        }
 
-        const int current_inflight = in_flight_requests.fetch_add(1, memory_order_relaxed) + 1;
-        ctx.counted_inflight = true;
-        if (current_inflight > max_inflight_requests.load(memory_order_relaxed)) {
-            in_flight_requests.fetch_sub(1, memory_order_relaxed);
-            ctx.counted_inflight = false;
-            overload_rejections.fetch_add(1, memory_order_relaxed);
-            res = json_error(503, "Server overloaded");
-            res.set_header("Retry-After", "1");
-            res.end();
+    void report_drain(int64_t drain_ms, int cut_off, int connections) {
+        if (cut_off > 0) {
+            spdlog::warn("Drain gave up after {} ms; cutting off {} in-flight requests on {} connections.",
+                         drain_ms, cut_off, connections);
+        } else {
+            spdlog::info("Drained in {} ms; closing {} idle connections.", drain_ms, connections);
         }
     }
 
-    void after_handle(crow::request& req, crow::response& res, context& ctx) {
-        if (ctx.counted_inflight) {
-            in_flight_requests.fetch_sub(1, memory_order_relaxed);
+    // Responses sent while draining carry Connection: close, and idle keep-alive connections
+    // close on their own timeout, so waiting for the connections drains those too.
+    void drain_and_stop(OrderApp& app, chrono::milliseconds max_drain) {
+        if (const auto drain_ms = drain(app, max_drain, true)) {
+            report_drain(*drain_ms, max(0, in_flight_requests.load()), crow::open_connections.load());
+            app.stop();
         }
     }
-};
-
-struct LoggingMiddleware {
-    struct context {
-        chrono::steady_clock::time_point start_time;
-    };
-
-    void before_handle(crow::request& req, crow::response& res, context& ctx) {
-    //Crow calls this function internally as part of its request lifecycle, and it expects all three parameters to be there.
-        ctx.start_time = chrono::steady_clock::now();
-    }
-
-    void after_handle(crow::request& req, crow::response& res, context& ctx) {
-        auto end_time = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - ctx.start_time).count();
-        total_requests.fetch_add(1, memory_order_relaxed);
-        observe_request_duration_ms(duration);
-
-        spdlog::info("{} {} {} ({} ms)", crow::method_name(req.method), req.url, res.code, duration);
 
+    // The hot-restart successor already accepts on the shared listener, so this process keeps
+    // serving the requests on its open connections while it drains, closing each connection
+    // after its response. Waiting for them to close, not just for the requests in flight,
+    // keeps idle keep-alive clients from losing their next request.
+    hot_restart::Snapshot drain_for_successor(OrderApp& app, chrono::milliseconds max_drain) {
+        handing_over.store(true);
+        const auto drain_ms = drain(app, max_drain, true);
+        // From here on requests are turned away, so nothing changes the order filter after the
+        // snapshot; a request admitted before this point still counts as in flight below.
+        handing_over.store(false);
+        const int cut_off = max(0, in_flight_requests.load());
+        const int connections = max(0, crow::open_connections.load());
+        report_drain(drain_ms.value_or(0), cut_off, connections);
+        return hot_restart::capture(drain_ms.value_or(0), cut_off, connections);
     }
-};
-
-string generate_order_no(){
-    long long timestamp = time(nullptr);
-    int rand_part = rand()%100000;
-    return "ORD" + to_string(timestamp) + to_string(rand_part);
-}
-
-string format_time(time_t t){
-    if(t == 0) return "N/A";
-    char buf[64];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t));
-    return string(buf);
 }
 
 void init_db(){
@@ -182,17 +147,18 @@ void init_db(){
         db_ready.store(false, memory_order_relaxed);
         exit(1);
     }
-    const char* sql = R"(
-        CREATE TABLE IF NOT EXISTS orders(
-            order_no TEXT PRIMARY KEY,
-            amount REAL,
-            status TEXT,
-            created_at INTEGER,
-            paid_at INTEGER
-        );
-    )";
+    // The archiver writes through its own connection, so wait on its lock instead of failing fast.
+    sql_stats::watch(db, "main", 5000);
+    // Checks the running request's deadline every 1000 VM instructions and aborts the statement
+    // once it has passed.
+    sqlite3_progress_handler(db, 1000, request_deadline::sqlite_progress, nullptr);
+
+    // auto_vacuum only takes effect on a fresh file, before the table is created.
+    const string sql = "PRAGMA auto_vacuum = INCREMENTAL;" +
+        order_schema::create_orders_table_sql() +
+        order_schema::create_orders_indexes_sql();
     char* errMsg = nullptr;
-    if(sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK){
+    if(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK){
         //cerr << "SQL error: " << errMsg << endl;
         spdlog::error("SQL error: {}", errMsg);
         sqlite3_free(errMsg);
@@ -213,118 +179,288 @@ int main(){
     init_db();
 
     runtime_config::api_key = get_env("API_KEY", "1234567");
+    runtime_config::admin_api_key = get_env("ADMIN_API_KEY", runtime_config::api_key);
+    profile_endpoint_public.store(get_env("PROFILE_ENDPOINT_PUBLIC", "0") != "0", memory_order_relaxed);
     runtime_config::cache_ttl_seconds.store(
         max(1, stoi(get_env("CACHE_TTL_SECONDS", "300"))),
         memory_order_relaxed);
+    runtime_config::cache_paid_ttl_seconds.store(
+        max(1, stoi(get_env("CACHE_PAID_TTL_SECONDS", "86400"))),
+        memory_order_relaxed);
+    runtime_config::cache_tombstone_ttl_seconds.store(
+        max(1, stoi(get_env("CACHE_TOMBSTONE_TTL_SECONDS", "60"))),
+        memory_order_relaxed);
+    runtime_config::cache_ttl_jitter_percent.store(
+        clamp(stoi(get_env("CACHE_TTL_JITTER_PERCENT", "10")), 0, 100),
+        memory_order_relaxed);
+    const string cache_encoding = get_env("CACHE_ENCODING", "binary");
+    runtime_config::cache_legacy_values.store(cache_encoding == "legacy", memory_order_relaxed);
+    runtime_config::cache_binary_encoding.store(
+        cache_encoding != "json" && cache_encoding != "legacy",
+        memory_order_relaxed);
+    runtime_config::request_timeout_ms.store(
+        max(0, stoi(get_env("REQUEST_TIMEOUT_MS", "2000"))),
+        memory_order_relaxed);
+    runtime_config::list_timeout_ms.store(
+        max(0, stoi(get_env("LIST_TIMEOUT_MS", "10000"))),
+        memory_order_relaxed);
+    runtime_config::export_timeout_ms.store(
+        max(0, stoi(get_env("EXPORT_TIMEOUT_MS", "300000"))),
+        memory_order_relaxed);
 
     max_inflight_requests.store(
         max(1, stoi(get_env("MAX_INFLIGHT_REQUESTS", "64"))),
         memory_order_relaxed);
+    runtime_config::server_timing.store(get_env("SERVER_TIMING", "0") != "0", memory_order_relaxed);
+    runtime_config::alloc_tracking.store(get_env("ALLOC_TRACKING", "0") != "0", memory_order_relaxed);
+    runtime_config::trace_sample_percent.store(
+        clamp(stoi(get_env("TRACE_SAMPLE_PERCENT", "0")), 0, 100),
+        memory_order_relaxed);
+    // The writer idles until TRACE_SAMPLE_PERCENT, which can change at runtime, samples requests.
+    const string trace_file = get_env("TRACE_FILE", "logs/traces.json");
+    if (!trace_file.empty()) {
+        request_trace::start_export(trace_file);
+    }
+    runtime_config::flight_recorder_slow_ms.store(
+        max(0, stoi(get_env("FLIGHT_RECORDER_SLOW_MS", "1000"))),
+        memory_order_relaxed);
+    if (get_env("FLIGHT_RECORDER_ENABLED", "1") != "0") {
+        flight_recorder::Options recorder_options;
+        recorder_options.events_per_thread = static_cast<size_t>(max(16, stoi(get_env("FLIGHT_RECORDER_EVENTS", "4096"))));
+        recorder_options.directory = get_env("FLIGHT_RECORDER_DIR", "logs");
+        flight_recorder::start(recorder_options);
+    }
+
+    order_archive::Options archive_options;
+    archive_options.archive_path = get_env("ARCHIVE_DB_PATH", "orders_archive.db");
+    archive_options.archive_after_seconds = max(0, stoi(get_env("ARCHIVE_AFTER_SECONDS", "604800")));
+    runtime_config::archive_interval_seconds.store(
+        max(1, stoi(get_env("ARCHIVE_INTERVAL_SECONDS", "60"))),
+        memory_order_relaxed);
+    runtime_config::archive_batch_size.store(
+        max(1, stoi(get_env("ARCHIVE_BATCH_SIZE", "500"))),
+        memory_order_relaxed);
+    archive_options.vacuum_pages_per_slice = max(1, stoi(get_env("ARCHIVE_VACUUM_PAGES", "256")));
+    const bool archive_enabled = get_env("ARCHIVE_ENABLED", "1") != "0";
+    if (archive_enabled && order_archive::attach(db, archive_options.archive_path)) {
+        order_archive::start(archive_options);
+    }
+
+    cache_breaker::Options breaker_options;
+    breaker_options.breaker.window_ms = max(100, stoi(get_env("REDIS_BREAKER_WINDOW_MS", "10000")));
+    breaker_options.breaker.min_calls = max(1, stoi(get_env("REDIS_BREAKER_MIN_CALLS", "20")));
+    breaker_options.breaker.failure_rate = stod(get_env("REDIS_BREAKER_FAILURE_RATE", "0.5"));
+    breaker_options.breaker.slow_call_ms = max(1, stoi(get_env("REDIS_BREAKER_SLOW_CALL_MS", "100")));
+    breaker_options.breaker.half_open_calls = max(1, stoi(get_env("REDIS_BREAKER_HALF_OPEN_CALLS", "5")));
+    breaker_options.probe_interval_ms = max(10, stoi(get_env("REDIS_PROBE_INTERVAL_MS", "1000")));
+
+    // With a server already running on HOT_RESTART_SOCKET this process takes over from it:
+    // its listener, and (once it has drained) its counters and order filter.
+    hot_restart::Options hot_restart_options;
+    hot_restart_options.socket_path = get_env("HOT_RESTART_SOCKET", "");
+    hot_restart_options.binary_path = get_env("HOT_RESTART_BINARY", "");
+    hot_restart_options.accept_timeout = chrono::milliseconds(max(100, stoi(get_env("HOT_RESTART_TIMEOUT_MS", "10000"))));
+    optional<hot_restart::Takeover> takeover;
+    if (!hot_restart_options.socket_path.empty()) {
+        takeover = hot_restart::connect(hot_restart_options);
+    }
+
+    const bool filter_enabled = get_env("ORDER_FILTER_ENABLED", "1") != "0";
+    order_filter::Options filter_options;
+    filter_options.false_positive_rate = stod(get_env("ORDER_FILTER_FP_RATE", "0.01"));
+    filter_options.min_capacity = max<int64_t>(1, stoll(get_env("ORDER_FILTER_MIN_CAPACITY", "100000")));
+    if (filter_enabled && takeover) {
+        order_filter::await_handoff();
+    } else if (filter_enabled) {
+        order_filter::build(db, filter_options);
+    }
 
-    string redis_host = get_env("REDIS_HOST", "127.0.0.1");
+    const int server_threads = max(1, stoi(get_env("SERVER_THREADS", to_string(max(1u, thread::hardware_concurrency())))));
+    order_cache::RedisOptions redis_options;
+    // One connection per Crow worker, so request threads never queue on the pool in steady state.
+    redis_options.pool_size = max(1, stoi(get_env("REDIS_POOL_SIZE", to_string(server_threads))));
+    redis_options.pool_wait_timeout_ms = max(1, stoi(get_env("REDIS_POOL_WAIT_TIMEOUT_MS", "100")));
+    redis_options.connect_timeout_ms = max(1, stoi(get_env("REDIS_CONNECT_TIMEOUT_MS", "200")));
+    redis_options.socket_timeout_ms = max(1, stoi(get_env("REDIS_SOCKET_TIMEOUT_MS", "200")));
+    redis_options.connection_lifetime_ms = max(0, stoi(get_env("REDIS_CONNECTION_LIFETIME_MS", "0")));
+    // Comma-separated host:port list; the single REDIS_HOST/REDIS_PORT pair is the default.
+    const string redis_nodes = get_env(
+        "REDIS_NODES", get_env("REDIS_HOST", "127.0.0.1") + ":" + get_env("REDIS_PORT", "6379"));
+    const int redis_virtual_nodes = max(1, stoi(get_env("REDIS_VIRTUAL_NODES", "160")));
+    vector<order_cache::Backend*> cache_nodes;
+    vector<string> cache_node_names;
     try {
-        redis_owner = make_unique<Redis>("tcp://" + redis_host + ":6379");
-        redis = redis_owner.get();
-        redis->ping();
-        redis_available.store(true, memory_order_relaxed);
+        stringstream node_list(redis_nodes);
+        string node;
+        while (getline(node_list, node, ',')) {
+            if (node.empty()) {
+                continue;
+            }
+            const auto colon = node.rfind(':');
+            redis_options.host = colon == string::npos ? node : node.substr(0, colon);
+            redis_options.port = colon == string::npos ? 6379 : stoi(node.substr(colon + 1));
+            cache_owners.push_back(order_cache::make_redis_backend(redis_options));
+            metrics::cache_nodes.emplace_back(node);
+            cache_nodes.push_back(cache_breaker::start(cache_owners.back().get(), metrics::cache_nodes.back(), breaker_options));
+            cache_node_names.push_back(node);
+        }
+        if (cache_nodes.size() == 1) {
+            cache = cache_nodes.front();
+        } else if (!cache_nodes.empty()) {
+            cache_owners.push_back(order_cache::make_sharded_backend(cache_nodes, cache_node_names, redis_virtual_nodes));
+            cache = cache_owners.back().get();
+        }
     } catch (const exception& ex) {
-        redis = nullptr;
+        cache = nullptr;
+        spdlog::error("Can't create Redis client: {}. Caching is disabled.", ex.what());
+    }
+    redis_pool_size.store(redis_options.pool_size * static_cast<int>(cache_nodes.size()), memory_order_relaxed);
+    spdlog::info("Caching across {} Redis node(s): {}", cache_nodes.size(), redis_nodes);
+    try {
+        if (cache != nullptr) {
+            cache->ping();
+            redis_available.store(true, memory_order_relaxed);
+        }
+    } catch (const exception& ex) {
+        // Failed pings opened those nodes' breakers; the prober reconnects them in the background.
         redis_available.store(false, memory_order_relaxed);
-        spdlog::warn("Redis unavailable at startup: {}. Service will run in degraded mode.", ex.what());
+        spdlog::warn("Redis unavailable at startup: {}. Service will run in degraded mode until it reconnects.", ex.what());
+    }
+
+    // After a hot restart the cache is as warm as the predecessor left it.
+    if (get_env("CACHE_WARMUP_ENABLED", "0") != "0" && !takeover) {
+        cache_warmup::Options warmup_options;
+        warmup_options.max_orders = max(0, stoi(get_env("CACHE_WARMUP_MAX_ORDERS", "10000")));
+        warmup_options.max_age_seconds = max(0, stoi(get_env("CACHE_WARMUP_MAX_AGE_SECONDS", "3600")));
+        warmup_options.batch_size = max(1, stoi(get_env("CACHE_WARMUP_BATCH_SIZE", "500")));
+        warmup_options.timeout_seconds = max(1, stoi(get_env("CACHE_WARMUP_TIMEOUT_SECONDS", "30")));
+        cache_warmup::start(db, cache, warmup_options);
     }
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Storage calls leave the Crow I/O threads; by default each pool matches the concurrency
+    // the I/O threads used to give that dependency.
+    storage_executors::Options executor_options;
+    executor_options.sqlite_threads = max(1, stoi(get_env("SQLITE_EXECUTOR_THREADS", to_string(server_threads))));
+    executor_options.sqlite_queue = max(1, stoi(get_env("SQLITE_EXECUTOR_QUEUE", "1024")));
+    executor_options.redis_threads = max(1, stoi(get_env("REDIS_EXECUTOR_THREADS", to_string(redis_options.pool_size))));
+    executor_options.redis_queue = max(1, stoi(get_env("REDIS_EXECUTOR_QUEUE", "1024")));
+    storage_executors::start(executor_options);
+
+    // Settings in CONFIG_FILE override the environment, and SIGHUP re-applies the file.
+    live_config::set_file(get_env("CONFIG_FILE", ""));
+    if (!get_env("CONFIG_FILE", "").empty()) {
+        live_config::reload("startup");
+    }
 
     //crow::SimpleApp app;
-    crow::App<LoggingMiddleware, LifecycleMiddleware, ErrorHandlerMiddleware, AuthMiddleware> app;
+    OrderApp app;
     app.signal_clear();
 
     const int port = stoi(get_env("SERVER_PORT", "8080"));
-    const int shutdown_drain_ms = max(0, stoi(get_env("SHUTDOWN_DRAIN_MS", "250")));
-    atomic<bool> stop_watcher{false};
-    thread signal_watcher([&app, &stop_watcher, shutdown_drain_ms]() {
-        while (!stop_watcher.load(memory_order_relaxed)) {
-            if (shutdown_signal_received.load(memory_order_relaxed)) {
-                if (!shutting_down.exchange(true, memory_order_relaxed)) {
-                    spdlog::info("Shutdown signal received. Entering drain mode.");
-                    this_thread::sleep_for(chrono::milliseconds(shutdown_drain_ms));
-                    app.stop();
-                }
-                break;
+    // Upper bound on the drain; shutdown proceeds as soon as the last in-flight request ends.
+    const chrono::milliseconds shutdown_drain(max(0, stoi(get_env("SHUTDOWN_DRAIN_MS", "5000"))));
+    hot_restart_options.state_timeout = hot_restart_options.accept_timeout + shutdown_drain;
+    asio::io_context signal_context;
+    asio::signal_set signals(signal_context, SIGINT, SIGTERM);
+#ifdef SIGUSR2
+    // SIGUSR2 starts a successor process for a hot restart.
+    signals.add(SIGUSR2);
+#endif
+#ifdef SIGHUP
+    // SIGHUP re-applies CONFIG_FILE.
+    signals.add(SIGHUP);
+#endif
+#ifdef SIGUSR1
+    // SIGUSR1 dumps the flight recorder.
+    signals.add(SIGUSR1);
+#endif
+    function<void()> wait_for_signal = [&]() {
+        signals.async_wait([&](const crow::error_code& ec, int signal_number) {
+            if (ec) {
+                return;
             }
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
+            if (signal_number == SIGINT || signal_number == SIGTERM) {
+                spdlog::info("Shutdown signal received.");
+                drain_and_stop(app, shutdown_drain);
+                return;
+            }
+#ifdef SIGHUP
+            if (signal_number == SIGHUP) {
+                live_config::reload("SIGHUP");
+                wait_for_signal();
+                return;
+            }
+#endif
+#ifdef SIGUSR1
+            if (signal_number == SIGUSR1) {
+                flight_recorder::request_dump("signal");
+                wait_for_signal();
+                return;
+            }
+#endif
+            if (hot_restart_options.socket_path.empty()) {
+                spdlog::warn("Hot restart requested, but HOT_RESTART_SOCKET is not set.");
+            } else {
+                hot_restart::spawn_successor(hot_restart_options);
+            }
+            wait_for_signal();
+        });
+    };
+    wait_for_signal();
+    thread signal_watcher([&signal_context]() {
+        signal_context.run();
     });
 
-    CROW_ROUTE(app, "/healthcheck").methods("GET"_method)([]() {
-        crow::json::wvalue res;
-        res["status"] = "ok";
-        return crow::response(200, res);
-    });
-    CROW_ROUTE(app, "/readiness").methods("GET"_method)([]() {
-        crow::json::wvalue res;
-        res["status"] = readiness_status();
-        res["ready"] = is_ready();
-        res["db_ready"] = db_ready.load(memory_order_relaxed);
-        res["redis_available"] = redis_available.load(memory_order_relaxed);
-
-        const int code = is_ready() ? 200 : 503;
-        return crow::response(code, res);
-    });
-    CROW_ROUTE(app, "/order/create").methods("POST"_method)(create_order);
-    CROW_ROUTE(app, "/order/get/<string>").methods("GET"_method)(get_order);
-    CROW_ROUTE(app, "/order/pay").methods("POST"_method)(pay_order);
-    CROW_ROUTE(app, "/order/list").methods("GET"_method)(list_orders);
-    CROW_ROUTE(app, "/order/delete/<string>").methods("DELETE"_method)(delete_order);
-    CROW_ROUTE(app, "/metrics").methods("GET"_method)([] {
-        ostringstream os;
-        os << "# TYPE total_requests counter\n";
-        os << "total_requests " << total_requests.load() << "\n";
-        os << "orders_created " << orders_created.load() << "\n";
-        os << "orders_paid " << orders_paid.load() << "\n";
-        os << "cache_hits " << cache_hits.load() << "\n";
-        os << "cache_misses " << cache_misses.load() << "\n";
-        os << "overload_rejections " << overload_rejections.load() << "\n";
-        os << "shutdown_rejections " << shutdown_rejections.load() << "\n";
-        os << "redis_errors " << redis_errors.load() << "\n";
-        os << "sqlite_errors " << sqlite_errors.load() << "\n";
-        os << "in_flight_requests " << in_flight_requests.load() << "\n";
-        os << "redis_available " << (redis_available.load() ? 1 : 0) << "\n";
-        os << "service_ready " << (is_ready() ? 1 : 0) << "\n";
-
-        const auto cache_total = cache_hits.load() + cache_misses.load();
-        const double cache_ratio = cache_total == 0
-            ? 0.0
-            : static_cast<double>(cache_hits.load()) / static_cast<double>(cache_total);
-        os << "cache_hit_ratio " << cache_ratio << "\n";
-
-        const auto latency_samples = request_duration_samples.load();
-        const auto latency_total = request_duration_ms_total.load();
-        const double latency_avg = latency_samples == 0
-            ? 0.0
-            : static_cast<double>(latency_total) / static_cast<double>(latency_samples);
-        os << "http_request_duration_ms_total " << latency_total << "\n";
-        os << "http_request_duration_ms_count " << latency_samples << "\n";
-        os << "http_request_duration_ms_avg " << latency_avg << "\n";
-        os << "http_request_duration_ms_max " << request_duration_ms_max.load() << "\n";
-
-        crow::response res;
-        res.code = 200;
-        res.set_header("Content-Type", "text/plain");
-        res.write(os.str());
-        return res;
-    });
+    register_routes(app);
+    track_request_allocations();
+    if (takeover) {
+        app.listen_fd(takeover->listen_fd);
+    }
 
+    thread hot_restart_thread;
+    if (!hot_restart_options.socket_path.empty()) {
+        hot_restart_thread = thread([&]() {
+            while (app.wait_for_server_start() == cv_status::timeout && !shutting_down.load()) {
+            }
+            if (takeover) {
+                if (const auto snapshot = hot_restart::complete(*takeover, hot_restart_options)) {
+                    hot_restart::apply(*snapshot);
+                }
+                if (filter_enabled && !order_filter::enabled()) {
+                    order_filter::build(db, filter_options);
+                }
+            }
+            if (!shutting_down.load()) {
+                hot_restart::start(
+                    hot_restart_options,
+                    [&app]() { return app.native_listen_handle(); },
+                    [&app, shutdown_drain]() { return drain_for_successor(app, shutdown_drain); },
+                    [&app]() { app.stop(); });
+            }
+        });
+    }
 
-    app.port(port).multithreaded().run();
+    // Crow's concurrency counts the acceptor thread on top of the request workers.
+    spdlog::info("Starting server on port {} with {} worker threads", port, server_threads);
+    app.port(port).concurrency(static_cast<uint16_t>(server_threads + 1)).run();
 
-    stop_watcher.store(true, memory_order_relaxed);
+    signal_context.stop();
     if (signal_watcher.joinable()) {
         signal_watcher.join();
     }
+    if (hot_restart_thread.joinable()) {
+        hot_restart_thread.join();
+    }
+    hot_restart::stop();
+    request_trace::stop_export();
+    flight_recorder::stop();
+    cache_warmup::stop();
+    storage_executors::stop();
+    cache_breaker::stop();
+    order_archive::stop();
 
     if (db != nullptr) {
+        sql_stats::unwatch(db);
         sqlite3_close(db);
     }
 }
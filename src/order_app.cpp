@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "alloc_stats.h"
+#include "cache_policy.h"
+#include "async_response.h"
+#include "circuit_breaker.h"
+#include "cpu_profiler.h"
+#include "flight_recorder.h"
+#include "live_config.h"
+#include "metrics.h"
+#include "order_app.h"
+#include "order_routes.h"
+#include "order_utils.h"
+#include "process_stats.h"
+#include "request_deadline.h"
+#include "service_state.h"
+#include "sql_stats.h"
+#include "storage_executors.h"
+
+using namespace std;
+using namespace metrics;
+using namespace service_state;
+
+namespace {
+crow::response config_result(const live_config::Result& result) {
+    if (!result.ok) {
+        return json_error(400, result.error);
+    }
+    crow::json::wvalue res;
+    res["generation"] = result.generation;
+    res["changed"] = crow::json::wvalue::list();
+    for (size_t i = 0; i < result.changed.size(); ++i) {
+        res["changed"][i] = result.changed[i];
+    }
+    return crow::response(200, res);
+}
+
+int query_int(const crow::request& req, const char* name, int fallback, int min, int max) {
+    const char* value = req.url_params.get(name);
+    return clamp(value == nullptr ? fallback : atoi(value), min, max);
+}
+
+crow::response profile_response(const cpu_profiler::Profile& profile) {
+    crow::response res(200, profile.folded);
+    res.set_header("Content-Type", "text/plain");
+    res.set_header("X-Profile-Samples", to_string(profile.samples));
+    res.set_header("X-Profile-Dropped", to_string(profile.dropped));
+    res.set_header("X-Profile-Threads", to_string(profile.threads));
+    return res;
+}
+}
+
+void track_request_allocations() {
+    crow::request_scope.enter = [](const crow::request& req) -> void* {
+        return alloc_stats::exchange(alloc_account_of(req));
+    };
+    crow::request_scope.leave = [](void* previous) {
+        alloc_stats::exchange(static_cast<alloc_stats::Account*>(previous));
+    };
+}
+
+void register_routes(OrderApp& app) {
+    CROW_ROUTE(app, "/healthcheck").methods("GET"_method)([]() {
+        crow::json::wvalue res;
+        res["status"] = "ok";
+        return crow::response(200, res);
+    });
+    CROW_ROUTE(app, "/readiness").methods("GET"_method)([]() {
+        crow::json::wvalue res;
+        res["status"] = readiness_status();
+        res["ready"] = is_ready();
+        res["db_ready"] = db_ready.load(memory_order_relaxed);
+        res["redis_available"] = redis_available.load(memory_order_relaxed);
+        for (const auto& node : cache_nodes) {
+            res["redis_breaker"][node.name] =
+                CircuitBreaker::state_name(static_cast<CircuitBreaker::State>(node.breaker_state.load(memory_order_relaxed)));
+        }
+        res["warmup"]["in_progress"] = warming_up.load(memory_order_relaxed);
+        res["warmup"]["orders_loaded"] = warmup_orders_loaded.load(memory_order_relaxed);
+        res["warmup"]["orders_total"] = warmup_orders_total.load(memory_order_relaxed);
+
+        const int code = is_ready() ? 200 : 503;
+        return crow::response(code, res);
+    });
+    // Live configuration; AuthMiddleware checks ADMIN_API_KEY on /admin/ routes.
+    CROW_ROUTE(app, "/admin/config").methods("GET"_method)([] {
+        crow::json::wvalue res;
+        res["generation"] = config_generation.load();
+        res["applied_at"] = config_generation_timestamp_seconds.load();
+        for (const auto& [name, value] : live_config::current()) {
+            res["settings"][name] = value;
+        }
+        const auto history = live_config::history();
+        res["history"] = crow::json::wvalue::list();
+        for (size_t i = 0; i < history.size(); ++i) {
+            res["history"][i]["generation"] = history[i].number;
+            res["history"][i]["applied_at"] = history[i].applied_at;
+            res["history"][i]["source"] = history[i].source;
+            for (size_t j = 0; j < history[i].changed.size(); ++j) {
+                res["history"][i]["changed"][j] = history[i].changed[j];
+            }
+        }
+        return crow::response(200, res);
+    });
+    // Body: {"SETTING": value, ...}, applied all together or not at all.
+    CROW_ROUTE(app, "/admin/config").methods("POST"_method)([](const crow::request& req) {
+        const auto body = crow::json::load(req.body);
+        if (!body || body.t() != crow::json::type::Object) {
+            return json_error(400, "Expected a JSON object of settings");
+        }
+        live_config::Settings changes;
+        for (const auto& value : body) {
+            if (value.t() == crow::json::type::String) {
+                changes.emplace_back(value.key(), value.s());
+            } else if (value.t() == crow::json::type::Number) {
+                changes.emplace_back(value.key(), crow::json::wvalue(value).dump());
+            } else {
+                return json_error(400, "Setting values must be strings or numbers");
+            }
+        }
+        return config_result(live_config::apply(changes, "admin API"));
+    });
+    CROW_ROUTE(app, "/admin/config/reload").methods("POST"_method)([] {
+        return config_result(live_config::reload("admin API"));
+    });
+    // Writes the flight recorder's rings to a file now; decode it with tools/flight_decode.
+    CROW_ROUTE(app, "/admin/flight-recorder/dump").methods("POST"_method)([](const crow::request& req, crow::response& res) {
+        if (!flight_recorder::enabled()) {
+            res = json_error(503, "The flight recorder is off");
+            res.end();
+            return;
+        }
+        // Copying every ring and writing the file takes a few milliseconds; it runs on a SQLite
+        // pool thread rather than the I/O thread, and is shed like any request when that pool's
+        // queue is full.
+        const bool queued = storage_executors::sqlite().submit([&req, &res] {
+            const auto dump = flight_recorder::dump("admin");
+            if (!dump.ok) {
+                complete_response(req, res, json_error(500, "Could not write the flight recorder dump"));
+                return;
+            }
+            crow::json::wvalue body;
+            body["file"] = dump.path;
+            body["threads"] = dump.threads;
+            body["events"] = dump.events;
+            complete_response(req, res, crow::response(200, body));
+        });
+        if (!queued) {
+            res = storage_busy(storage_executors::sqlite());
+            res.end();
+        }
+    });
+    // Samples every thread's CPU for ?seconds= (1-60, default 10) at ?hz= (1-1000, default 99)
+    // and answers with folded stacks for flame-graph tools. The wait is a timer on the
+    // connection's io_context, so the I/O thread keeps serving other connections meanwhile.
+    CROW_ROUTE(app, "/debug/profile").methods("GET"_method)([](const crow::request& req, crow::response& res) {
+        cpu_profiler::Options options;
+        options.seconds = query_int(req, "seconds", 10, 1, 60);
+        options.hz = query_int(req, "hz", 99, 1, 1000);
+        switch (cpu_profiler::start(options)) {
+            case cpu_profiler::StartResult::Started:
+                break;
+            case cpu_profiler::StartResult::Busy:
+                res = json_error(409, "A profile is already running");
+                res.end();
+                return;
+            case cpu_profiler::StartResult::Unsupported:
+                res = json_error(501, "CPU profiling is not supported on this platform");
+                res.end();
+                return;
+            case cpu_profiler::StartResult::Failed:
+                res = json_error(500, "Could not start the CPU profiler");
+                res.end();
+                return;
+        }
+        if (req.io_context == nullptr) {
+            this_thread::sleep_for(chrono::seconds(options.seconds));
+            res = profile_response(cpu_profiler::stop());
+            res.end();
+            return;
+        }
+        auto timer = make_shared<asio::steady_timer>(*req.io_context, chrono::seconds(options.seconds));
+        timer->async_wait([&req, &res, timer](const crow::error_code&) {
+            // Symbolizing takes a while: it runs on a SQLite pool thread rather than the I/O
+            // thread, unless that pool's queue is full.
+            const auto finish = [&req, &res] { complete_response(req, res, profile_response(cpu_profiler::stop())); };
+            if (!storage_executors::sqlite().submit(finish)) {
+                finish();
+            }
+        });
+    });
+    CROW_ROUTE(app, "/order/create").methods("POST"_method)(create_order);
+#ifdef ORDER_SERVICE_COROUTINES
+    CROW_ROUTE(app, "/order/get/<string>").methods("GET"_method)(route_coro::route(get_order));
+#else
+    CROW_ROUTE(app, "/order/get/<string>").methods("GET"_method)(get_order);
+#endif
+    CROW_ROUTE(app, "/order/pay").methods("POST"_method)(pay_order);
+    CROW_ROUTE(app, "/order/list").methods("GET"_method)(list_orders);
+    CROW_ROUTE(app, "/order/delete/<string>").methods("DELETE"_method)(delete_order);
+    CROW_ROUTE(app, "/order/export").methods("GET"_method)(export_orders);
+    CROW_ROUTE(app, "/metrics").methods("GET"_method)([&app] {
+        ostringstream os;
+        os << "# TYPE total_requests counter\n";
+        os << "total_requests " << total_requests.load() << "\n";
+        os << "orders_created " << orders_created.load() << "\n";
+        os << "orders_paid " << orders_paid.load() << "\n";
+        os << "cache_hits " << cache_hits.load() << "\n";
+        os << "cache_misses " << cache_misses.load() << "\n";
+        for (int i = 0; i < cache_policy::kPolicyCount; ++i) {
+            const string label = string("{policy=\"") + cache_policy::name(static_cast<cache_policy::Policy>(i)) + "\"} ";
+            const auto hits = cache_policy_hits[i].load();
+            const auto misses = cache_policy_misses[i].load();
+            os << "cache_policy_hits" << label << hits << "\n";
+            os << "cache_policy_misses" << label << misses << "\n";
+            os << "cache_policy_hit_ratio" << label
+               << (hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses)) << "\n";
+            os << "cache_policy_writes" << label << cache_policy_writes[i].load() << "\n";
+            os << "cache_policy_stale_writes" << label << cache_policy_stale_writes[i].load() << "\n";
+        }
+        os << "overload_rejections " << overload_rejections.load() << "\n";
+        os << "shutdown_rejections " << shutdown_rejections.load() << "\n";
+        os << "redis_errors " << redis_errors.load() << "\n";
+        os << "sqlite_errors " << sqlite_errors.load() << "\n";
+        os << "in_flight_requests " << in_flight_requests.load() << "\n";
+        os << "redis_available " << (redis_available.load() ? 1 : 0) << "\n";
+        os << "service_ready " << (is_ready() ? 1 : 0) << "\n";
+
+        const auto cache_total = cache_hits.load() + cache_misses.load();
+        const double cache_ratio = cache_total == 0
+            ? 0.0
+            : static_cast<double>(cache_hits.load()) / static_cast<double>(cache_total);
+        os << "cache_hit_ratio " << cache_ratio << "\n";
+
+        const auto latency_samples = request_duration_samples.load();
+        const auto latency_total = request_duration_ms_total.load();
+        const double latency_avg = latency_samples == 0
+            ? 0.0
+            : static_cast<double>(latency_total) / static_cast<double>(latency_samples);
+        os << "http_request_duration_ms_total " << latency_total << "\n";
+        os << "http_request_duration_ms_count " << latency_samples << "\n";
+        os << "http_request_duration_ms_avg " << latency_avg << "\n";
+        os << "http_request_duration_ms_max " << request_duration_ms_max.load() << "\n";
+        os << "export_rows_total " << export_rows_total.load() << "\n";
+        os << "export_last_rows_per_second " << export_last_rows_per_second.load() << "\n";
+        os << "exports_completed " << exports_completed.load() << "\n";
+        os << "exports_aborted " << exports_aborted.load() << "\n";
+        os << "orders_archived " << orders_archived.load() << "\n";
+        os << "archive_runs " << archive_runs.load() << "\n";
+        os << "archive_errors " << archive_errors.load() << "\n";
+        os << "archive_vacuum_slices " << archive_vacuum_slices.load() << "\n";
+        os << "archive_hits " << archive_hits.load() << "\n";
+        os << "hot_orders_rows " << hot_orders_rows.load() << "\n";
+        os << "archive_orders_rows " << archive_orders_rows.load() << "\n";
+        os << "archive_lag_seconds " << archive_lag_seconds.load() << "\n";
+        for (size_t stage = 0; stage < request_deadline::kStageCount; ++stage) {
+            os << "request_deadline_exceeded{stage=\"" << request_deadline::stage_name(static_cast<request_deadline::Stage>(stage))
+               << "\"} " << request_deadline_exceeded[stage].load() << "\n";
+        }
+        os << "order_filter_short_circuits " << order_filter_short_circuits.load() << "\n";
+        os << "order_filter_false_positives " << order_filter_false_positives.load() << "\n";
+        os << "order_filter_items " << order_filter_items.load() << "\n";
+        os << "order_filter_capacity " << order_filter_capacity.load() << "\n";
+        os << "redis_breaker_transitions " << redis_breaker_transitions.load() << "\n";
+        os << "redis_short_circuits " << redis_short_circuits.load() << "\n";
+        os << "redis_probes " << redis_probes.load() << "\n";
+        os << "redis_probe_failures " << redis_probe_failures.load() << "\n";
+        os << "redis_pool_size " << redis_pool_size.load() << "\n";
+        os << "redis_pool_in_use " << redis_pool_in_use.load() << "\n";
+        os << "redis_pool_checkouts " << redis_pool_checkouts.load() << "\n";
+        os << "redis_pool_exhausted " << redis_pool_exhausted.load() << "\n";
+        os << "redis_pool_timeouts " << redis_pool_timeouts.load() << "\n";
+        os << "redis_pool_wait_us_total " << redis_pool_wait_us_total.load() << "\n";
+        os << "redis_pool_wait_us_max " << redis_pool_wait_us_max.load() << "\n";
+        os << "hot_restarts " << hot_restarts.load() << "\n";
+        os << "hot_restart_handover_ms " << hot_restart_handover_ms.load() << "\n";
+        os << "hot_restart_state_ms " << hot_restart_state_ms.load() << "\n";
+        os << "hot_restart_drain_ms " << hot_restart_drain_ms.load() << "\n";
+        os << "hot_restart_requests_cut_off " << hot_restart_requests_cut_off.load() << "\n";
+        os << "hot_restart_connections_dropped " << hot_restart_connections_dropped.load() << "\n";
+        os << "config_generation " << config_generation.load() << "\n";
+        os << "config_generation_timestamp_seconds " << config_generation_timestamp_seconds.load() << "\n";
+        os << "config_changes_rejected " << config_changes_rejected.load() << "\n";
+        os << "traces_exported " << traces_exported.load() << "\n";
+        os << "traces_dropped " << traces_dropped.load() << "\n";
+        os << "flight_recorder_dumps " << flight_recorder_dumps.load() << "\n";
+        for (const auto& node : cache_nodes) {
+            const string label = "{node=\"" + node.name + "\"} ";
+            os << "redis_node_breaker_state" << label << node.breaker_state.load() << "\n";
+            os << "redis_node_hits" << label << node.hits.load() << "\n";
+            os << "redis_node_misses" << label << node.misses.load() << "\n";
+            os << "redis_node_errors" << label << node.errors.load() << "\n";
+            os << "redis_node_short_circuits" << label << node.short_circuits.load() << "\n";
+        }
+        for (const auto& pool : executors) {
+            const string label = "{pool=\"" + pool.name + "\"} ";
+            const int threads = pool.threads.load();
+            const int capacity = pool.queue_capacity.load();
+            const int depth = pool.queue_depth.load();
+            const int active = pool.active.load();
+            os << "executor_threads" << label << threads << "\n";
+            os << "executor_active" << label << active << "\n";
+            os << "executor_utilization" << label
+               << (threads == 0 ? 0.0 : static_cast<double>(active) / threads) << "\n";
+            os << "executor_queue_capacity" << label << capacity << "\n";
+            os << "executor_queue_depth" << label << depth << "\n";
+            os << "executor_saturation" << label
+               << (capacity == 0 ? 0.0 : static_cast<double>(depth) / capacity) << "\n";
+            os << "executor_submitted" << label << pool.submitted.load() << "\n";
+            os << "executor_rejected" << label << pool.rejected.load() << "\n";
+            os << "executor_completed" << label << pool.completed.load() << "\n";
+            os << "executor_queue_wait_us_total" << label << pool.queue_wait_us_total.load() << "\n";
+            os << "executor_queue_wait_us_max" << label << pool.queue_wait_us_max.load() << "\n";
+        }
+        for (const sql_stats::Statement* statement : sql_stats::statements()) {
+            const string name = string("statement=\"") + statement->label() + "\"";
+            const string label = "{" + name + "} ";
+            os << "sqlite_statement_executions" << label << statement->executions.load() << "\n";
+            os << "sqlite_statement_errors" << label << statement->errors.load() << "\n";
+            int64_t cumulative = 0;
+            for (size_t bucket = 0; bucket < sql_stats::kBucketCount; ++bucket) {
+                cumulative += statement->buckets[bucket].load();
+                const string le = bucket < sql_stats::kBucketBoundsUs.size() ? to_string(sql_stats::kBucketBoundsUs[bucket]) : "+Inf";
+                os << "sqlite_statement_duration_us_bucket{" << name << ",le=\"" << le << "\"} " << cumulative << "\n";
+            }
+            os << "sqlite_statement_duration_us_sum" << label << statement->duration_us_total.load() << "\n";
+            os << "sqlite_statement_duration_us_count" << label << cumulative << "\n";
+            os << "sqlite_statement_fullscan_steps" << label << statement->fullscan_steps.load() << "\n";
+            os << "sqlite_statement_sorts" << label << statement->sorts.load() << "\n";
+            os << "sqlite_statement_autoindexes" << label << statement->autoindexes.load() << "\n";
+            os << "sqlite_statement_vm_steps" << label << statement->vm_steps.load() << "\n";
+        }
+        for (const auto& connection : sql_stats::connections()) {
+            const string label = "{connection=\"" + connection.name + "\"} ";
+            os << "sqlite_cache_hits" << label << connection.cache_hits << "\n";
+            os << "sqlite_cache_misses" << label << connection.cache_misses << "\n";
+            os << "sqlite_cache_writes" << label << connection.cache_writes << "\n";
+            os << "sqlite_cache_used_bytes" << label << connection.cache_used_bytes << "\n";
+            os << "sqlite_busy_waits" << label << connection.busy_waits << "\n";
+            os << "sqlite_busy_wait_us_total" << label << connection.busy_wait_us_total << "\n";
+            os << "sqlite_busy_timeouts" << label << connection.busy_timeouts << "\n";
+        }
+        const auto io_threads = app.io_threads();
+        for (size_t i = 0; i < io_threads.size(); ++i) {
+            const string label = "{thread=\"" + to_string(i) + "\"} ";
+            os << "io_thread_connections" << label << io_threads[i].connections << "\n";
+            os << "io_thread_pending_timeouts" << label << io_threads[i].pending_timeouts << "\n";
+        }
+        const auto& connections = crow::connection_stats;
+        const auto parsed = connections.requests.load();
+        const auto reused = connections.reused.load();
+        os << "http_connections_open " << crow::open_connections.load() << "\n";
+        os << "http_connections_accepted " << connections.accepted.load() << "\n";
+        os << "http_connections_closed " << connections.closed.load() << "\n";
+        os << "http_requests_parsed " << parsed << "\n";
+        os << "http_keep_alive_reused " << reused << "\n";
+        os << "http_keep_alive_reuse_ratio "
+           << (parsed == 0 ? 0.0 : static_cast<double>(reused) / static_cast<double>(parsed)) << "\n";
+        os << "http_bytes_in " << connections.bytes_in.load() << "\n";
+        os << "http_bytes_out " << connections.bytes_out.load() << "\n";
+        os << "http_parse_errors " << connections.parse_errors.load() << "\n";
+        os << "process_resident_memory_bytes " << process_stats::resident_bytes() << "\n";
+        os << "process_cpu_seconds " << process_stats::cpu_seconds() << "\n";
+        for (const auto& thread : process_stats::threads()) {
+            const string label = "{thread=\"" + thread.name + "\"} ";
+            os << "thread_count" << label << thread.threads << "\n";
+            os << "thread_cpu_seconds" << label << thread.cpu_seconds << "\n";
+        }
+        const auto heap = alloc_stats::totals();
+        os << "heap_allocations " << heap.allocations << "\n";
+        os << "heap_frees " << heap.frees << "\n";
+        os << "heap_allocated_bytes " << heap.allocated_bytes << "\n";
+        os << "heap_freed_bytes " << heap.freed_bytes << "\n";
+        os << "heap_live_bytes " << (heap.allocated_bytes >= heap.freed_bytes ? heap.allocated_bytes - heap.freed_bytes : 0) << "\n";
+        for (const auto& route : alloc_stats::routes()) {
+            const string label = "{route=\"" + route.route + "\"} ";
+            os << "request_allocations_tracked" << label << route.requests << "\n";
+            os << "request_allocations" << label << route.allocations << "\n";
+            os << "request_allocated_bytes" << label << route.bytes << "\n";
+            os << "request_allocations_max" << label << route.max_allocations << "\n";
+        }
+
+        crow::response res;
+        res.code = 200;
+        res.set_header("Content-Type", "text/plain");
+        res.write(os.str());
+        return res;
+    });
+}
@@ -0,0 +1,278 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sqlite3.h>
+#include <spdlog/spdlog.h>
+
+#include "metrics.h"
+#include "order_archive.h"
+#include "order_schema.h"
+#include "runtime_config.h"
+#include "service_state.h"
+#include "sql_stats.h"
+
+using namespace std;
+using namespace metrics;
+
+namespace {
+constexpr int kBusyTimeoutMs = 5000;
+// COMMIT has to wait for every reader of the main file to finish, and while it waits it holds
+// the PENDING lock, which keeps new readers out as well. So it gets a much shorter wait than
+// the other statements; a batch that still can't commit is rolled back and tried again on the
+// next run.
+constexpr int kCommitBusyTimeoutMs = 250;
+
+atomic<bool> archive_attached{false};
+mutex archiver_mutex;
+condition_variable archiver_cv;
+bool archiver_stopping = false;
+thread archiver_thread;
+
+bool exec_sql(sqlite3* conn, const string& sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        archive_errors.fetch_add(1, memory_order_relaxed);
+        spdlog::error("Archive SQL error: {}", err_msg ? err_msg : sqlite3_errmsg(conn));
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
+int64_t query_int64(sqlite3* conn, const char* sql, int64_t bind_value = -1) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        archive_errors.fetch_add(1, memory_order_relaxed);
+        spdlog::error("Archive prepare failed: {}", sqlite3_errmsg(conn));
+        return 0;
+    }
+    if (bind_value >= 0) {
+        sqlite3_bind_int64(stmt, 1, bind_value);
+    }
+    const int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// Ends the open transaction, if a failed statement didn't already, so the connection lets go
+// of its locks.
+void rollback(sqlite3* conn) {
+    if (!sqlite3_get_autocommit(conn)) {
+        exec_sql(conn, "ROLLBACK;");
+    }
+}
+
+bool commit(sqlite3* conn) {
+    sql_stats::set_busy_timeout(conn, kCommitBusyTimeoutMs);
+    const bool committed = exec_sql(conn, "COMMIT;");
+    sql_stats::set_busy_timeout(conn, kBusyTimeoutMs);
+    return committed;
+}
+
+// Moves one batch of eligible PAID orders inside a single transaction spanning both files.
+// Returns the number of rows moved, or -1 on failure, with the transaction rolled back.
+int archive_batch(sqlite3* conn, int64_t cutoff, int batch_size) {
+    const char* eligible =
+        "SELECT order_no FROM main.orders WHERE status = 'PAID' AND paid_at > 0 AND paid_at < ?1 "
+        "ORDER BY paid_at, order_no LIMIT ?2";
+    const string copy_sql =
+        string("INSERT OR REPLACE INTO archive.orders (order_no, amount, status, created_at, paid_at) "
+               "SELECT order_no, amount, status, created_at, paid_at FROM main.orders WHERE order_no IN (") +
+        eligible + ");";
+    const string delete_sql = string("DELETE FROM main.orders WHERE order_no IN (") + eligible + ");";
+
+    if (!exec_sql(conn, "BEGIN IMMEDIATE;")) {
+        return -1;
+    }
+
+    int moved = -1;
+    sqlite3_stmt* stmt = nullptr;
+    for (const string* sql : {&copy_sql, &delete_sql}) {
+        if (sqlite3_prepare_v2(conn, sql->c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            spdlog::error("Archive prepare failed: {}", sqlite3_errmsg(conn));
+            moved = -1;
+            break;
+        }
+        sqlite3_bind_int64(stmt, 1, cutoff);
+        sqlite3_bind_int(stmt, 2, batch_size);
+        const int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            spdlog::error("Archive step failed: {}", sqlite3_errmsg(conn));
+            moved = -1;
+            break;
+        }
+        moved = sqlite3_changes(conn);
+    }
+
+    if (moved < 0) {
+        archive_errors.fetch_add(1, memory_order_relaxed);
+        rollback(conn);
+        return -1;
+    }
+    if (!commit(conn)) {
+        rollback(conn);
+        return -1;
+    }
+    return moved;
+}
+
+bool service_busy() {
+    return in_flight_requests.load(memory_order_relaxed) >
+           service_state::max_inflight_requests.load(memory_order_relaxed) / 2;
+}
+
+bool wait_for_stop(chrono::milliseconds timeout) {
+    unique_lock<mutex> lock(archiver_mutex);
+    return archiver_cv.wait_for(lock, timeout, [] { return archiver_stopping; });
+}
+
+// Reclaims free pages a slice at a time and refreshes planner statistics, backing off
+// whenever request traffic picks up so maintenance never competes with foreground work.
+// Only a file created with auto_vacuum=INCREMENTAL (2) can give pages back; on any other the
+// vacuum is a no-op, so it is skipped. A run stops after kMaxVacuumSlices, or as soon as a
+// slice frees nothing, and leaves the rest to the next run.
+void run_maintenance(sqlite3* conn, int pages_per_slice) {
+    constexpr int kMaxVacuumSlices = 100;
+    if (query_int64(conn, "PRAGMA main.auto_vacuum;") == 2) {
+        const string vacuum_sql = "PRAGMA main.incremental_vacuum(" + to_string(pages_per_slice) + ");";
+        int64_t free_pages = query_int64(conn, "PRAGMA main.freelist_count;");
+        for (int slice = 0; slice < kMaxVacuumSlices && free_pages > 0; ++slice) {
+            if (service_busy()) {
+                return;
+            }
+            if (!exec_sql(conn, vacuum_sql)) {
+                return;
+            }
+            archive_vacuum_slices.fetch_add(1, memory_order_relaxed);
+            const int64_t remaining = query_int64(conn, "PRAGMA main.freelist_count;");
+            if (remaining >= free_pages) {
+                break;
+            }
+            free_pages = remaining;
+            if (wait_for_stop(chrono::milliseconds(50))) {
+                return;
+            }
+        }
+    }
+
+    if (!service_busy()) {
+        exec_sql(conn, "PRAGMA analysis_limit = 1000; PRAGMA optimize;");
+    }
+}
+
+void update_tier_metrics(sqlite3* conn, int64_t cutoff) {
+    hot_orders_rows.store(query_int64(conn, "SELECT COUNT(*) FROM main.orders;"), memory_order_relaxed);
+    archive_orders_rows.store(query_int64(conn, "SELECT COUNT(*) FROM archive.orders;"), memory_order_relaxed);
+
+    const int64_t oldest_eligible = query_int64(
+        conn,
+        "SELECT COALESCE(MIN(paid_at), 0) FROM main.orders WHERE status = 'PAID' AND paid_at > 0 AND paid_at < ?;",
+        cutoff);
+    archive_lag_seconds.store(oldest_eligible == 0 ? 0 : cutoff - oldest_eligible, memory_order_relaxed);
+}
+
+bool attach_archive(sqlite3* conn, const string& archive_path) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "ATTACH DATABASE ? AS archive;", -1, &stmt, nullptr) != SQLITE_OK) {
+        spdlog::error("Archive attach prepare failed: {}", sqlite3_errmsg(conn));
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, archive_path.c_str(), -1, SQLITE_TRANSIENT);
+    const int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        spdlog::error("Can't attach archive DB {}: {}", archive_path, sqlite3_errmsg(conn));
+        return false;
+    }
+
+    // auto_vacuum only takes effect before the first table is created in a fresh file.
+    return exec_sql(conn, "PRAGMA archive.auto_vacuum = INCREMENTAL;") &&
+           exec_sql(conn, order_schema::create_orders_table_sql("archive")) &&
+           exec_sql(conn, order_schema::create_orders_indexes_sql("archive"));
+}
+
+void archiver_loop(order_archive::Options options) {
+    sqlite3* conn = nullptr;
+    if (sqlite3_open(options.db_path.c_str(), &conn) != SQLITE_OK) {
+        spdlog::error("Archiver can't open DB: {}", sqlite3_errmsg(conn));
+        sqlite3_close(conn);
+        return;
+    }
+    sql_stats::watch(conn, "archiver", kBusyTimeoutMs);
+    if (!attach_archive(conn, options.archive_path)) {
+        sql_stats::unwatch(conn);
+        sqlite3_close(conn);
+        return;
+    }
+
+    spdlog::info(
+        "Order archiver started: moving PAID orders older than {}s to {} every {}s",
+        options.archive_after_seconds,
+        options.archive_path,
+        runtime_config::archive_interval_seconds.load(memory_order_relaxed));
+
+    do {
+        const int64_t cutoff = static_cast<int64_t>(time(nullptr)) - options.archive_after_seconds;
+        int moved_this_run = 0;
+        int moved = 0;
+        while ((moved = archive_batch(conn, cutoff, runtime_config::archive_batch_size.load(memory_order_relaxed))) > 0) {
+            moved_this_run += moved;
+            orders_archived.fetch_add(moved, memory_order_relaxed);
+            // Yield between batches so foreground writers can take the lock.
+            if (wait_for_stop(chrono::milliseconds(10))) {
+                break;
+            }
+        }
+        archive_runs.fetch_add(1, memory_order_relaxed);
+        if (moved_this_run > 0) {
+            spdlog::info("Archived {} PAID orders older than {}", moved_this_run, cutoff);
+        }
+
+        run_maintenance(conn, options.vacuum_pages_per_slice);
+        update_tier_metrics(conn, cutoff);
+    } while (!wait_for_stop(chrono::seconds(runtime_config::archive_interval_seconds.load(memory_order_relaxed))));
+
+    sql_stats::unwatch(conn);
+    sqlite3_close(conn);
+    spdlog::info("Order archiver stopped");
+}
+}
+
+namespace order_archive {
+bool attach(sqlite3* db, const std::string& archive_path) {
+    if (!attach_archive(db, archive_path)) {
+        return false;
+    }
+    archive_attached.store(true, memory_order_relaxed);
+    return true;
+}
+
+bool is_attached() {
+    return archive_attached.load(memory_order_relaxed);
+}
+
+void start(const Options& options) {
+    {
+        lock_guard<mutex> lock(archiver_mutex);
+        archiver_stopping = false;
+    }
+    archiver_thread = thread(archiver_loop, options);
+}
+
+void stop() {
+    {
+        lock_guard<mutex> lock(archiver_mutex);
+        archiver_stopping = true;
+    }
+    archiver_cv.notify_all();
+    if (archiver_thread.joinable()) {
+        archiver_thread.join();
+    }
+}
+}
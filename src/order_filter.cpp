@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+#include <spdlog/spdlog.h>
+
+#include "counting_bloom_filter.h"
+#include "metrics.h"
+#include "order_archive.h"
+#include "order_filter.h"
+
+using namespace std;
+using namespace metrics;
+
+namespace {
+// Installed once, by build() before the server starts or by restore()/build() while a hot
+// restart awaits the predecessor's filter; never replaced afterwards.
+unique_ptr<CountingBloomFilter> owned_filter;
+atomic<CountingBloomFilter*> filter{nullptr};
+
+// Creates (true) and deletes (false) served while awaiting a handed-over filter.
+mutex pending_mutex;
+bool awaiting_handoff = false;
+vector<pair<bool, string>> pending;
+
+// Applies the journal to `installed` and publishes it. With replay_removes false only the
+// creates are applied: a filter built by scanning the tables may have missed an order that
+// was deleted during the scan, and removing it would decrement counters other keys share.
+void install(unique_ptr<CountingBloomFilter> installed, bool replay_removes) {
+    lock_guard<mutex> lock(pending_mutex);
+    if (filter.load(memory_order_acquire) != nullptr) {
+        return; // readers may hold the installed one
+    }
+    for (const auto& [added, order_no] : pending) {
+        if (added) {
+            installed->add(order_no);
+            order_filter_items.fetch_add(1, memory_order_relaxed);
+        } else if (replay_removes) {
+            installed->remove(order_no);
+            order_filter_items.fetch_sub(1, memory_order_relaxed);
+        }
+    }
+    pending.clear();
+    awaiting_handoff = false;
+    owned_filter = move(installed);
+    filter.store(owned_filter.get(), memory_order_release);
+}
+
+// True when the change was journaled because no filter is installed yet.
+bool journal(bool added, const string& order_no) {
+    lock_guard<mutex> lock(pending_mutex);
+    if (!awaiting_handoff || filter.load(memory_order_acquire) != nullptr) {
+        return false;
+    }
+    pending.emplace_back(added, order_no);
+    return true;
+}
+
+int64_t count_orders(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    const int64_t count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    return count;
+}
+}
+
+namespace order_filter {
+bool build(sqlite3* db, const Options& options) {
+    const auto start = chrono::steady_clock::now();
+    const bool with_archive = order_archive::is_attached();
+    const int64_t rows = count_orders(
+        db,
+        with_archive ? "SELECT (SELECT COUNT(*) FROM main.orders) + (SELECT COUNT(*) FROM archive.orders);"
+                     : "SELECT COUNT(*) FROM main.orders;");
+    if (rows < 0) {
+        spdlog::error("Order filter count failed: {}", sqlite3_errmsg(db));
+        return false;
+    }
+
+    const int64_t capacity = max(options.min_capacity, rows * 2);
+    auto built = make_unique<CountingBloomFilter>(static_cast<uint64_t>(capacity), options.false_positive_rate);
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = with_archive ? "SELECT order_no FROM main.orders UNION ALL SELECT order_no FROM archive.orders;"
+                                   : "SELECT order_no FROM main.orders;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        spdlog::error("Order filter prepare failed: {}", sqlite3_errmsg(db));
+        return false;
+    }
+    int64_t loaded = 0;
+    int rc = SQLITE_ROW;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const auto* order_no = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        built->add(string_view(order_no, static_cast<size_t>(sqlite3_column_bytes(stmt, 0))));
+        ++loaded;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        spdlog::error("Order filter scan failed: {}", sqlite3_errmsg(db));
+        return false;
+    }
+
+    order_filter_items.store(loaded, memory_order_relaxed);
+    order_filter_capacity.store(capacity, memory_order_relaxed);
+    spdlog::info(
+        "Order filter built: {} orders, capacity {}, {} counters x {} hashes ({} ms)",
+        loaded,
+        capacity,
+        built->size(),
+        built->hash_count(),
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+    install(move(built), false);
+    return true;
+}
+
+void await_handoff() {
+    lock_guard<mutex> lock(pending_mutex);
+    awaiting_handoff = filter.load(memory_order_acquire) == nullptr;
+}
+
+optional<State> state() {
+    const auto* current = filter.load(memory_order_acquire);
+    if (current == nullptr) {
+        return nullopt;
+    }
+    State state;
+    state.hash_count = current->hash_count();
+    state.counters = current->counters();
+    state.items = order_filter_items.load(memory_order_relaxed);
+    state.capacity = order_filter_capacity.load(memory_order_relaxed);
+    return state;
+}
+
+bool restore(const State& state) {
+    auto restored = CountingBloomFilter::from_counters(state.hash_count, state.counters);
+    if (restored == nullptr || filter.load(memory_order_acquire) != nullptr) {
+        return false;
+    }
+    order_filter_items.store(state.items, memory_order_relaxed);
+    order_filter_capacity.store(state.capacity, memory_order_relaxed);
+    spdlog::info("Order filter restored: {} orders, capacity {}, {} counters x {} hashes",
+                 state.items, state.capacity, restored->size(), restored->hash_count());
+    install(move(restored), true);
+    return true;
+}
+
+bool enabled() {
+    return filter.load(memory_order_acquire) != nullptr;
+}
+
+bool might_contain(const string& order_no) {
+    const auto* current = filter.load(memory_order_acquire);
+    return current == nullptr || current->might_contain(order_no);
+}
+
+void add(const string& order_no) {
+    auto* current = filter.load(memory_order_acquire);
+    if (current == nullptr) {
+        if (journal(true, order_no)) {
+            return;
+        }
+        current = filter.load(memory_order_acquire);
+    }
+    if (current != nullptr) {
+        current->add(order_no);
+        order_filter_items.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void remove(const string& order_no) {
+    auto* current = filter.load(memory_order_acquire);
+    if (current == nullptr) {
+        if (journal(false, order_no)) {
+            return;
+        }
+        current = filter.load(memory_order_acquire);
+    }
+    if (current != nullptr) {
+        current->remove(order_no);
+        order_filter_items.fetch_sub(1, memory_order_relaxed);
+    }
+}
+}
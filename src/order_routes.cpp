@@ -1,35 +1,82 @@
 #include <string>
-#include <sstream>
 #include <chrono>
 #include <utility>
 #include <optional>
 #include <ctime>
+#include <memory>
 
 #include <sqlite3.h>
-#include <sw/redis++/redis++.h>
+#include <zlib.h>
 #include <spdlog/spdlog.h>
 
+#include "alloc_stats.h"
+#include "async_response.h"
+#include "cache_policy.h"
+#include "flight_recorder.h"
 #include "helpers.hpp"
 #include "metrics.h"
+#include "order_app.h"
+#include "order_archive.h"
+#include "order_cache.h"
+#include "order_filter.h"
 #include "order_routes.h"
+#include "order_utils.h"
+#include "request_deadline.h"
+#include "request_trace.h"
 #include "runtime_config.h"
 #include "service_state.h"
+#include "sql_stats.h"
+#include "storage_executors.h"
 
 extern sqlite3* db;
-extern sw::redis::Redis* redis;
+extern order_cache::Backend* cache;
 
 using namespace std;
 using namespace metrics;
 using namespace service_state;
 
-std::string format_time(time_t t);
-std::string generate_order_no();
-crow::response json_error(int code, const std::string& message);
 bool is_valid_amount(const crow::json::rvalue& val);
 bool is_valid_order_no(const crow::json::rvalue& val);
 
 namespace {
+// Every statement the routes run, exported under its label on /metrics.
+namespace statements {
+sql_stats::Statement select_order(
+    "select_order", "SELECT amount, status, created_at, paid_at FROM main.orders WHERE order_no = ?;");
+sql_stats::Statement select_archived_order(
+    "select_archived_order", "SELECT amount, status, created_at, paid_at FROM archive.orders WHERE order_no = ?;");
+// Archived orders are always PAID, so the archive lookup only ever feeds the "Already paid" check.
+sql_stats::Statement select_order_to_pay(
+    "select_order_to_pay", "SELECT amount, status, created_at FROM main.orders WHERE order_no = ?;");
+sql_stats::Statement select_archived_order_to_pay(
+    "select_archived_order_to_pay", "SELECT amount, status, created_at FROM archive.orders WHERE order_no = ?;");
+sql_stats::Statement insert_order(
+    "insert_order", "INSERT INTO orders (order_no, amount, status, created_at, paid_at) VALUES (?, ?, ?, ?, ?);");
+sql_stats::Statement mark_order_paid(
+    "mark_order_paid", "UPDATE orders SET status = 'PAID', paid_at = ? WHERE order_no = ?;");
+sql_stats::Statement list_orders(
+    "list_orders", "SELECT order_no, amount, status, created_at, paid_at FROM orders;");
+sql_stats::Statement list_orders_by_status(
+    "list_orders_by_status", "SELECT order_no, amount, status, created_at, paid_at FROM orders WHERE status = ?;");
+sql_stats::Statement delete_order("delete_order", "DELETE FROM main.orders WHERE order_no = ?;");
+sql_stats::Statement delete_archived_order("delete_archived_order", "DELETE FROM archive.orders WHERE order_no = ?;");
+// Exports read one slice at a time, each starting after the last (created_at, order_no) the
+// previous slice returned.
+sql_stats::Statement export_orders(
+    "export_orders",
+    "SELECT order_no, amount, status, created_at, paid_at FROM main.orders "
+    "WHERE (created_at, order_no) > (?1, ?2) ORDER BY created_at, order_no LIMIT ?3;");
+sql_stats::Statement export_archived_orders(
+    "export_archived_orders",
+    "SELECT order_no, amount, status, created_at, paid_at FROM archive.orders "
+    "WHERE (created_at, order_no) > (?1, ?2) ORDER BY created_at, order_no LIMIT ?3;");
+}
+
 void record_sqlite_failure(const string& message) {
+    if (request_deadline::interrupted()) {
+        // Aborted for its deadline, not failed; run_stage counts it.
+        return;
+    }
     sqlite_errors.fetch_add(1, memory_order_relaxed);
     spdlog::error("{}", message);
 }
@@ -40,115 +87,490 @@ void record_redis_failure(const string& message) {
     spdlog::warn("{}", message);
 }
 
+// True when the filter proves the order doesn't exist, so the lookup can stop here.
+bool filtered_out(const string& order_no) {
+    if (order_filter::might_contain(order_no)) {
+        return false;
+    }
+    order_filter_short_circuits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
 void record_redis_success() {
     redis_available.store(true, memory_order_relaxed);
 }
 
-bool try_cache_order(const string& order_no, const string& payload) {
-    if (redis == nullptr) {
+// Responds with an order that is already serialised, e.g. straight from the cache.
+crow::response json_body(string payload) {
+    crow::response res(move(payload));
+    res.set_header("Content-Type", "application/json");
+    return res;
+}
+
+// Writes the order's current representation with its status' version and TTL. A write
+// racing a newer one (e.g. a PENDING read-fill landing after the PAID write-through) loses.
+// Legacy values carry no version, so they are written unconditionally, and a delete drops the
+// entry because older instances can't read a tombstone.
+bool try_cache_order(const string& order_no, cache_policy::Policy policy, const string& payload) {
+    if (cache == nullptr) {
         redis_errors.fetch_add(1, memory_order_relaxed);
         redis_available.store(false, memory_order_relaxed);
         spdlog::warn("Redis client not initialized. Skipping cache set for {}", order_no);
         return false;
     }
 
+    const auto index = static_cast<size_t>(policy);
+    const auto ttl = cache_policy::ttl(policy);
+    request_trace::Timer cache_time(request_trace::Stage::Cache);
     try {
-        redis->set(
-            "order:" + order_no,
-            payload,
-            chrono::seconds(runtime_config::cache_ttl_seconds.load(memory_order_relaxed)));
+        const string key = order_cache::order_key(order_no);
+        bool stored = true;
+        if (!runtime_config::cache_legacy_values.load(memory_order_relaxed)) {
+            stored = cache->set_if_newer(key, cache_policy::encode(policy, payload), cache_policy::version(policy), ttl);
+        } else if (policy == cache_policy::Policy::Tombstone) {
+            cache->del(key);
+        } else {
+            cache->set(key, cache_policy::encode(policy, payload), ttl);
+        }
         record_redis_success();
-        spdlog::info(
-            "Cached order {} in Redis (TTL: {}s)",
-            order_no,
-            runtime_config::cache_ttl_seconds.load(memory_order_relaxed));
+        if (!stored) {
+            cache_policy_stale_writes[index].fetch_add(1, memory_order_relaxed);
+            spdlog::info("Skipped stale {} cache write for order {}", cache_policy::name(policy), order_no);
+            return false;
+        }
+        cache_policy_writes[index].fetch_add(1, memory_order_relaxed);
+        spdlog::info("Cached {} order {} in Redis (TTL: {}s)", cache_policy::name(policy), order_no, ttl.count());
         return true;
-    } catch (const sw::redis::Error& err) {
+    } catch (const order_cache::Unavailable&) {
+        if (policy == cache_policy::Policy::Tombstone) {
+            spdlog::warn("Redis circuit open, cache entry for {} left to expire", order_no);
+        }
+        return false;
+    } catch (const exception& err) {
         record_redis_failure("Redis SET failed: " + string(err.what()));
         return false;
     }
 }
 
-optional<string> try_get_cached_order(const string& order_no) {
-    if (redis == nullptr) {
+optional<cache_policy::Decoded> try_get_cached_order(const string& order_no) {
+    if (cache == nullptr) {
         redis_errors.fetch_add(1, memory_order_relaxed);
         redis_available.store(false, memory_order_relaxed);
         return nullopt;
     }
 
+    request_trace::Timer cache_time(request_trace::Stage::Cache);
     try {
-        auto val = redis->get("order:" + order_no);
+        auto val = cache->get(order_cache::order_key(order_no));
         record_redis_success();
         if (val) {
-            cache_hits.fetch_add(1, memory_order_relaxed);
-            spdlog::info("Redis cache hit for order: {}", order_no);
-            return *val;
+            if (auto decoded = cache_policy::decode(*val)) {
+                flight_recorder::record(flight_recorder::Type::CacheHit);
+                cache_hits.fetch_add(1, memory_order_relaxed);
+                cache_policy_hits[static_cast<size_t>(decoded->policy)].fetch_add(1, memory_order_relaxed);
+                spdlog::info("Redis cache hit for order: {}", order_no);
+                return decoded;
+            }
         }
 
+        flight_recorder::record(flight_recorder::Type::CacheMiss);
         cache_misses.fetch_add(1, memory_order_relaxed);
         spdlog::info("Redis cache miss for order: {}", order_no);
         return nullopt;
-    } catch (const sw::redis::Error& err) {
+    } catch (const order_cache::Unavailable&) {
+        return nullopt;
+    } catch (const exception& err) {
         cache_misses.fetch_add(1, memory_order_relaxed);
         record_redis_failure("Redis GET failed: " + string(err.what()));
         return nullopt;
     }
 }
 
-void invalidate_cached_order(const string& order_no, const char* action) {
-    if (redis == nullptr) {
-        redis_errors.fetch_add(1, memory_order_relaxed);
-        redis_available.store(false, memory_order_relaxed);
-        spdlog::warn("Redis client not initialized. Skipping cache invalidation for {}", order_no);
-        return;
+// Steps a single-row statement, timed into the flight recorder as well.
+int recorded_step(sql_stats::Query& query) {
+    const uint64_t start = flight_recorder::ticks();
+    const int rc = query.step();
+    flight_recorder::record_since(flight_recorder::Type::SqliteStep, start);
+    return rc;
+}
+
+// Looks an order up in the hot table and falls through to the archive on a miss.
+// On SQLITE_ROW `query` is positioned on the row; SQLITE_DONE means neither tier has the
+// order, SQLITE_ERROR means a prepare failed and SQLITE_INTERRUPT means the request's
+// deadline passed mid-statement.
+int step_order_lookup(sql_stats::Statement& hot, sql_stats::Statement& archive, const string& order_no,
+                      optional<sql_stats::Query>& query) {
+    request_trace::Timer db_time(request_trace::Stage::Db);
+    for (sql_stats::Statement* statement : {&hot, &archive}) {
+        if (statement == &archive && !order_archive::is_attached()) {
+            break;
+        }
+        query.emplace(db, *statement);
+        if (!query->ok()) {
+            record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
+            query.reset();
+            return SQLITE_ERROR;
+        }
+        sqlite3_bind_text(query->get(), 1, order_no.c_str(), -1, SQLITE_STATIC);
+        const int rc = recorded_step(*query);
+        if (rc == SQLITE_ROW) {
+            if (statement == &archive) {
+                archive_hits.fetch_add(1, memory_order_relaxed);
+            }
+            return SQLITE_ROW;
+        }
+        query.reset();
+        if (rc == SQLITE_INTERRUPT) {
+            return SQLITE_INTERRUPT;
+        }
     }
+    return SQLITE_DONE;
+}
 
-    try {
-        redis->del("order:" + order_no);
-        record_redis_success();
-        spdlog::info("{} {}", action, order_no);
-    } catch (const sw::redis::Error& err) {
-        record_redis_failure("Redis DEL failed: " + string(err.what()));
+constexpr size_t kExportChunkBytes = 64 * 1024;
+constexpr int kExportSliceRows = 512;
+// How long an export slice waits for a writer's COMMIT to finish; it runs on an I/O thread.
+constexpr int kExportBusyTimeoutMs = 1000;
+
+string csv_escape(const string& value) {
+    if (value.find_first_of(",\"\r\n") == string::npos) {
+        return value;
+    }
+    string escaped = "\"";
+    for (const char c : value) {
+        if (c == '"') {
+            escaped += '"';
+        }
+        escaped += c;
     }
+    escaped += '"';
+    return escaped;
 }
+
+// Walks the orders table a slice of kExportSliceRows at a time on its own read-only connection
+// and hands out one chunk at a time, so memory stays bounded by the chunk size no matter how
+// many rows are exported. With a rollback journal an open read blocks every writer's COMMIT,
+// so each slice is finalized, releasing its lock, before the chunk goes out: a slow client
+// holds no lock while it reads. The export stops at its deadline.
+class OrderExportCursor {
+public:
+    OrderExportCursor(
+        sqlite3* conn,
+        sql_stats::Statement& statement,
+        int64_t since,
+        bool csv,
+        bool gzip,
+        request_deadline::Deadline deadline)
+        : conn_(conn),
+          statement_(statement),
+          last_created_at_(since),
+          csv_(csv),
+          gzip_(gzip),
+          deadline_(deadline),
+          start_time_(chrono::steady_clock::now()) {
+        if (gzip_) {
+            // windowBits 15 + 16 asks zlib for a gzip header/trailer instead of raw deflate
+            gzip_ = deflateInit2(&zs_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+    }
+
+    ~OrderExportCursor() {
+        sqlite3_close(conn_);
+        if (gzip_) {
+            deflateEnd(&zs_);
+        }
+
+        const auto elapsed_ms = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - start_time_).count();
+        const int64_t rows_per_second = elapsed_ms == 0 ? rows_ * 1000 : rows_ * 1000 / elapsed_ms;
+        export_rows_total.fetch_add(rows_, memory_order_relaxed);
+        export_last_rows_per_second.store(rows_per_second, memory_order_relaxed);
+        if (finished_) {
+            exports_completed.fetch_add(1, memory_order_relaxed);
+            spdlog::info("Order export finished: {} rows in {} ms ({} rows/s)", rows_, elapsed_ms, rows_per_second);
+        } else {
+            exports_aborted.fetch_add(1, memory_order_relaxed);
+            spdlog::warn("Order export aborted after {} rows in {} ms ({} rows/s)", rows_, elapsed_ms, rows_per_second);
+        }
+    }
+
+    OrderExportCursor(const OrderExportCursor&) = delete;
+    OrderExportCursor& operator=(const OrderExportCursor&) = delete;
+
+    bool gzip() const {
+        return gzip_;
+    }
+
+    bool next_chunk(string& out) {
+        string plain;
+        plain.reserve(kExportChunkBytes + 256);
+        if (csv_ && !header_written_) {
+            plain += "order_no,amount,status,created_at,paid_at\n";
+            header_written_ = true;
+        }
+
+        bool more = true;
+        while (more && plain.size() < kExportChunkBytes) {
+            // The status line is already on the wire, so the only way to signal failure, or the
+            // deadline, is a truncated body.
+            if (deadline_.expired()) {
+                request_deadline_exceeded[static_cast<size_t>(request_deadline::Stage::Sqlite)].fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+            const int rows = read_slice(plain);
+            if (rows < 0) {
+                return false;
+            }
+            more = rows == kExportSliceRows;
+        }
+
+        if (!gzip_) {
+            out.swap(plain);
+        } else {
+            deflate_into(plain, more ? Z_NO_FLUSH : Z_FINISH, out);
+        }
+        finished_ = !more;
+        return more;
+    }
+
+private:
+    // Appends the next slice and finalizes its statement. Returns the rows read, or -1 on failure.
+    int read_slice(string& out) {
+        sql_stats::Query query(conn_, statement_);
+        if (!query.ok()) {
+            record_sqlite_failure("SQLite export prepare failed: " + string(sqlite3_errmsg(conn_)));
+            return -1;
+        }
+        sqlite3_bind_int64(query.get(), 1, last_created_at_);
+        sqlite3_bind_text(query.get(), 2, last_order_no_.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(query.get(), 3, kExportSliceRows);
+
+        int rows = 0;
+        int rc = query.step();
+        while (rc == SQLITE_ROW) {
+            append_row(query.get(), out);
+            ++rows;
+            rc = query.step();
+        }
+        if (rc != SQLITE_DONE) {
+            record_sqlite_failure("SQLite export step failed: " + string(sqlite3_errmsg(conn_)));
+            return -1;
+        }
+        rows_ += rows;
+        return rows;
+    }
+
+    void append_row(sqlite3_stmt* stmt, string& out) {
+        const string order_no = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const double amount = sqlite3_column_double(stmt, 1);
+        const string status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        const time_t created_at = sqlite3_column_int64(stmt, 3);
+        const time_t paid_at = sqlite3_column_int64(stmt, 4);
+        last_created_at_ = created_at;
+        last_order_no_ = order_no;
+
+        if (csv_) {
+            out += csv_escape(order_no);
+            out += ',';
+            out += crow::json::wvalue(amount).dump();
+            out += ',';
+            out += csv_escape(status);
+            out += ',';
+            out += format_time(created_at);
+            out += ',';
+            if (paid_at != 0) {
+                out += format_time(paid_at);
+            }
+            out += '\n';
+            return;
+        }
+
+        crow::json::wvalue order;
+        order["order_no"] = order_no;
+        order["amount"] = amount;
+        order["status"] = status;
+        order["created_at"] = format_time(created_at);
+        order["paid_at"] = paid_at == 0 ? crow::json::wvalue() : format_time(paid_at);
+        out += order.dump();
+        out += '\n';
+    }
+
+    void deflate_into(const string& input, int flush, string& out) {
+        zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        zs_.avail_in = static_cast<uInt>(input.size());
+        char buffer[16384];
+        do {
+            zs_.next_out = reinterpret_cast<Bytef*>(buffer);
+            zs_.avail_out = sizeof(buffer);
+            deflate(&zs_, flush);
+            out.append(buffer, sizeof(buffer) - zs_.avail_out);
+        } while (zs_.avail_out == 0);
+    }
+
+    sqlite3* conn_;
+    sql_stats::Statement& statement_;
+    // Key of the last row handed out. Order numbers are never empty, so ("since", "") starts
+    // the first slice at the first row created at or after "since".
+    int64_t last_created_at_;
+    string last_order_no_;
+    bool csv_;
+    bool gzip_;
+    request_deadline::Deadline deadline_;
+    z_stream zs_{};
+    bool header_written_ = false;
+    bool finished_ = false;
+    int64_t rows_ = 0;
+    chrono::steady_clock::time_point start_time_;
+};
+
 }
 
-crow::response create_order(const crow::request& req) {
-    auto body = crow::json::load(req.body);
-    if (!body) {
-        return json_error(400, "Invalid JSON format");
+crow::response storage_busy(const BoundedExecutor& executor) {
+    spdlog::warn("{} executor queue is full, shedding request", executor.name());
+    crow::response res = json_error(503, "Server busy");
+    res.set_header("Retry-After", "1");
+    return res;
+}
+
+namespace {
+
+crow::response deadline_exceeded(request_deadline::Stage stage) {
+    request_deadline_exceeded[static_cast<size_t>(stage)].fetch_add(1, memory_order_relaxed);
+    flight_recorder::record(flight_recorder::Type::DeadlineExceeded, static_cast<uint32_t>(stage));
+    return json_error(504, "Deadline exceeded");
+}
+
+// The route's default budget, shortened by the client's X-Request-Timeout-Ms if it asks for
+// less. A budget of 0 means no deadline.
+request_deadline::Deadline deadline_for(const crow::request& req, int default_ms) {
+    int budget_ms = default_ms;
+    const string& header = req.get_header_value("X-Request-Timeout-Ms");
+    if (!header.empty()) {
+        try {
+            const int requested_ms = stoi(header);
+            if (requested_ms > 0) {
+                budget_ms = budget_ms > 0 ? min(budget_ms, requested_ms) : requested_ms;
+            }
+        } catch (const exception&) {
+            spdlog::warn("Ignoring malformed X-Request-Timeout-Ms: {}", header);
+        }
     }
-    if (!body.has("amount") || !is_valid_amount(body["amount"])) {
-        return json_error(400, "Missing amount");
+    if (budget_ms <= 0) {
+        return {};
     }
-    if (body["amount"].t() != crow::json::type::Number) {
-        return json_error(400, "Amount must be a number");
+    return request_deadline::Deadline::after(chrono::milliseconds(budget_ms));
+}
+
+// Runs one stage of a request on `executor`. A stage either returns the response or passes
+// the request on to another stage, which then owns completing it, and returns nullopt. A
+// request whose deadline passed while it was queued is dropped without running the stage,
+// and SQLite statements inside the stage are aborted once it passes.
+template<typename Stage>
+void run_stage(
+    BoundedExecutor& executor,
+    const crow::request& req,
+    crow::response& res,
+    const request_deadline::Deadline& deadline,
+    Stage stage) {
+    request_trace::Trace* trace = request_trace_of(req);
+    alloc_stats::Account* allocations = alloc_account_of(req);
+    const auto queued_at = request_trace::Clock::now();
+    const bool queued = executor.submit([&executor, &req, &res, deadline, stage, trace, allocations, queued_at]() mutable {
+        request_trace::Scope trace_scope(trace);
+        if (trace != nullptr) {
+            trace->add(request_trace::Stage::Queue, queued_at);
+        }
+        if (deadline.expired()) {
+            complete_response(req, res, deadline_exceeded(request_deadline::Stage::Queue));
+            return;
+        }
+        optional<crow::response> result;
+        try {
+            request_deadline::Scope scope(deadline);
+            // Ends before complete_response hands the request back to the I/O thread.
+            alloc_stats::Scope alloc_scope(allocations);
+            result = stage();
+            if (request_deadline::interrupted()) {
+                result = deadline_exceeded(request_deadline::Stage::Sqlite);
+            }
+        } catch (const exception& err) {
+            spdlog::error("Unhandled error on the {} executor: {}", executor.name(), err.what());
+            result = json_error(500, "Internal server error");
+        }
+        if (result) {
+            complete_response(req, res, move(*result));
+        }
+    });
+    if (!queued) {
+        flight_recorder::record(flight_recorder::Type::ShedQueueFull, 503, trace != nullptr ? trace->id() : 0);
+        complete_response(req, res, storage_busy(executor));
     }
+}
 
-    const double amount = body["amount"].d();
+void cache_in_background(const string& order_no, cache_policy::Policy policy, string payload) {
+    storage_executors::redis().submit([order_no, policy, payload = move(payload)] {
+        try_cache_order(order_no, policy, payload);
+    });
+}
+
+// Writes the new state through on the Redis pool and only then responds, so the client's
+// next read can't see the old entry. With the Redis queue full the write is skipped like any
+// other cache failure and the response goes out right away.
+optional<crow::response> cache_then_respond(
+    const crow::request& req,
+    crow::response& res,
+    const string& order_no,
+    cache_policy::Policy policy,
+    string payload,
+    crow::response response) {
+    auto pending = make_shared<crow::response>(move(response));
+    request_trace::Trace* trace = request_trace::current();
+    alloc_stats::Account* allocations = alloc_stats::current();
+    const auto queued_at = request_trace::Clock::now();
+    const bool queued = storage_executors::redis().submit([&req, &res, order_no, policy, payload = move(payload), pending, trace, allocations, queued_at] {
+        if (trace != nullptr) {
+            trace->add(request_trace::Stage::Queue, queued_at);
+        }
+        {
+            request_trace::Scope trace_scope(trace);
+            alloc_stats::Scope alloc_scope(allocations);
+            try_cache_order(order_no, policy, payload);
+        }
+        complete_response(req, res, move(*pending));
+    });
+    if (queued) {
+        return nullopt;
+    }
+    spdlog::warn("Redis executor queue is full, cache write for {} skipped", order_no);
+    return move(*pending);
+}
+
+crow::response insert_order(double amount) {
     const string order_no = generate_order_no();
     const time_t now = time(nullptr);
 
-    sqlite3_stmt* stmt = nullptr;
-    const char* sql = "INSERT INTO orders (order_no, amount, status, created_at, paid_at) VALUES (?, ?, ?, ?, ?);";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    request_trace::Timer db_time(request_trace::Stage::Db);
+    sql_stats::Query query(db, statements::insert_order);
+    if (!query.ok()) {
         record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
         return json_error(500, "Internal DB error");
     }
 
+    sqlite3_stmt* stmt = query.get();
     sqlite3_bind_text(stmt, 1, order_no.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_double(stmt, 2, amount);
     sqlite3_bind_text(stmt, 3, "PENDING", -1, SQLITE_STATIC);
     sqlite3_bind_int64(stmt, 4, now);
     sqlite3_bind_int64(stmt, 5, 0);
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+    if (recorded_step(query) != SQLITE_DONE) {
         record_sqlite_failure("SQLite insert failed: " + string(sqlite3_errmsg(db)));
-        sqlite3_finalize(stmt);
         return json_error(500, "Database error while creating order");
     }
-    sqlite3_finalize(stmt);
+    query.finalize();
+    db_time.finish();
     orders_created.fetch_add(1, memory_order_relaxed);
+    order_filter::add(order_no);
 
     crow::json::wvalue res;
     res["order_no"] = order_no;
@@ -156,131 +578,127 @@ crow::response create_order(const crow::request& req) {
     res["status"] = "PENDING";
     res["created_at"] = format_time(now);
 
-    ostringstream oss;
-    oss << res.dump();
-    try_cache_order(order_no, oss.str());
+    // Nothing can be cached for a brand-new order yet, so there is no stale entry to beat.
+    cache_in_background(order_no, cache_policy::Policy::Pending, order_cache_payload(order_no, amount, "PENDING", now, 0));
 
+    request_trace::Timer serialize(request_trace::Stage::Serialize);
     return crow::response(res);
 }
 
-crow::response get_order(const std::string& order_no) {
-    if (auto cached = try_get_cached_order(order_no)) {
-        return crow::response(*cached);
-    }
+crow::response order_response(const string& order_no, double amount, const string& status, time_t created_at, time_t paid_at) {
+    request_trace::Timer serialize(request_trace::Stage::Serialize);
+    return crow::response(order_json(order_no, amount, status, created_at, paid_at));
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    const char* sql = "SELECT amount, status, created_at, paid_at FROM orders WHERE order_no = ?;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
+crow::response load_order(const string& order_no) {
+    optional<sql_stats::Query> query;
+    const int rc = step_order_lookup(statements::select_order, statements::select_archived_order, order_no, query);
+    if (rc == SQLITE_ERROR || rc == SQLITE_INTERRUPT) {
         return json_error(500, "Internal DB error");
     }
-    sqlite3_bind_text(stmt, 1, order_no.c_str(), -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
+    if (rc != SQLITE_ROW) {
+        if (order_filter::enabled()) {
+            order_filter_false_positives.fetch_add(1, memory_order_relaxed);
+        }
         return json_error(404, "Order not found");
     }
 
+    sqlite3_stmt* stmt = query->get();
     const double amount = sqlite3_column_double(stmt, 0);
     const string status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
     const time_t created_at = sqlite3_column_int64(stmt, 2);
     const time_t paid_at = sqlite3_column_int64(stmt, 3);
-    sqlite3_finalize(stmt);
+    query.reset();
 
-    crow::json::wvalue res;
-    res["order_no"] = order_no;
-    res["amount"] = amount;
-    res["status"] = status;
-    res["created_at"] = format_time(created_at);
-    res["paid_at"] = paid_at == 0 ? crow::json::wvalue() : format_time(paid_at);
-    return crow::response(res);
+    const auto policy = cache_policy::for_status(status);
+    if (cache != nullptr) {
+        cache_policy_misses[static_cast<size_t>(policy)].fetch_add(1, memory_order_relaxed);
+        cache_in_background(order_no, policy, order_cache_payload(order_no, amount, status, created_at, paid_at));
+    }
+    return order_response(order_no, amount, status, created_at, paid_at);
 }
 
-crow::response pay_order(const crow::request& req) {
-    auto body = crow::json::load(req.body);
-    if (!body) {
-        return json_error(400, "Invalid JSON format");
+// The response for a cache hit, or nullopt when SQLite has to answer.
+optional<crow::response> cached_order_response(const string& order_no) {
+    if (request_deadline::current_expired()) {
+        return deadline_exceeded(request_deadline::Stage::Redis);
     }
-    if (!body.has("order_no") || !is_valid_order_no(body["order_no"])) {
-        return json_error(400, "Missing order_no");
-    }
-    if (body["order_no"].t() != crow::json::type::String) {
-        return json_error(400, "order_no must be a string");
+    if (auto cached = try_get_cached_order(order_no)) {
+        if (cached->policy == cache_policy::Policy::Tombstone) {
+            return json_error(404, "Order not found");
+        }
+        // An entry in a format this build can't read is treated as a miss and overwritten.
+        request_trace::Timer serialize(request_trace::Stage::Serialize);
+        if (auto body = render_cached_order(order_no, cached->payload)) {
+            return json_body(move(*body));
+        }
     }
+    return nullopt;
+}
 
-    const string order_no = body["order_no"].s();
-    sqlite3_stmt* stmt = nullptr;
-    const char* select_sql = "SELECT amount, status, created_at FROM orders WHERE order_no = ?;";
-    if (sqlite3_prepare_v2(db, select_sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
+optional<crow::response> mark_order_paid(const crow::request& req, crow::response& res, const string& order_no) {
+    optional<sql_stats::Query> query;
+    const int rc = step_order_lookup(statements::select_order_to_pay, statements::select_archived_order_to_pay, order_no, query);
+    if (rc == SQLITE_ERROR || rc == SQLITE_INTERRUPT) {
         return json_error(500, "Internal DB error");
     }
-    sqlite3_bind_text(stmt, 1, order_no.c_str(), -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
+    if (rc != SQLITE_ROW) {
         return json_error(404, "Order not found");
     }
 
+    sqlite3_stmt* stmt = query->get();
     const double amount = sqlite3_column_double(stmt, 0);
     const string status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
     const time_t created_at = sqlite3_column_int64(stmt, 2);
-    sqlite3_finalize(stmt);
+    query.reset();
 
     if (status == "PAID") {
         return json_error(400, "Already paid");
     }
 
     const time_t now = time(nullptr);
-    const char* update_sql = "UPDATE orders SET status = 'PAID', paid_at = ? WHERE order_no = ?;";
-    if (sqlite3_prepare_v2(db, update_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    request_trace::Timer db_time(request_trace::Stage::Db);
+    sql_stats::Query update(db, statements::mark_order_paid);
+    if (!update.ok()) {
         record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
         return json_error(500, "Internal DB error");
     }
-    sqlite3_bind_int64(stmt, 1, now);
-    sqlite3_bind_text(stmt, 2, order_no.c_str(), -1, SQLITE_STATIC);
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+    sqlite3_bind_int64(update.get(), 1, now);
+    sqlite3_bind_text(update.get(), 2, order_no.c_str(), -1, SQLITE_STATIC);
+    if (recorded_step(update) != SQLITE_DONE) {
         record_sqlite_failure("SQLite update failed for payment: " + string(sqlite3_errmsg(db)));
-        sqlite3_finalize(stmt);
         return json_error(500, "Failed to mark order as paid");
     }
-    sqlite3_finalize(stmt);
+    update.finalize();
+    db_time.finish();
     orders_paid.fetch_add(1, memory_order_relaxed);
 
-    invalidate_cached_order(order_no, "Deleted order from Redis cache:");
-
-    crow::json::wvalue res;
-    res["order_no"] = order_no;
-    res["status"] = "PAID";
-    res["amount"] = amount;
-    res["created_at"] = format_time(created_at);
-    res["paid_at"] = format_time(now);
-    return crow::response(res);
+    // Everything the next lookup needs is at hand, so write it through instead of invalidating.
+    return cache_then_respond(
+        req,
+        res,
+        order_no,
+        cache_policy::Policy::Paid,
+        order_cache_payload(order_no, amount, "PAID", created_at, now),
+        order_response(order_no, amount, "PAID", created_at, now));
 }
 
-crow::response list_orders(const crow::request& req) {
-    const string query = req.url_params.get("status") ? req.url_params.get("status") : "";
-    const char* sql_all = "SELECT order_no, amount, status, created_at, paid_at FROM orders;";
-    const char* sql_filtered = "SELECT order_no, amount, status, created_at, paid_at FROM orders WHERE status = ?;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (query.empty()) {
-        if (sqlite3_prepare_v2(db, sql_all, -1, &stmt, nullptr) != SQLITE_OK) {
-            record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
-            return json_error(500, "Internal DB error");
-        }
-    } else {
-        if (sqlite3_prepare_v2(db, sql_filtered, -1, &stmt, nullptr) != SQLITE_OK) {
-            record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
-            return json_error(500, "Internal DB error");
-        }
-        sqlite3_bind_text(stmt, 1, query.c_str(), -1, SQLITE_STATIC);
+crow::response query_orders(const string& status_filter) {
+    request_trace::Timer db_time(request_trace::Stage::Db);
+    sql_stats::Query query(db, status_filter.empty() ? statements::list_orders : statements::list_orders_by_status);
+    if (!query.ok()) {
+        record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
+        return json_error(500, "Internal DB error");
+    }
+    sqlite3_stmt* stmt = query.get();
+    if (!status_filter.empty()) {
+        sqlite3_bind_text(stmt, 1, status_filter.c_str(), -1, SQLITE_STATIC);
     }
 
     crow::json::wvalue result;
     auto& arr = result["orders"];
     int index = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    while (query.step() == SQLITE_ROW) {
         crow::json::wvalue order;
         order["order_no"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
         order["amount"] = sqlite3_column_double(stmt, 1);
@@ -291,35 +709,245 @@ crow::response list_orders(const crow::request& req) {
             : format_time(sqlite3_column_int64(stmt, 4));
         arr[index++] = move(order);
     }
-    sqlite3_finalize(stmt);
+    query.finalize();
+    db_time.finish();
 
+    request_trace::Timer serialize(request_trace::Stage::Serialize);
     return crow::response(result);
 }
 
-crow::response delete_order(const std::string& order_no) {
-    sqlite3_stmt* stmt = nullptr;
-    const char* sql = "DELETE FROM orders WHERE order_no = ?;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
-        return json_error(500, "Internal DB error");
+optional<crow::response> remove_order(const crow::request& req, crow::response& res, const string& order_no) {
+    int deleted_rows = 0;
+    request_trace::Timer db_time(request_trace::Stage::Db);
+    for (sql_stats::Statement* statement : {&statements::delete_order, &statements::delete_archived_order}) {
+        if (deleted_rows > 0 || (statement == &statements::delete_archived_order && !order_archive::is_attached())) {
+            break;
+        }
+        sql_stats::Query query(db, *statement);
+        if (!query.ok()) {
+            record_sqlite_failure("Prepare failed: " + string(sqlite3_errmsg(db)));
+            return json_error(500, "Internal DB error");
+        }
+        sqlite3_bind_text(query.get(), 1, order_no.c_str(), -1, SQLITE_STATIC);
+
+        if (recorded_step(query) != SQLITE_DONE) {
+            return json_error(404, "Order not found or could not delete");
+        }
+
+        deleted_rows = sqlite3_changes(db);
     }
-    sqlite3_bind_text(stmt, 1, order_no.c_str(), -1, SQLITE_STATIC);
+    db_time.finish();
+    if (deleted_rows == 0) {
+        return json_error(404, "Order not found");
+    }
+    order_filter::remove(order_no);
+
+    crow::json::wvalue body;
+    body["deleted"] = true;
+    body["order_no"] = order_no;
+    // A tombstone rather than DEL: it outranks any in-flight write of the old order and lets
+    // lookups answer 404 without touching SQLite until it expires.
+    return cache_then_respond(req, res, order_no, cache_policy::Policy::Tombstone, "", crow::response(200, body));
+}
+
+crow::json::rvalue parse_body(const crow::request& req) {
+    request_trace::Timer parse(request_trace::Stage::Parse, request_trace_of(req));
+    return crow::json::load(req.body);
+}
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
-        return json_error(404, "Order not found or could not delete");
+void respond_now(crow::response& res, crow::response result) {
+    res = move(result);
+    res.end();
+}
+}
+
+void create_order(const crow::request& req, crow::response& res) {
+    auto body = parse_body(req);
+    if (!body) {
+        return respond_now(res, json_error(400, "Invalid JSON format"));
+    }
+    if (!body.has("amount") || !is_valid_amount(body["amount"])) {
+        return respond_now(res, json_error(400, "Missing amount"));
+    }
+    if (body["amount"].t() != crow::json::type::Number) {
+        return respond_now(res, json_error(400, "Amount must be a number"));
     }
 
-    const int deleted_rows = sqlite3_changes(db);
+    const double amount = body["amount"].d();
+    run_stage(storage_executors::sqlite(), req, res, deadline_for(req, runtime_config::request_timeout_ms), [amount] {
+        return optional<crow::response>(insert_order(amount));
+    });
+}
+
+#ifdef ORDER_SERVICE_COROUTINES
+route_coro::Response get_order(const crow::request& req, std::string order_no) {
+    if (filtered_out(order_no)) {
+        co_return json_error(404, "Order not found");
+    }
+    const auto deadline = deadline_for(req, runtime_config::request_timeout_ms);
+    if (cache != nullptr) {
+        const bool on_redis = co_await route_coro::resume_on(storage_executors::redis());
+        if (!on_redis) {
+            co_return storage_busy(storage_executors::redis());
+        }
+        if (deadline.expired()) {
+            co_return deadline_exceeded(request_deadline::Stage::Queue);
+        }
+        request_deadline::Scope scope(deadline);
+        request_trace::Scope trace_scope(request_trace_of(req));
+        alloc_stats::Scope alloc_scope(alloc_account_of(req));
+        if (auto hit = cached_order_response(order_no)) {
+            co_return move(*hit);
+        }
+    }
+    const bool on_sqlite = co_await route_coro::resume_on(storage_executors::sqlite());
+    if (!on_sqlite) {
+        co_return storage_busy(storage_executors::sqlite());
+    }
+    if (deadline.expired()) {
+        co_return deadline_exceeded(request_deadline::Stage::Queue);
+    }
+    request_deadline::Scope scope(deadline);
+    request_trace::Scope trace_scope(request_trace_of(req));
+    alloc_stats::Scope alloc_scope(alloc_account_of(req));
+    auto response = load_order(order_no);
+    if (request_deadline::interrupted()) {
+        co_return deadline_exceeded(request_deadline::Stage::Sqlite);
+    }
+    co_return response;
+}
+#else
+void get_order(const crow::request& req, crow::response& res, const std::string& order_no) {
+    if (filtered_out(order_no)) {
+        return respond_now(res, json_error(404, "Order not found"));
+    }
+    const auto deadline = deadline_for(req, runtime_config::request_timeout_ms);
+    if (cache == nullptr) {
+        run_stage(storage_executors::sqlite(), req, res, deadline, [order_no] { return optional<crow::response>(load_order(order_no)); });
+        return;
+    }
+    run_stage(storage_executors::redis(), req, res, deadline, [&req, &res, deadline, order_no]() -> optional<crow::response> {
+        if (auto hit = cached_order_response(order_no)) {
+            return hit;
+        }
+        run_stage(storage_executors::sqlite(), req, res, deadline, [order_no] { return optional<crow::response>(load_order(order_no)); });
+        return nullopt;
+    });
+}
+#endif
+
+void pay_order(const crow::request& req, crow::response& res) {
+    auto body = parse_body(req);
+    if (!body) {
+        return respond_now(res, json_error(400, "Invalid JSON format"));
+    }
+    if (!body.has("order_no") || !is_valid_order_no(body["order_no"])) {
+        return respond_now(res, json_error(400, "Missing order_no"));
+    }
+    if (body["order_no"].t() != crow::json::type::String) {
+        return respond_now(res, json_error(400, "order_no must be a string"));
+    }
+
+    const string order_no = body["order_no"].s();
+    if (filtered_out(order_no)) {
+        return respond_now(res, json_error(404, "Order not found"));
+    }
+    run_stage(storage_executors::sqlite(), req, res, deadline_for(req, runtime_config::request_timeout_ms), [&req, &res, order_no] {
+        return mark_order_paid(req, res, order_no);
+    });
+}
+
+void list_orders(const crow::request& req, crow::response& res) {
+    const string status = req.url_params.get("status") ? req.url_params.get("status") : "";
+    run_stage(storage_executors::sqlite(), req, res, deadline_for(req, runtime_config::list_timeout_ms), [status] {
+        return optional<crow::response>(query_orders(status));
+    });
+}
+
+void delete_order(const crow::request& req, crow::response& res, const std::string& order_no) {
+    if (filtered_out(order_no)) {
+        return respond_now(res, json_error(404, "Order not found"));
+    }
+    run_stage(storage_executors::sqlite(), req, res, deadline_for(req, runtime_config::request_timeout_ms), [&req, &res, order_no] {
+        return remove_order(req, res, order_no);
+    });
+}
+
+// A read-only connection for one export, so it never steps the shared connection from an I/O
+// thread. The archive tier attaches the archive file, read-only as well.
+sqlite3* open_export_connection(bool archive) {
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(sqlite3_db_filename(db, "main"), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        record_sqlite_failure("Can't open export connection: " + string(sqlite3_errmsg(conn)));
+        sqlite3_close(conn);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(conn, kExportBusyTimeoutMs);
+    if (!archive) {
+        return conn;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(conn, "ATTACH DATABASE ? AS archive;", -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, sqlite3_db_filename(db, "archive"), -1, SQLITE_TRANSIENT);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    }
     sqlite3_finalize(stmt);
-    if (deleted_rows == 0) {
-        return json_error(404, "Order not found");
+    if (rc != SQLITE_OK) {
+        record_sqlite_failure("Can't attach archive for export: " + string(sqlite3_errmsg(conn)));
+        sqlite3_close(conn);
+        return nullptr;
     }
+    return conn;
+}
 
-    invalidate_cached_order(order_no, "Deleted order from Redis:");
+crow::response export_orders(const crow::request& req) {
+    const string format = req.url_params.get("format") ? req.url_params.get("format") : "ndjson";
+    if (format != "ndjson" && format != "csv") {
+        return json_error(400, "format must be ndjson or csv");
+    }
 
-    crow::json::wvalue res;
-    res["deleted"] = true;
-    res["order_no"] = order_no;
-    return crow::response(200, res);
+    int64_t since = 0;
+    if (const char* raw_since = req.url_params.get("since")) {
+        char* end = nullptr;
+        since = strtoll(raw_since, &end, 10);
+        if (end == raw_since || *end != '\0' || since < 0) {
+            return json_error(400, "since must be a unix timestamp in seconds");
+        }
+    }
+
+    const char* raw_gzip = req.url_params.get("gzip");
+    const bool gzip = raw_gzip != nullptr
+        ? string(raw_gzip) == "1" || string(raw_gzip) == "true"
+        : req.get_header_value("Accept-Encoding").find("gzip") != string::npos;
+
+    const string tier = req.url_params.get("tier") ? req.url_params.get("tier") : "hot";
+    if (tier != "hot" && tier != "archive") {
+        return json_error(400, "tier must be hot or archive");
+    }
+    if (tier == "archive" && !order_archive::is_attached()) {
+        return json_error(404, "Archive tier is not enabled");
+    }
+
+    sqlite3* conn = open_export_connection(tier == "archive");
+    if (conn == nullptr) {
+        return json_error(500, "Internal DB error");
+    }
+    auto cursor = make_shared<OrderExportCursor>(
+        conn,
+        tier == "hot" ? statements::export_orders : statements::export_archived_orders,
+        since,
+        format == "csv",
+        gzip,
+        deadline_for(req, runtime_config::export_timeout_ms));
+    crow::response res(200);
+    res.set_header("Content-Type", format == "csv" ? "text/csv" : "application/x-ndjson");
+    if (cursor->gzip()) {
+        res.set_header("Content-Encoding", "gzip");
+    }
+    res.set_body_source([cursor](string& chunk) {
+        return cursor->next_chunk(chunk);
+    });
+    return res;
 }
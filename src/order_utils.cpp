@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+#include <string>
+
+#include "order_codec.h"
+#include "order_utils.h"
+#include "runtime_config.h"
+
+using namespace std;
+
+string generate_order_no(){
+    long long timestamp = time(nullptr);
+    int rand_part = rand()%100000;
+    return "ORD" + to_string(timestamp) + to_string(rand_part);
+}
+
+string format_time(time_t t){
+    if(t == 0) return "N/A";
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+    return string(buf);
+}
+
+crow::response json_error(int code, const std::string& message) {
+    crow::json::wvalue err;
+    err["error"] = message;
+    return crow::response(code, err);
+}
+
+crow::json::wvalue order_json(const std::string& order_no, double amount, const std::string& status, time_t created_at, time_t paid_at) {
+    crow::json::wvalue order;
+    order["order_no"] = order_no;
+    order["amount"] = amount;
+    order["status"] = status;
+    order["created_at"] = format_time(created_at);
+    order["paid_at"] = paid_at == 0 ? crow::json::wvalue() : format_time(paid_at);
+    return order;
+}
+
+string order_cache_payload(const string& order_no, double amount, const string& status, time_t created_at, time_t paid_at) {
+    if (runtime_config::cache_binary_encoding.load(memory_order_relaxed)) {
+        order_codec::Order order;
+        order.amount = amount;
+        order.status = status;
+        order.created_at = created_at;
+        order.paid_at = paid_at;
+        if (auto encoded = order_codec::encode(order)) {
+            return move(*encoded);
+        }
+    }
+    // Full response body, exactly what readers that predate the binary format expect.
+    return order_json(order_no, amount, status, created_at, paid_at).dump();
+}
+
+optional<string> render_cached_order(const string& order_no, const string& payload) {
+    if (order_codec::is_json(payload)) {
+        return payload;
+    }
+    const auto order = order_codec::decode(payload);
+    if (!order) {
+        return nullopt;
+    }
+    return order_json(order_no, order->amount, string(order->status), order->created_at, order->paid_at).dump();
+}
@@ -0,0 +1,112 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "process_stats.h"
+
+#ifdef __linux__
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+namespace {
+double seconds(const timeval& time) {
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6;
+}
+
+// The CPU-time clock of any thread in this process (MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED)),
+// as in cpu_profiler.cpp.
+clockid_t thread_cpu_clock(pid_t tid) {
+    return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6);
+}
+
+string thread_name(const string& tid) {
+    FILE* file = fopen(("/proc/self/task/" + tid + "/comm").c_str(), "r");
+    if (file == nullptr) {
+        return string();
+    }
+    char name[32] = {};
+    const bool read = fgets(name, sizeof(name), file) != nullptr;
+    fclose(file);
+    if (!read) {
+        return string();
+    }
+    string result(name);
+    if (!result.empty() && result.back() == '\n') {
+        result.pop_back();
+    }
+    return result;
+}
+}
+
+namespace process_stats {
+int64_t resident_bytes() {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    long size = 0;
+    long resident = 0;
+    const int fields = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    return fields == 2 ? static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+}
+
+double cpu_seconds() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+vector<ThreadCpu> threads() {
+    map<string, ThreadCpu> by_name;
+    DIR* dir = opendir("/proc/self/task");
+    if (dir == nullptr) {
+        return {};
+    }
+    while (const dirent* entry = readdir(dir)) {
+        const long tid = strtol(entry->d_name, nullptr, 10);
+        timespec cpu{};
+        // A thread that exits between readdir and here has no clock any more; skip it.
+        if (tid <= 0 || clock_gettime(thread_cpu_clock(static_cast<pid_t>(tid)), &cpu) != 0) {
+            continue;
+        }
+        const string name = thread_name(entry->d_name);
+        ThreadCpu& thread = by_name[name];
+        thread.name = name;
+        thread.threads += 1;
+        thread.cpu_seconds += static_cast<double>(cpu.tv_sec) + static_cast<double>(cpu.tv_nsec) / 1e9;
+    }
+    closedir(dir);
+    vector<ThreadCpu> result;
+    result.reserve(by_name.size());
+    for (auto& entry : by_name) {
+        result.push_back(move(entry.second));
+    }
+    return result;
+}
+}
+#else
+namespace process_stats {
+int64_t resident_bytes() {
+    return 0;
+}
+
+double cpu_seconds() {
+    return 0;
+}
+
+vector<ThreadCpu> threads() {
+    return {};
+}
+}
+#endif
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sw/redis++/redis++.h>
+
+#include "metrics.h"
+#include "redis_cache.h"
+#include "request_deadline.h"
+
+using namespace std;
+using namespace metrics;
+
+namespace {
+sw::redis::ConnectionOptions connection_options(const order_cache::RedisOptions& options) {
+    sw::redis::ConnectionOptions connection;
+    connection.host = options.host;
+    connection.port = options.port;
+    connection.connect_timeout = chrono::milliseconds(options.connect_timeout_ms);
+    connection.socket_timeout = chrono::milliseconds(options.socket_timeout_ms);
+    return connection;
+}
+
+sw::redis::ConnectionPoolOptions pool_options(const order_cache::RedisOptions& options) {
+    sw::redis::ConnectionPoolOptions pool;
+    pool.size = static_cast<size_t>(options.pool_size);
+    pool.wait_timeout = chrono::milliseconds(options.pool_wait_timeout_ms);
+    pool.connection_lifetime = chrono::milliseconds(options.connection_lifetime_ms);
+    return pool;
+}
+
+// Conditional SET for versioned values ("<version>:<payload>"). KEYS[1] = key,
+// ARGV = {version, value, ttl seconds}. Returns 0 when the stored version is higher.
+const char* kSetIfNewerScript = R"lua(
+local current = redis.call('GET', KEYS[1])
+if current then
+    local version = tonumber(string.match(current, '^(%d+):'))
+    if version and version > tonumber(ARGV[1]) then
+        return 0
+    end
+end
+redis.call('SET', KEYS[1], ARGV[2], 'EX', ARGV[3])
+return 1
+)lua";
+
+// Counts connections checked out of the pool. redis++ does not expose its own pool, so this
+// gate mirrors its size: whenever a caller has to wait here, the pool would have made it
+// wait too, and the time spent is what we export.
+class PoolGate {
+public:
+    PoolGate(int size, chrono::milliseconds wait_timeout) : available_(size), wait_timeout_(wait_timeout) {}
+
+    void acquire() {
+        unique_lock<mutex> lock(mutex_);
+        if (available_ == 0) {
+            redis_pool_exhausted.fetch_add(1, memory_order_relaxed);
+            const auto start = chrono::steady_clock::now();
+            // A request's deadline can only shorten the wait.
+            auto wait = wait_timeout_;
+            if (const auto* deadline = request_deadline::current()) {
+                wait = min(wait, deadline->remaining());
+            }
+            const bool got = cv_.wait_for(lock, wait, [this] { return available_ > 0; });
+            const auto waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+            observe_redis_pool_wait_us(waited);
+            if (!got) {
+                redis_pool_timeouts.fetch_add(1, memory_order_relaxed);
+                throw sw::redis::Error("Timed out waiting for a Redis pool connection");
+            }
+        } else {
+            observe_redis_pool_wait_us(0);
+        }
+        --available_;
+        redis_pool_in_use.fetch_add(1, memory_order_relaxed);
+    }
+
+    void release() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            ++available_;
+        }
+        redis_pool_in_use.fetch_sub(1, memory_order_relaxed);
+        cv_.notify_one();
+    }
+
+private:
+    mutex mutex_;
+    condition_variable cv_;
+    int available_;
+    chrono::milliseconds wait_timeout_;
+};
+
+class PoolCheckout {
+public:
+    explicit PoolCheckout(PoolGate& gate) : gate_(gate) {
+        gate_.acquire();
+    }
+    ~PoolCheckout() {
+        gate_.release();
+    }
+    PoolCheckout(const PoolCheckout&) = delete;
+    PoolCheckout& operator=(const PoolCheckout&) = delete;
+
+private:
+    PoolGate& gate_;
+};
+
+class RedisBackend : public order_cache::Backend {
+public:
+    explicit RedisBackend(const order_cache::RedisOptions& options)
+        : redis_(connection_options(options), pool_options(options)),
+          gate_(options.pool_size, chrono::milliseconds(options.pool_wait_timeout_ms)) {}
+
+    void set(const string& key, const string& value, chrono::seconds ttl) override {
+        PoolCheckout checkout(gate_);
+        redis_.set(key, value, ttl);
+    }
+
+    optional<string> get(const string& key) override {
+        PoolCheckout checkout(gate_);
+        auto val = redis_.get(key);
+        return val ? optional<string>(std::move(*val)) : nullopt;
+    }
+
+    void del(const string& key) override {
+        PoolCheckout checkout(gate_);
+        redis_.del(key);
+    }
+
+    void ping() override {
+        PoolCheckout checkout(gate_);
+        redis_.ping();
+    }
+
+    bool set_if_newer(const string& key, const string& value, int64_t version, chrono::seconds ttl) override {
+        PoolCheckout checkout(gate_);
+        const string version_arg = to_string(version);
+        const string ttl_arg = to_string(ttl.count());
+        return redis_.eval<long long>(kSetIfNewerScript, {key}, {version_arg, value, ttl_arg}) == 1;
+    }
+
+    // One pipeline per call: a single round trip instead of one per key.
+    void set_many(const vector<order_cache::VersionedEntry>& entries) override {
+        PoolCheckout checkout(gate_);
+        auto pipe = redis_.pipeline(false);
+        for (const auto& entry : entries) {
+            // Arguments are serialised into the command buffer right away, so temporaries are fine.
+            const string version_arg = to_string(entry.version);
+            const string ttl_arg = to_string(entry.ttl.count());
+            pipe.eval(kSetIfNewerScript, {entry.key}, {version_arg, entry.value, ttl_arg});
+        }
+        pipe.exec();
+    }
+
+private:
+    sw::redis::Redis redis_;
+    PoolGate gate_;
+};
+}
+
+namespace order_cache {
+unique_ptr<Backend> make_redis_backend(const RedisOptions& options) {
+    return make_unique<RedisBackend>(options);
+}
+}
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+#include "metrics.h"
+#include "request_trace.h"
+#include "runtime_config.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+// Requests waiting for the writer; past this many, new ones are dropped.
+constexpr size_t kMaxPending = 4096;
+
+mutex export_mutex;
+condition_variable export_ready;
+deque<string> pending;
+// Read without the lock by sample().
+atomic<bool> exporting{false};
+bool stopping = false;
+thread writer;
+
+int process_id() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return static_cast<int>(getpid());
+#endif
+}
+
+void write_loop(ofstream out) {
+    unique_lock<mutex> lock(export_mutex);
+    while (true) {
+        export_ready.wait(lock, [] { return stopping || !pending.empty(); });
+        deque<string> batch;
+        batch.swap(pending);
+        const bool done = stopping;
+        lock.unlock();
+        for (const auto& events : batch) {
+            out << events;
+        }
+        out.flush();
+        lock.lock();
+        if (done && pending.empty()) {
+            return;
+        }
+    }
+}
+}
+
+namespace request_trace {
+void start_export(const string& path) {
+    ofstream out(path, ios::app);
+    if (!out) {
+        spdlog::error("Can't open trace file {}, trace export disabled", path);
+        return;
+    }
+    // A new file starts the JSON array; appending to one a previous server left continues it.
+    out.seekp(0, ios::end);
+    if (out.tellp() == 0) {
+        out << "[\n";
+    }
+    lock_guard<mutex> lock(export_mutex);
+    exporting.store(true);
+    stopping = false;
+    writer = thread(write_loop, move(out));
+    spdlog::info("Exporting sampled request traces to {} ({}% of requests)", path,
+                 runtime_config::trace_sample_percent.load(memory_order_relaxed));
+}
+
+void stop_export() {
+    {
+        lock_guard<mutex> lock(export_mutex);
+        if (!exporting.load()) {
+            return;
+        }
+        exporting.store(false);
+        stopping = true;
+    }
+    export_ready.notify_one();
+    writer.join();
+}
+
+bool sample() {
+    const int percent = runtime_config::trace_sample_percent.load(memory_order_relaxed);
+    if (percent <= 0 || !exporting.load(memory_order_relaxed)) {
+        return false;
+    }
+    thread_local minstd_rand rng(random_device{}());
+    return static_cast<int>(rng() % 100) < percent;
+}
+
+void export_request(const Trace& trace, const string& name, Clock::time_point start, Clock::duration total, int status) {
+    static const int pid = process_id();
+    string events = trace_events(trace, name, start, total, status, thread_number(), pid);
+    {
+        lock_guard<mutex> lock(export_mutex);
+        if (!exporting.load()) {
+            return;
+        }
+        if (pending.size() >= kMaxPending) {
+            metrics::traces_dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        pending.push_back(move(events));
+    }
+    metrics::traces_exported.fetch_add(1, memory_order_relaxed);
+    export_ready.notify_one();
+}
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "sql_stats.h"
+
+using namespace std;
+
+namespace {
+struct Connection {
+    Connection(sqlite3* connection, string connection_name, int timeout_ms)
+        : db(connection), name(move(connection_name)), busy_timeout_ms(timeout_ms) {}
+
+    // Null once unwatched; guarded by connections_mutex.
+    sqlite3* db;
+    string name;
+    int busy_timeout_ms;
+    atomic<int64_t> busy_waits{0};
+    atomic<int64_t> busy_wait_us_total{0};
+    atomic<int64_t> busy_timeouts{0};
+};
+
+mutex connections_mutex;
+// A deque so the busy handler's pointer into it stays valid.
+deque<Connection> watched;
+
+int wait_on_busy(void* arg, int count) {
+    auto* connection = static_cast<Connection*>(arg);
+    const int delay_ms = sql_stats::busy_delay_ms(count, connection->busy_timeout_ms);
+    if (delay_ms == 0) {
+        connection->busy_timeouts.fetch_add(1, memory_order_relaxed);
+        return 0;
+    }
+    if (count == 0) {
+        connection->busy_waits.fetch_add(1, memory_order_relaxed);
+    }
+    const auto start = chrono::steady_clock::now();
+    this_thread::sleep_for(chrono::milliseconds(delay_ms));
+    connection->busy_wait_us_total.fetch_add(
+        chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count(), memory_order_relaxed);
+    return 1;
+}
+
+int64_t db_status(sqlite3* db, int op) {
+    int current = 0;
+    int highwater = 0;
+    sqlite3_db_status(db, op, &current, &highwater, 0);
+    return current;
+}
+}
+
+namespace sql_stats {
+Query::Query(sqlite3* db, Statement& statement) : statement_(&statement) {
+    if (sqlite3_prepare_v2(db, statement.sql(), -1, &stmt_, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt_);
+        stmt_ = nullptr;
+        statement.errors.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+Query::Query(Query&& other) noexcept
+    : statement_(other.statement_),
+      stmt_(exchange(other.stmt_, nullptr)),
+      step_ns_(other.step_ns_),
+      stepped_(other.stepped_),
+      failed_(other.failed_) {}
+
+Query::~Query() {
+    finalize();
+}
+
+int Query::step() {
+    const auto start = chrono::steady_clock::now();
+    const int rc = sqlite3_step(stmt_);
+    step_ns_ += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    stepped_ = true;
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        failed_ = true;
+    }
+    return rc;
+}
+
+void Query::finalize() {
+    if (stmt_ == nullptr) {
+        return;
+    }
+    if (stepped_) {
+        Counters counters;
+        counters.fullscan_steps = sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+        counters.sorts = sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_SORT, 0);
+        counters.autoindexes = sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+        counters.vm_steps = sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_VM_STEP, 0);
+        statement_->record(step_ns_ / 1000, failed_, counters);
+    }
+    sqlite3_finalize(stmt_);
+    stmt_ = nullptr;
+}
+
+void watch(sqlite3* db, const string& name, int busy_timeout_ms) {
+    lock_guard<mutex> lock(connections_mutex);
+    watched.emplace_back(db, name, busy_timeout_ms);
+    sqlite3_busy_handler(db, wait_on_busy, &watched.back());
+}
+
+void set_busy_timeout(sqlite3* db, int busy_timeout_ms) {
+    lock_guard<mutex> lock(connections_mutex);
+    for (auto& connection : watched) {
+        if (connection.db == db) {
+            connection.busy_timeout_ms = busy_timeout_ms;
+        }
+    }
+}
+
+void unwatch(sqlite3* db) {
+    lock_guard<mutex> lock(connections_mutex);
+    for (auto& connection : watched) {
+        if (connection.db == db) {
+            connection.db = nullptr;
+        }
+    }
+}
+
+vector<ConnectionStats> connections() {
+    vector<ConnectionStats> stats;
+    lock_guard<mutex> lock(connections_mutex);
+    for (const auto& connection : watched) {
+        if (connection.db == nullptr) {
+            continue;
+        }
+        ConnectionStats entry;
+        entry.name = connection.name;
+        entry.cache_hits = db_status(connection.db, SQLITE_DBSTATUS_CACHE_HIT);
+        entry.cache_misses = db_status(connection.db, SQLITE_DBSTATUS_CACHE_MISS);
+        entry.cache_writes = db_status(connection.db, SQLITE_DBSTATUS_CACHE_WRITE);
+        entry.cache_used_bytes = db_status(connection.db, SQLITE_DBSTATUS_CACHE_USED);
+        entry.busy_waits = connection.busy_waits.load(memory_order_relaxed);
+        entry.busy_wait_us_total = connection.busy_wait_us_total.load(memory_order_relaxed);
+        entry.busy_timeouts = connection.busy_timeouts.load(memory_order_relaxed);
+        stats.push_back(move(entry));
+    }
+    return stats;
+}
+}
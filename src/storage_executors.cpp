@@ -0,0 +1,67 @@
+#include <memory>
+#include <mutex>
+
+#include "metrics.h"
+#include "storage_executors.h"
+
+using namespace std;
+
+namespace {
+metrics::ExecutorStats inline_stats("inline");
+BoundedExecutor inline_executor(inline_stats, 0, 0);
+
+unique_ptr<BoundedExecutor> sqlite_executor;
+unique_ptr<BoundedExecutor> redis_executor;
+mutex options_mutex;
+storage_executors::Options current_options;
+}
+
+namespace storage_executors {
+void start(const Options& options) {
+    {
+        lock_guard<mutex> lock(options_mutex);
+        current_options = options;
+    }
+    sqlite_executor = make_unique<BoundedExecutor>(
+        metrics::executors.emplace_back("sqlite"), options.sqlite_threads, options.sqlite_queue);
+    redis_executor = make_unique<BoundedExecutor>(
+        metrics::executors.emplace_back("redis"), options.redis_threads, options.redis_queue);
+}
+
+bool resize(const Options& options) {
+    lock_guard<mutex> lock(options_mutex);
+    if (!sqlite_executor || !redis_executor ||
+        !sqlite_executor->resize(options.sqlite_threads, options.sqlite_queue)) {
+        return false;
+    }
+    if (!redis_executor->resize(options.redis_threads, options.redis_queue)) {
+        sqlite_executor->resize(current_options.sqlite_threads, current_options.sqlite_queue);
+        return false;
+    }
+    current_options = options;
+    return true;
+}
+
+Options options() {
+    lock_guard<mutex> lock(options_mutex);
+    return current_options;
+}
+
+void stop() {
+    // SQLite tasks may queue follow-up cache writes, so drain them first.
+    if (sqlite_executor) {
+        sqlite_executor->stop();
+    }
+    if (redis_executor) {
+        redis_executor->stop();
+    }
+}
+
+BoundedExecutor& sqlite() {
+    return sqlite_executor ? *sqlite_executor : inline_executor;
+}
+
+BoundedExecutor& redis() {
+    return redis_executor ? *redis_executor : inline_executor;
+}
+}
@@ -0,0 +1,122 @@
+#include "doctest.h"
+#include "bounded_executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+TEST_CASE("BoundedExecutor with no threads runs tasks inline") {
+    metrics::ExecutorStats stats("inline");
+    BoundedExecutor executor(stats, 0, 0);
+    const auto caller = std::this_thread::get_id();
+    std::thread::id ran_on;
+    CHECK(executor.submit([&ran_on] { ran_on = std::this_thread::get_id(); }));
+    CHECK((ran_on == caller));
+    CHECK(stats.completed.load() == 1);
+}
+
+TEST_CASE("BoundedExecutor rejects work once its queue is full") {
+    metrics::ExecutorStats stats("test");
+    BoundedExecutor executor(stats, 1, 2);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool started = false;
+    bool release = false;
+    REQUIRE(executor.submit([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        started = true;
+        cv.notify_all();
+        cv.wait(lock, [&] { return release; });
+    }));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return started; });
+    }
+
+    std::atomic<int> ran{0};
+    CHECK(executor.submit([&ran] { ran.fetch_add(1); }));
+    CHECK(executor.submit([&ran] { ran.fetch_add(1); }));
+    CHECK_FALSE(executor.submit([&ran] { ran.fetch_add(1); }));
+    CHECK(stats.queue_depth.load() == 2);
+    CHECK(stats.rejected.load() == 1);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+    }
+    cv.notify_all();
+    executor.stop();
+    CHECK(ran.load() == 2);
+    CHECK(stats.completed.load() == 3);
+    CHECK(stats.queue_depth.load() == 0);
+}
+
+TEST_CASE("BoundedExecutor drains queued work on stop and refuses new work after") {
+    metrics::ExecutorStats stats("test");
+    BoundedExecutor executor(stats, 2, 100);
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 50; ++i) {
+        CHECK(executor.submit([&ran] { ran.fetch_add(1); }));
+    }
+    executor.stop();
+    CHECK(ran.load() == 50);
+    CHECK_FALSE(executor.submit([&ran] { ran.fetch_add(1); }));
+    CHECK(ran.load() == 50);
+}
+
+TEST_CASE("BoundedExecutor resize adds and retires workers") {
+    metrics::ExecutorStats stats("test");
+    BoundedExecutor executor(stats, 1, 1);
+    REQUIRE(executor.resize(3, 10));
+    CHECK(stats.threads.load() == 3);
+    CHECK(stats.queue_capacity.load() == 10);
+
+    // Three tasks that only finish once all three run at the same time.
+    std::mutex mutex;
+    std::condition_variable cv;
+    int running = 0;
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(executor.submit([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++running;
+            cv.notify_all();
+            cv.wait(lock, [&] { return running >= 3; });
+        }));
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK(cv.wait_for(lock, std::chrono::seconds(5), [&] { return running >= 3; }));
+    }
+
+    REQUIRE(executor.resize(1, 10));
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 5; ++i) {
+        CHECK(executor.submit([&ran] { ran.fetch_add(1); }));
+    }
+    executor.stop();
+    CHECK(ran.load() == 5);
+    CHECK_FALSE(executor.resize(2, 10));
+
+    metrics::ExecutorStats inline_stats("inline");
+    BoundedExecutor inline_executor(inline_stats, 0, 0);
+    CHECK_FALSE(inline_executor.resize(2, 10));
+}
+
+TEST_CASE("BoundedExecutor joins workers retired by a shrink") {
+    metrics::ExecutorStats stats("test");
+    BoundedExecutor executor(stats, 1, 10);
+    for (int cycle = 0; cycle < 20; ++cycle) {
+        REQUIRE(executor.resize(4, 10));
+        REQUIRE(executor.resize(1, 10));
+    }
+    // Retired workers exit once they wake up; each resize joins the ones that have.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (executor.worker_threads() > 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(executor.resize(1, 10));
+    }
+    CHECK(executor.worker_threads() == 1);
+}
@@ -0,0 +1,79 @@
+#include "doctest.h"
+#include "circuit_breaker.h"
+
+using namespace std::chrono;
+
+namespace {
+CircuitBreaker::Options small_options() {
+    CircuitBreaker::Options options;
+    options.window_ms = 1000;
+    options.min_calls = 4;
+    options.failure_rate = 0.5;
+    options.slow_call_ms = 50;
+    options.half_open_calls = 2;
+    return options;
+}
+}
+
+TEST_CASE("CircuitBreaker opens once the failure rate is reached") {
+    CircuitBreaker breaker(small_options());
+    breaker.record(true, milliseconds(1));
+    breaker.record(false, milliseconds(1));
+    breaker.record(true, milliseconds(1));
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+
+    breaker.record(false, milliseconds(1));
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+    CHECK_FALSE(breaker.allow());
+}
+
+TEST_CASE("CircuitBreaker counts slow calls as failures") {
+    CircuitBreaker breaker(small_options());
+    for (int i = 0; i < 4; ++i) {
+        breaker.record(true, milliseconds(80));
+    }
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+}
+
+TEST_CASE("CircuitBreaker forgets failures from an expired window") {
+    CircuitBreaker breaker(small_options());
+    const auto start = CircuitBreaker::Clock::now();
+    breaker.record(false, milliseconds(1), start);
+    breaker.record(false, milliseconds(1), start);
+    breaker.record(false, milliseconds(1), start);
+
+    const auto later = start + seconds(2);
+    for (int i = 0; i < 4; ++i) {
+        breaker.record(true, milliseconds(1), later);
+    }
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+}
+
+TEST_CASE("CircuitBreaker half-open admits limited trials and closes on success") {
+    int transitions_seen = 0;
+    CircuitBreaker breaker(small_options(), [&](CircuitBreaker::State, CircuitBreaker::State) { ++transitions_seen; });
+    breaker.trip();
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+
+    breaker.probe_succeeded();
+    CHECK(breaker.state() == CircuitBreaker::State::HalfOpen);
+    CHECK(breaker.allow());
+    CHECK(breaker.allow());
+    CHECK_FALSE(breaker.allow());
+
+    breaker.record(true, milliseconds(1));
+    breaker.record(true, milliseconds(1));
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+    CHECK(breaker.allow());
+    CHECK(transitions_seen == 3);
+    CHECK(breaker.transitions() == 3);
+}
+
+TEST_CASE("CircuitBreaker half-open reopens on a failed trial") {
+    CircuitBreaker breaker(small_options());
+    breaker.trip();
+    breaker.probe_succeeded();
+    REQUIRE(breaker.allow());
+    breaker.record(false, milliseconds(1));
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+}
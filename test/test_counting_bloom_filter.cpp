@@ -0,0 +1,69 @@
+#include "doctest.h"
+#include "counting_bloom_filter.h"
+
+#include <string>
+
+namespace {
+std::string order_no(int i) {
+    return "ORD" + std::to_string(1700000000000 + i);
+}
+}
+
+TEST_CASE("CountingBloomFilter has no false negatives") {
+    CountingBloomFilter filter(10000, 0.01);
+    for (int i = 0; i < 10000; ++i) {
+        filter.add(order_no(i));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        CHECK(filter.might_contain(order_no(i)));
+    }
+}
+
+TEST_CASE("CountingBloomFilter stays near its false positive rate at capacity") {
+    CountingBloomFilter filter(10000, 0.01);
+    for (int i = 0; i < 10000; ++i) {
+        filter.add(order_no(i));
+    }
+    int false_positives = 0;
+    for (int i = 10000; i < 110000; ++i) {
+        false_positives += filter.might_contain(order_no(i)) ? 1 : 0;
+    }
+    CHECK(false_positives < 2000);
+}
+
+TEST_CASE("CountingBloomFilter forgets removed keys and keeps the rest") {
+    CountingBloomFilter filter(1000, 0.001);
+    for (int i = 0; i < 1000; ++i) {
+        filter.add(order_no(i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        filter.remove(order_no(i));
+    }
+    int still_present = 0;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 2 == 1) {
+            CHECK(filter.might_contain(order_no(i)));
+        } else {
+            still_present += filter.might_contain(order_no(i)) ? 1 : 0;
+        }
+    }
+    CHECK(still_present < 10);
+}
+
+TEST_CASE("CountingBloomFilter restored from its counters answers like the original") {
+    CountingBloomFilter filter(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) {
+        filter.add(order_no(i));
+    }
+    const auto restored = CountingBloomFilter::from_counters(filter.hash_count(), filter.counters());
+    REQUIRE(restored != nullptr);
+    CHECK(restored->size() == filter.size());
+    for (int i = 0; i < 5000; ++i) {
+        CHECK(restored->might_contain(order_no(i)) == filter.might_contain(order_no(i)));
+    }
+    restored->remove(order_no(0));
+    CHECK(filter.might_contain(order_no(0)));
+
+    CHECK(CountingBloomFilter::from_counters(0, filter.counters()) == nullptr);
+    CHECK(CountingBloomFilter::from_counters(filter.hash_count(), "") == nullptr);
+}
@@ -0,0 +1,57 @@
+#include "doctest.h"
+#include "cpu_profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Stacks fold into flame-graph lines, heaviest first") {
+    const std::vector<std::vector<std::string>> stacks = {
+        {"main", "run", "parse"},
+        {"main", "run", "write"},
+        {"main", "run", "parse"},
+        {"main", "run", "parse"},
+        {"main", "run", "write"},
+        {"main", "idle"},
+        {},
+    };
+    CHECK(cpu_profiler::fold(stacks) == "main;run;parse 3\nmain;run;write 2\nmain;idle 1\n");
+    CHECK(cpu_profiler::fold({}).empty());
+}
+
+TEST_CASE("A profile started and stopped samples a busy thread") {
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> spins{0};
+    std::thread busy([&] {
+        while (!done.load(std::memory_order_relaxed)) {
+            spins.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    cpu_profiler::Options options;
+    options.seconds = 1;
+    options.hz = 1000;
+    const auto started = cpu_profiler::start(options);
+    if (started == cpu_profiler::StartResult::Unsupported) {
+        done = true;
+        busy.join();
+        return;
+    }
+    REQUIRE(started == cpu_profiler::StartResult::Started);
+    CHECK(cpu_profiler::start(options) == cpu_profiler::StartResult::Busy);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const cpu_profiler::Profile profile = cpu_profiler::stop();
+    done = true;
+    busy.join();
+
+    CHECK(profile.samples >= 1);
+    CHECK(profile.threads >= 2);
+    CHECK_FALSE(profile.folded.empty());
+
+    // Stopping frees the profiler for the next profile.
+    REQUIRE(cpu_profiler::start(options) == cpu_profiler::StartResult::Started);
+    cpu_profiler::stop();
+}
@@ -0,0 +1,63 @@
+#include "doctest.h"
+#include "flight_recorder.h"
+
+#include <string>
+
+using flight_recorder::Event;
+using flight_recorder::Type;
+
+namespace {
+Event event(uint64_t ticks, Type type, uint16_t request, uint32_t value = 0) {
+    return Event{ticks, value, static_cast<uint16_t>(type), request};
+}
+}
+
+TEST_CASE("Flight recorder dumps survive encode and decode, and truncated dumps are rejected") {
+    flight_recorder::Dump dump;
+    dump.reason = "slow";
+    dump.unix_ms = 1700000000123;
+    dump.ticks = 5000000;
+    dump.ticks_per_us = 2.5;
+    dump.threads.push_back({3, {event(100, Type::RequestStart, 7), event(200, Type::SqliteStep, 7, 1234)}});
+    dump.threads.push_back({9, {}});
+
+    const std::string bytes = flight_recorder::encode(dump);
+    const auto decoded = flight_recorder::decode(bytes);
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->reason == "slow");
+    CHECK(decoded->unix_ms == dump.unix_ms);
+    CHECK(decoded->ticks == dump.ticks);
+    CHECK(decoded->ticks_per_us == 2.5);
+    REQUIRE(decoded->threads.size() == 2);
+    CHECK(decoded->threads[0].thread == 3);
+    REQUIRE(decoded->threads[0].events.size() == 2);
+    CHECK(decoded->threads[0].events[1].value == 1234);
+    CHECK(decoded->threads[0].events[1].type == static_cast<uint16_t>(Type::SqliteStep));
+    CHECK(decoded->threads[1].events.empty());
+
+    CHECK_FALSE(flight_recorder::decode(bytes.substr(0, bytes.size() - 1)).has_value());
+    CHECK_FALSE(flight_recorder::decode("not a dump").has_value());
+}
+
+TEST_CASE("The timeline merges threads in tick order and pairs request start and end") {
+    flight_recorder::Dump dump;
+    dump.reason = "admin";
+    dump.ticks = 10000;
+    dump.ticks_per_us = 1.0;  // 1000 ticks per millisecond
+    dump.threads.push_back({1, {event(1000, Type::RequestStart, 42), event(4000, Type::RequestEnd, 42, 200)}});
+    dump.threads.push_back({2, {event(2000, Type::CacheMiss, 42), event(2500, Type::SqliteStep, 42, 500)}});
+
+    const std::string timeline = flight_recorder::timeline(dump);
+    CHECK(timeline.rfind("# reason=admin", 0) == 0);
+    const auto start = timeline.find("request_start");
+    const auto miss = timeline.find("cache_miss");
+    const auto step = timeline.find("sqlite_step");
+    const auto end = timeline.find("request_end");
+    REQUIRE(end != std::string::npos);
+    CHECK(start < miss);
+    CHECK(miss < step);
+    CHECK(step < end);
+    CHECK(timeline.find("-9.000 ms") != std::string::npos);
+    CHECK(timeline.find("took=0.500 ms") != std::string::npos);
+    CHECK(timeline.find("status=200 took=3.000 ms") != std::string::npos);
+}
@@ -0,0 +1,61 @@
+#include "doctest.h"
+#include "hash_ring.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+HashRing make_ring(int nodes) {
+    HashRing ring;
+    for (int i = 0; i < nodes; ++i) {
+        ring.add_node("10.0.0." + std::to_string(i + 1) + ":6379");
+    }
+    return ring;
+}
+
+std::string key(int i) {
+    return "order:ORD" + std::to_string(1700000000000 + i);
+}
+}
+
+TEST_CASE("HashRing maps a key to the same node every time") {
+    const HashRing a = make_ring(3);
+    const HashRing b = make_ring(3);
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(a.node_for(key(i)) == b.node_for(key(i)));
+    }
+
+    const HashRing single = make_ring(1);
+    CHECK(single.node_for(key(42)) == 0);
+}
+
+TEST_CASE("HashRing spreads keys evenly across nodes") {
+    const HashRing ring = make_ring(3);
+    const int keys = 30000;
+    std::vector<int> counts(3, 0);
+    for (int i = 0; i < keys; ++i) {
+        ++counts[ring.node_for(key(i))];
+    }
+    for (const int count : counts) {
+        CHECK(count > keys / 3 * 85 / 100);
+        CHECK(count < keys / 3 * 115 / 100);
+    }
+}
+
+TEST_CASE("HashRing only moves keys to a newly added node") {
+    const HashRing before = make_ring(3);
+    const HashRing after = make_ring(4);
+    const int keys = 30000;
+    int moved = 0;
+    for (int i = 0; i < keys; ++i) {
+        const size_t old_node = before.node_for(key(i));
+        const size_t new_node = after.node_for(key(i));
+        if (old_node != new_node) {
+            CHECK(new_node == 3);
+            ++moved;
+        }
+    }
+    // Ideally a quarter of the keys move to the fourth node.
+    CHECK(moved > keys / 4 * 80 / 100);
+    CHECK(moved < keys / 4 * 120 / 100);
+}
@@ -0,0 +1,146 @@
+#include "doctest.h"
+#include "hot_restart.h"
+
+#include <chrono>
+#include <string>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+TEST_CASE("Hot restart snapshot round-trips counters, drain stats and the filter") {
+    hot_restart::Snapshot snapshot;
+    snapshot.drain_ms = 1234;
+    snapshot.requests_cut_off = 0;
+    snapshot.connections_dropped = 3;
+    snapshot.counters = {{"total_requests", 42}, {"cache_policy_hits{policy=\"paid\"}", 7}, {"hot_restarts", 0}};
+    order_filter::State filter;
+    filter.hash_count = 7;
+    filter.counters = std::string("\x00\x01\xff\x02", 4);
+    filter.items = 3;
+    filter.capacity = 100000;
+    snapshot.filter = filter;
+
+    const auto decoded = hot_restart::decode(hot_restart::encode(snapshot));
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->drain_ms == 1234);
+    CHECK(decoded->requests_cut_off == 0);
+    CHECK(decoded->connections_dropped == 3);
+    CHECK(decoded->counters == snapshot.counters);
+    REQUIRE(decoded->filter.has_value());
+    CHECK(decoded->filter->hash_count == 7);
+    CHECK(decoded->filter->counters == filter.counters);
+    CHECK(decoded->filter->items == 3);
+    CHECK(decoded->filter->capacity == 100000);
+
+    snapshot.filter.reset();
+    snapshot.requests_cut_off = 2;
+    const auto without_filter = hot_restart::decode(hot_restart::encode(snapshot));
+    REQUIRE(without_filter.has_value());
+    CHECK_FALSE(without_filter->filter.has_value());
+    CHECK(without_filter->requests_cut_off == 2);
+}
+
+TEST_CASE("Hot restart snapshot rejects truncated and unknown payloads") {
+    hot_restart::Snapshot snapshot;
+    snapshot.counters = {{"total_requests", 42}};
+    order_filter::State filter;
+    filter.hash_count = 3;
+    filter.counters = std::string(64, '\x01');
+    snapshot.filter = filter;
+    const std::string payload = hot_restart::encode(snapshot);
+
+    for (size_t size = 0; size < payload.size(); ++size) {
+        CHECK_FALSE(hot_restart::decode(payload.substr(0, size)).has_value());
+    }
+    CHECK_FALSE(hot_restart::decode(payload + "x").has_value());
+    std::string future = payload;
+    future[0] = 0x02;
+    CHECK_FALSE(hot_restart::decode(future).has_value());
+}
+
+#ifndef _WIN32
+TEST_CASE("Hot restart hands the listener and the snapshot across the handoff socket") {
+    int channel[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == 0);
+
+    const int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(listener >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    REQUIRE(listen(listener, 4) == 0);
+    socklen_t addr_size = sizeof(addr);
+    REQUIRE(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_size) == 0);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::string payload;
+    int received = -1;
+    REQUIRE(hot_restart::send_frame(channel[0], hot_restart::kListenerFrame, std::string(), listener));
+    REQUIRE(hot_restart::recv_frame(channel[1], hot_restart::kListenerFrame, deadline, payload, &received));
+    REQUIRE(received >= 0);
+    CHECK(received != listener);
+    CHECK(payload.empty());
+
+    // The received descriptor is the same listening socket: a client connecting to the
+    // original port is accepted on it, even with the sender's copy closed.
+    close(listener);
+    sockaddr_in bound{};
+    socklen_t bound_size = sizeof(bound);
+    REQUIRE(getsockname(received, reinterpret_cast<sockaddr*>(&bound), &bound_size) == 0);
+    CHECK(bound.sin_port == addr.sin_port);
+    const int client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(client >= 0);
+    REQUIRE(connect(client, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    const int accepted = accept(received, nullptr, nullptr);
+    CHECK(accepted >= 0);
+
+    REQUIRE(hot_restart::send_frame(channel[1], hot_restart::kAcceptingFrame, std::string()));
+    REQUIRE(hot_restart::recv_frame(channel[0], hot_restart::kAcceptingFrame, deadline, payload));
+
+    hot_restart::Snapshot snapshot;
+    snapshot.drain_ms = 12;
+    snapshot.counters = {{"total_requests", 42}};
+    order_filter::State filter;
+    filter.hash_count = 3;
+    filter.counters = std::string(1 << 16, '\x02');
+    filter.capacity = 1000;
+    snapshot.filter = filter;
+    REQUIRE(hot_restart::send_frame(channel[0], hot_restart::kSnapshotFrame, hot_restart::encode(snapshot)));
+    REQUIRE(hot_restart::recv_frame(channel[1], hot_restart::kSnapshotFrame, deadline, payload));
+    const auto decoded = hot_restart::decode(payload);
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->drain_ms == 12);
+    CHECK(decoded->counters == snapshot.counters);
+    REQUIRE(decoded->filter.has_value());
+    CHECK(decoded->filter->counters == filter.counters);
+
+    if (accepted >= 0) {
+        close(accepted);
+    }
+    close(client);
+    close(received);
+    close(channel[0]);
+    close(channel[1]);
+}
+
+TEST_CASE("Hot restart refuses a handoff frame of the wrong type or from a closed peer") {
+    int channel[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == 0);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::string payload;
+    REQUIRE(hot_restart::send_frame(channel[0], hot_restart::kSnapshotFrame, "state"));
+    CHECK_FALSE(hot_restart::recv_frame(channel[1], hot_restart::kListenerFrame, deadline, payload));
+    close(channel[0]);
+    close(channel[1]);
+
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == 0);
+    close(channel[0]);
+    CHECK_FALSE(hot_restart::recv_frame(channel[1], hot_restart::kSnapshotFrame, deadline, payload));
+    close(channel[1]);
+}
+#endif
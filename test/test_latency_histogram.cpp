@@ -0,0 +1,41 @@
+#include "doctest.h"
+#include "latency_histogram.h"
+
+TEST_CASE("LatencyHistogram records small values exactly") {
+    LatencyHistogram hist;
+    for (int64_t v = 1; v <= 100; ++v) {
+        hist.record(v);
+    }
+
+    CHECK(hist.count() == 100);
+    CHECK(hist.min() == 1);
+    CHECK(hist.max() == 100);
+    CHECK(hist.mean() == doctest::Approx(50.5));
+    CHECK(hist.value_at_percentile(50) == 50);
+    CHECK(hist.value_at_percentile(99) == 99);
+    CHECK(hist.value_at_percentile(100) == 100);
+}
+
+TEST_CASE("LatencyHistogram keeps relative error bounded for large values") {
+    LatencyHistogram hist(11);
+    const int64_t value = 123456789;
+    hist.record(value);
+
+    const int64_t reported = hist.value_at_percentile(50);
+    CHECK(reported <= value);
+    CHECK(static_cast<double>(value - reported) / static_cast<double>(value) < 1.0 / 1024.0);
+}
+
+TEST_CASE("LatencyHistogram merge combines counts and extremes") {
+    LatencyHistogram a;
+    LatencyHistogram b;
+    a.record(10, 90);
+    b.record(5000, 10);
+    a.merge(b);
+
+    CHECK(a.count() == 100);
+    CHECK(a.min() == 10);
+    CHECK(a.max() == 5000);
+    CHECK(a.value_at_percentile(90) == 10);
+    CHECK(a.value_at_percentile(99) >= 4990);
+}
@@ -0,0 +1,30 @@
+#include "doctest.h"
+#include "live_config.h"
+
+#include <string>
+
+TEST_CASE("Config files parse as trimmed KEY=VALUE lines") {
+    live_config::Settings settings;
+    std::string error;
+    REQUIRE(live_config::parse("# tuning\n\n CACHE_TTL_SECONDS = 120 \nLOG_LEVEL=debug\r\nEMPTY=\n", settings, error));
+    REQUIRE(settings.size() == 3);
+    CHECK(settings[0] == std::make_pair(std::string("CACHE_TTL_SECONDS"), std::string("120")));
+    CHECK(settings[1] == std::make_pair(std::string("LOG_LEVEL"), std::string("debug")));
+    CHECK(settings[2].second.empty());
+
+    live_config::Settings rejected;
+    CHECK_FALSE(live_config::parse("CACHE_TTL_SECONDS=1\nnot a setting\n", rejected, error));
+    CHECK(error.find("not a setting") != std::string::npos);
+    CHECK_FALSE(live_config::parse("=5", rejected, error));
+}
+
+TEST_CASE("Integer settings must be whole numbers within range") {
+    CHECK(live_config::parse_int("64", 1, 100) == 64);
+    CHECK(live_config::parse_int("0", 0, 100) == 0);
+    CHECK_FALSE(live_config::parse_int("0", 1, 100).has_value());
+    CHECK_FALSE(live_config::parse_int("101", 1, 100).has_value());
+    CHECK_FALSE(live_config::parse_int("12ms", 1, 100).has_value());
+    CHECK_FALSE(live_config::parse_int("1.5", 1, 100).has_value());
+    CHECK_FALSE(live_config::parse_int("", 1, 100).has_value());
+    CHECK_FALSE(live_config::parse_int("99999999999", 1, 2147483647).has_value());
+}
@@ -0,0 +1,84 @@
+#include "doctest.h"
+#include "order_cache.h"
+#include "sharded_cache.h"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+TEST_CASE("value_version reads the version prefix of cached values") {
+    CHECK(order_cache::value_version("2:{\"status\":\"PAID\"}") == 2);
+    CHECK(order_cache::value_version("3:") == 3);
+    CHECK(order_cache::value_version("{\"status\":\"PAID\"}") == -1);
+    CHECK(order_cache::value_version(":payload") == -1);
+    CHECK(order_cache::value_version("2x:payload") == -1);
+}
+
+TEST_CASE("set_if_newer never replaces a higher version") {
+    order_cache::InMemoryBackend cache;
+    CHECK(cache.set_if_newer("order:1", "1:pending", 1, seconds(60)));
+    CHECK(cache.set_if_newer("order:1", "2:paid", 2, seconds(60)));
+
+    // A PENDING read-fill that raced the payment arrives late and must lose.
+    CHECK_FALSE(cache.set_if_newer("order:1", "1:pending", 1, seconds(60)));
+    CHECK(cache.get("order:1") == std::string("2:paid"));
+
+    // Same version refreshes the entry; a tombstone outranks everything.
+    CHECK(cache.set_if_newer("order:1", "2:paid-again", 2, seconds(60)));
+    CHECK(cache.set_if_newer("order:1", "3:", 3, seconds(60)));
+    CHECK_FALSE(cache.set_if_newer("order:1", "2:paid", 2, seconds(60)));
+    CHECK(cache.get("order:1") == std::string("3:"));
+}
+
+namespace {
+// Stands in for a Redis node that is down: every call throws, the way the breaker does.
+class DownBackend : public order_cache::Backend {
+public:
+    void set(const std::string&, const std::string&, seconds) override { fail(); }
+    std::optional<std::string> get(const std::string&) override { fail(); }
+    void del(const std::string&) override { fail(); }
+    void ping() override { fail(); }
+    bool set_if_newer(const std::string&, const std::string&, int64_t, seconds) override { fail(); }
+
+private:
+    [[noreturn]] static void fail() {
+        throw order_cache::Unavailable("node down");
+    }
+};
+}
+
+TEST_CASE("A sharded cache with one node down only misses that node's keys") {
+    order_cache::InMemoryBackend up_a;
+    order_cache::InMemoryBackend up_b;
+    DownBackend down;
+    order_cache::ShardedBackend cache({&up_a, &down, &up_b}, {"redis-a:6379", "redis-b:6379", "redis-c:6379"}, 160);
+
+    std::vector<order_cache::VersionedEntry> entries;
+    for (int i = 0; i < 300; ++i) {
+        entries.push_back({"order:ORD" + std::to_string(i), "1:pending", 1, seconds(60)});
+    }
+    // The batch reaches both healthy nodes before the down node's error surfaces.
+    CHECK_THROWS_AS(cache.set_many(entries), order_cache::Unavailable);
+    CHECK_THROWS_AS(cache.ping(), order_cache::Unavailable);
+
+    int on_down_node = 0;
+    for (const auto& entry : entries) {
+        if (cache.node_index(entry.key) == 1) {
+            ++on_down_node;
+            CHECK_THROWS_AS(cache.get(entry.key), order_cache::Unavailable);
+            CHECK_THROWS_AS(cache.set(entry.key, "2:paid", seconds(60)), order_cache::Unavailable);
+        } else {
+            CHECK(cache.get(entry.key) == std::string("1:pending"));
+            CHECK(cache.set_if_newer(entry.key, "2:paid", 2, seconds(60)));
+            CHECK(cache.get(entry.key) == std::string("2:paid"));
+            cache.del(entry.key);
+            CHECK_FALSE(cache.get(entry.key).has_value());
+        }
+    }
+    // Roughly a third of the keys, so the down node neither owns everything nor nothing.
+    CHECK(on_down_node > 50);
+    CHECK(on_down_node < 150);
+}
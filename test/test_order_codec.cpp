@@ -0,0 +1,61 @@
+#include "doctest.h"
+#include "order_codec.h"
+
+#include <string>
+
+namespace {
+order_codec::Order paid_order() {
+    order_codec::Order order;
+    order.amount = 129.99;
+    order.status = "PAID";
+    order.created_at = 1700000000;
+    order.paid_at = 1700000300;
+    return order;
+}
+}
+
+TEST_CASE("order_codec round-trips an order in a few bytes") {
+    const auto encoded = order_codec::encode(paid_order());
+    REQUIRE(encoded.has_value());
+    CHECK(encoded->size() < 20);
+    CHECK_FALSE(order_codec::is_json(*encoded));
+
+    const auto decoded = order_codec::decode(*encoded);
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->amount == 129.99);
+    CHECK(decoded->status == "PAID");
+    CHECK(decoded->created_at == 1700000000);
+    CHECK(decoded->paid_at == 1700000300);
+
+    order_codec::Order pending;
+    pending.amount = 0.01;
+    pending.status = "PENDING";
+    pending.created_at = 1;
+    const auto pending_decoded = order_codec::decode(*order_codec::encode(pending));
+    REQUIRE(pending_decoded.has_value());
+    CHECK(pending_decoded->amount == 0.01);
+    CHECK(pending_decoded->status == "PENDING");
+    CHECK(pending_decoded->paid_at == 0);
+}
+
+TEST_CASE("order_codec leaves orders it can't represent exactly to JSON") {
+    auto order = paid_order();
+    order.amount = 0.125;
+    CHECK_FALSE(order_codec::encode(order).has_value());
+
+    order = paid_order();
+    order.status = "REFUNDED";
+    CHECK_FALSE(order_codec::encode(order).has_value());
+}
+
+TEST_CASE("order_codec rejects JSON, unknown formats and truncated values") {
+    CHECK(order_codec::is_json(R"({"order_no":"ORD1"})"));
+    CHECK_FALSE(order_codec::decode(R"({"order_no":"ORD1"})").has_value());
+
+    std::string newer = *order_codec::encode(paid_order());
+    newer[0] = 0x02;
+    CHECK_FALSE(order_codec::decode(newer).has_value());
+
+    const std::string full = *order_codec::encode(paid_order());
+    CHECK_FALSE(order_codec::decode(full.substr(0, full.size() - 1)).has_value());
+}
@@ -0,0 +1,55 @@
+#include "doctest.h"
+#include "request_deadline.h"
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Deadline expiry and remaining budget") {
+    const auto now = request_deadline::Clock::now();
+    const request_deadline::Deadline deadline{now + 50ms};
+    CHECK_FALSE(deadline.expired(now));
+    CHECK(deadline.remaining(now) == 50ms);
+    CHECK(deadline.expired(now + 50ms));
+    CHECK(deadline.remaining(now + 80ms) == 0ms);
+
+    const request_deadline::Deadline never;
+    CHECK_FALSE(never.expired());
+    CHECK(never.remaining() == std::chrono::milliseconds::max());
+}
+
+TEST_CASE("Scope installs the deadline for the thread and restores the outer one") {
+    CHECK(request_deadline::current() == nullptr);
+    const request_deadline::Deadline outer = request_deadline::Deadline::after(1h);
+    {
+        request_deadline::Scope outer_scope(outer);
+        CHECK(request_deadline::current() == &outer);
+        const request_deadline::Deadline inner{request_deadline::Clock::now() - 1ms};
+        {
+            request_deadline::Scope inner_scope(inner);
+            CHECK(request_deadline::current_expired());
+        }
+        CHECK(request_deadline::current() == &outer);
+        CHECK_FALSE(request_deadline::current_expired());
+    }
+    CHECK(request_deadline::current() == nullptr);
+}
+
+TEST_CASE("SQLite progress handler aborts only past the current deadline") {
+    CHECK(request_deadline::sqlite_progress(nullptr) == 0);
+
+    const request_deadline::Deadline live = request_deadline::Deadline::after(1h);
+    {
+        request_deadline::Scope scope(live);
+        CHECK(request_deadline::sqlite_progress(nullptr) == 0);
+        CHECK_FALSE(request_deadline::interrupted());
+    }
+
+    const request_deadline::Deadline passed{request_deadline::Clock::now() - 1ms};
+    {
+        request_deadline::Scope scope(passed);
+        CHECK(request_deadline::sqlite_progress(nullptr) == 1);
+        CHECK(request_deadline::interrupted());
+    }
+    CHECK_FALSE(request_deadline::interrupted());
+}
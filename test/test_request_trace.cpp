@@ -0,0 +1,50 @@
+#include "doctest.h"
+#include "request_trace.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Timers record into the scope's trace and Server-Timing sums each stage") {
+    request_trace::Trace trace;
+    const auto start = request_trace::Clock::now();
+    trace.add(request_trace::Stage::Cache, start, start + 2ms);
+    {
+        request_trace::Scope scope(&trace);
+        CHECK(request_trace::current() == &trace);
+        request_trace::Timer db(request_trace::Stage::Db);
+    }
+    CHECK(request_trace::current() == nullptr);
+    {
+        // Outside any scope a timer records nothing.
+        request_trace::Timer ignored(request_trace::Stage::Db);
+    }
+    trace.add(request_trace::Stage::Cache, start, start + 500us);
+
+    REQUIRE(trace.size() == 3);
+    CHECK(trace[1].stage == request_trace::Stage::Db);
+    CHECK(trace.total(request_trace::Stage::Cache) == 2500us);
+
+    const std::string header = request_trace::server_timing(trace, 4ms);
+    CHECK(header.rfind("cache;dur=2.500, db;dur=", 0) == 0);
+    CHECK(header.find("total;dur=4.000") != std::string::npos);
+    CHECK(header.find("auth") == std::string::npos);
+}
+
+TEST_CASE("Trace events carry the request and one event per span on its own thread") {
+    request_trace::Trace trace;
+    const auto start = request_trace::Clock::now();
+    std::thread([&trace, start] { trace.add(request_trace::Stage::Db, start + 1ms, start + 3ms); }).join();
+
+    const std::string events = request_trace::trace_events(
+        trace, "GET /order/get/\"x\"", start, 5ms, 200, request_trace::thread_number(), 42);
+    CHECK(events.find(R"({"name":"GET /order/get/\"x\"","cat":"request","ph":"X")") == 0);
+    CHECK(events.find(R"("dur":5000,"pid":42)") != std::string::npos);
+    CHECK(events.find(R"({"name":"db","cat":"stage","ph":"X")") != std::string::npos);
+    CHECK(events.find(R"("dur":2000)") != std::string::npos);
+    CHECK(trace[0].thread != request_trace::thread_number());
+    CHECK(events.size() >= 2);
+    CHECK(events.substr(events.size() - 2) == ",\n");
+}
@@ -0,0 +1,51 @@
+#include "doctest.h"
+#include "sql_stats.h"
+
+#include <algorithm>
+
+TEST_CASE("Statements register themselves and bucket each execution by its step time") {
+    static sql_stats::Statement statement("test_select", "SELECT 1;");
+    const auto& registered = sql_stats::statements();
+    CHECK(std::find(registered.begin(), registered.end(), &statement) != registered.end());
+
+    CHECK(sql_stats::bucket_for(0) == 0);
+    CHECK(sql_stats::bucket_for(25) == 0);
+    CHECK(sql_stats::bucket_for(26) == 1);
+    CHECK(sql_stats::bucket_for(250000) == sql_stats::kBucketBoundsUs.size() - 1);
+    CHECK(sql_stats::bucket_for(10000000) == sql_stats::kBucketCount - 1);
+
+    sql_stats::Counters scan;
+    scan.fullscan_steps = 999;
+    scan.vm_steps = 5000;
+    statement.record(40, false, scan);
+    statement.record(3000, true, sql_stats::Counters{});
+    CHECK(statement.executions.load() == 2);
+    CHECK(statement.errors.load() == 1);
+    CHECK(statement.duration_us_total.load() == 3040);
+    CHECK(statement.buckets[1].load() == 1);
+    CHECK(statement.buckets[sql_stats::bucket_for(3000)].load() == 1);
+    CHECK(statement.fullscan_steps.load() == 999);
+    CHECK(statement.vm_steps.load() == 5000);
+}
+
+TEST_CASE("Busy waits follow SQLite's backoff and stop at the timeout") {
+    CHECK(sql_stats::busy_delay_ms(0, 5000) == 1);
+    CHECK(sql_stats::busy_delay_ms(3, 5000) == 10);
+    CHECK(sql_stats::busy_delay_ms(11, 5000) == 100);
+    CHECK(sql_stats::busy_delay_ms(20, 5000) == 100);
+
+    // 1 + 2 + 5 ms have been slept before retry 3; only 2 ms of a 10 ms budget remain.
+    CHECK(sql_stats::busy_delay_ms(3, 10) == 2);
+    CHECK(sql_stats::busy_delay_ms(4, 10) == 0);
+    CHECK(sql_stats::busy_delay_ms(0, 0) == 0);
+
+    int total = 0;
+    for (int count = 0;; ++count) {
+        const int delay = sql_stats::busy_delay_ms(count, 5000);
+        if (delay == 0) {
+            break;
+        }
+        total += delay;
+    }
+    CHECK(total == 5000);
+}
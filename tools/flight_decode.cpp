@@ -0,0 +1,67 @@
+// Prints a flight recorder dump as a timeline, oldest event first.
+//
+// Usage:
+//   flight_decode [--request N] dump.bin
+//
+// Dumps come from SIGUSR1, POST /admin/flight-recorder/dump, or a request slower than
+// FLIGHT_RECORDER_SLOW_MS, and land in FLIGHT_RECORDER_DIR as flight-<unix_ms>-<reason>.bin.
+// --request keeps only one request's events; ids are the low 16 bits of the server's
+// request counter, so in a long dump one id can cover several requests.
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "flight_recorder.h"
+
+using namespace std;
+
+namespace {
+void usage() {
+    cerr << "Usage: flight_decode [--request N] dump.bin" << endl;
+}
+}
+
+int main(int argc, char** argv) {
+    string path;
+    long request = -1;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--request" && i + 1 < argc) {
+            request = strtol(argv[++i], nullptr, 10) & 0xffff;
+        } else if (path.empty() && arg.rfind("--", 0) != 0) {
+            path = arg;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (path.empty()) {
+        usage();
+        return 2;
+    }
+
+    ifstream in(path, ios::binary);
+    if (!in) {
+        cerr << "Can't open " << path << endl;
+        return 1;
+    }
+    const string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    auto dump = flight_recorder::decode(bytes);
+    if (!dump) {
+        cerr << path << " is not a flight recorder dump, or is truncated" << endl;
+        return 1;
+    }
+    if (request >= 0) {
+        for (auto& thread : dump->threads) {
+            auto& events = thread.events;
+            events.erase(remove_if(events.begin(), events.end(),
+                                   [request](const flight_recorder::Event& event) { return event.request != request; }),
+                         events.end());
+        }
+    }
+    cout << flight_recorder::timeline(*dump);
+    return 0;
+}
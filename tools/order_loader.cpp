@@ -0,0 +1,550 @@
+// Bulk loader for seeding and migrating orders.db without going through the HTTP API.
+//
+// Usage:
+//   order_loader [--db orders.db] [--format jsonl|csv] [--threads N] [--batch N]
+//                [--replace] [--keep-indexes] [--unsafe-writes] [--generate N] [input|-]
+//
+// Input rows use the same fields as the API and /order/export:
+// order_no, amount, status, created_at, paid_at. Timestamps may be unix seconds or
+// "YYYY-MM-DD HH:MM:SS" local time; an empty or null paid_at means unpaid.
+// Run it against a stopped server: secondary indexes are dropped during the load and rebuilt
+// on every exit, failed loads included. Durability is relaxed (synchronous=OFF, in-memory
+// journal) only for a new, empty database, or with --unsafe-writes.
+#include "crow_all.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+#include "order_schema.h"
+
+using namespace std;
+
+namespace {
+struct OrderRow {
+    string order_no;
+    double amount = 0;
+    string status = "PENDING";
+    int64_t created_at = 0;
+    int64_t paid_at = 0;
+};
+
+struct Chunk {
+    vector<string> lines;
+    uint64_t first_line = 0;
+    size_t generate_count = 0;
+};
+
+struct ParsedChunk {
+    vector<OrderRow> rows;
+    size_t rejected = 0;
+};
+
+struct Options {
+    string db_path = "orders.db";
+    string input = "-";
+    string format;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    size_t batch_rows = 100000;
+    bool replace = false;
+    bool keep_indexes = false;
+    bool unsafe_writes = false;
+    size_t generate = 0;
+};
+
+constexpr size_t kLinesPerChunk = 8192;
+
+// Small blocking queue with a capacity so a fast reader cannot run ahead of the writer.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T item) {
+        unique_lock<mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push(move(item));
+        not_empty_.notify_one();
+    }
+
+    optional<T> pop() {
+        unique_lock<mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return nullopt;
+        }
+        T item = move(items_.front());
+        items_.pop();
+        not_full_.notify_one();
+        return item;
+    }
+
+    void close() {
+        lock_guard<mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    queue<T> items_;
+    bool closed_ = false;
+    mutex mutex_;
+    condition_variable not_full_;
+    condition_variable not_empty_;
+};
+
+int64_t parse_timestamp(const string& raw) {
+    if (raw.empty() || raw == "null" || raw == "N/A") {
+        return 0;
+    }
+    if (all_of(raw.begin(), raw.end(), [](unsigned char c) { return isdigit(c); })) {
+        return strtoll(raw.c_str(), nullptr, 10);
+    }
+
+    tm parsed{};
+    if (sscanf(raw.c_str(), "%d-%d-%d %d:%d:%d",
+               &parsed.tm_year, &parsed.tm_mon, &parsed.tm_mday,
+               &parsed.tm_hour, &parsed.tm_min, &parsed.tm_sec) != 6) {
+        return -1;
+    }
+    parsed.tm_year -= 1900;
+    parsed.tm_mon -= 1;
+    parsed.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&parsed));
+}
+
+bool valid_row(const OrderRow& row) {
+    return row.order_no.size() > 3 && row.order_no.compare(0, 3, "ORD") == 0 &&
+           row.amount > 0 && (row.status == "PENDING" || row.status == "PAID") &&
+           row.created_at >= 0 && row.paid_at >= 0;
+}
+
+bool parse_jsonl(const string& line, OrderRow& row) {
+    auto json = crow::json::load(line);
+    if (!json || !json.has("order_no") || !json.has("amount")) {
+        return false;
+    }
+    if (json["order_no"].t() != crow::json::type::String || json["amount"].t() != crow::json::type::Number) {
+        return false;
+    }
+
+    auto timestamp_field = [&json](const char* key) -> int64_t {
+        if (!json.has(key)) {
+            return 0;
+        }
+        const auto& value = json[key];
+        if (value.t() == crow::json::type::Number) {
+            return value.i();
+        }
+        if (value.t() == crow::json::type::String) {
+            return parse_timestamp(value.s());
+        }
+        return 0;
+    };
+
+    row.order_no = json["order_no"].s();
+    row.amount = json["amount"].d();
+    if (json.has("status") && json["status"].t() == crow::json::type::String) {
+        row.status = json["status"].s();
+    }
+    row.created_at = timestamp_field("created_at");
+    row.paid_at = timestamp_field("paid_at");
+    return true;
+}
+
+vector<string> split_csv(const string& line) {
+    vector<string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                ++i;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back() += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+struct CsvColumns {
+    int order_no = -1;
+    int amount = -1;
+    int status = -1;
+    int created_at = -1;
+    int paid_at = -1;
+};
+
+CsvColumns parse_csv_header(const string& line) {
+    CsvColumns columns;
+    const auto names = split_csv(line);
+    for (int i = 0; i < static_cast<int>(names.size()); ++i) {
+        if (names[i] == "order_no") columns.order_no = i;
+        if (names[i] == "amount") columns.amount = i;
+        if (names[i] == "status") columns.status = i;
+        if (names[i] == "created_at") columns.created_at = i;
+        if (names[i] == "paid_at") columns.paid_at = i;
+    }
+    return columns;
+}
+
+bool parse_csv(const string& line, const CsvColumns& columns, OrderRow& row) {
+    const auto fields = split_csv(line);
+    auto field = [&fields](int index) -> string {
+        return index >= 0 && index < static_cast<int>(fields.size()) ? fields[index] : string();
+    };
+
+    row.order_no = field(columns.order_no);
+    const string amount = field(columns.amount);
+    char* end = nullptr;
+    row.amount = strtod(amount.c_str(), &end);
+    if (amount.empty() || *end != '\0') {
+        return false;
+    }
+    if (columns.status >= 0) {
+        row.status = field(columns.status);
+    }
+    row.created_at = parse_timestamp(field(columns.created_at));
+    row.paid_at = parse_timestamp(field(columns.paid_at));
+    return true;
+}
+
+void generate_rows(const Chunk& chunk, ParsedChunk& out) {
+    mt19937_64 rng(chunk.first_line);
+    uniform_real_distribution<double> amount_dist(1.0, 500.0);
+    uniform_int_distribution<int64_t> age_dist(0, 30 * 24 * 3600);
+    const int64_t now = static_cast<int64_t>(time(nullptr));
+
+    out.rows.reserve(chunk.generate_count);
+    for (size_t i = 0; i < chunk.generate_count; ++i) {
+        OrderRow row;
+        row.order_no = "ORD" + to_string(now) + "S" + to_string(chunk.first_line + i);
+        row.amount = static_cast<int64_t>(amount_dist(rng) * 100) / 100.0;
+        row.created_at = now - age_dist(rng);
+        if (rng() % 10 < 3) {
+            row.status = "PAID";
+            row.paid_at = min(now, row.created_at + static_cast<int64_t>(rng() % 3600));
+        }
+        out.rows.push_back(move(row));
+    }
+}
+
+bool exec_sql(sqlite3* db, const string& sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        cerr << "SQL error: " << (err_msg ? err_msg : sqlite3_errmsg(db)) << endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
+int64_t query_int64(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        cerr << "Prepare failed: " << sqlite3_errmsg(db) << endl;
+        return -1;
+    }
+    const int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+void usage() {
+    cerr << "usage: order_loader [--db orders.db] [--format jsonl|csv] [--threads N] [--batch N]\n"
+            "                    [--replace] [--keep-indexes] [--unsafe-writes] [--generate N] [input|-]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        auto next = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                cerr << name << " requires a value" << endl;
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        const char* value = nullptr;
+        if (arg == "--db") {
+            if (!(value = next("--db"))) return false;
+            options.db_path = value;
+        } else if (arg == "--format") {
+            if (!(value = next("--format"))) return false;
+            options.format = value;
+        } else if (arg == "--threads") {
+            if (!(value = next("--threads"))) return false;
+            options.threads = max(1, atoi(value));
+        } else if (arg == "--batch") {
+            if (!(value = next("--batch"))) return false;
+            options.batch_rows = max(1, atoi(value));
+        } else if (arg == "--generate") {
+            if (!(value = next("--generate"))) return false;
+            options.generate = strtoull(value, nullptr, 10);
+        } else if (arg == "--replace") {
+            options.replace = true;
+        } else if (arg == "--keep-indexes") {
+            options.keep_indexes = true;
+        } else if (arg == "--unsafe-writes") {
+            options.unsafe_writes = true;
+        } else if (arg == "--help" || arg == "-h") {
+            return false;
+        } else if (!arg.empty() && arg[0] == '-' && arg != "-") {
+            cerr << "unknown option " << arg << endl;
+            return false;
+        } else {
+            options.input = arg;
+        }
+    }
+
+    if (options.format.empty()) {
+        const bool csv_name = options.input.size() > 4 &&
+                              options.input.compare(options.input.size() - 4, 4, ".csv") == 0;
+        options.format = csv_name ? "csv" : "jsonl";
+    }
+    if (options.format != "jsonl" && options.format != "csv") {
+        cerr << "--format must be jsonl or csv" << endl;
+        return false;
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(options.db_path.c_str(), &db) != SQLITE_OK) {
+        cerr << "Can't open DB: " << sqlite3_errmsg(db) << endl;
+        return 1;
+    }
+
+    // A crash with synchronous=OFF and an in-memory journal can corrupt the file, which only
+    // costs a rerun when nothing was in it yet.
+    const bool fresh = query_int64(db, "SELECT COUNT(*) FROM sqlite_master;") == 0;
+    const bool relax_durability = fresh || options.unsafe_writes;
+    if (!relax_durability) {
+        cerr << "[order_loader] " << options.db_path << " already has data; writing with its normal journal "
+             << "(pass --unsafe-writes to skip it)" << endl;
+    }
+
+    // Same layout as the server's init_db().
+    if (!exec_sql(db, "PRAGMA auto_vacuum = INCREMENTAL;" + order_schema::create_orders_table_sql()) ||
+        !exec_sql(db, "PRAGMA cache_size = -262144;") ||
+        (relax_durability && !exec_sql(db, "PRAGMA synchronous = OFF; PRAGMA journal_mode = MEMORY;"))) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    ifstream file;
+    istream* in = &cin;
+    if (options.generate == 0 && options.input != "-") {
+        file.open(options.input, ios::binary);
+        if (!file) {
+            cerr << "Can't open input " << options.input << endl;
+            sqlite3_close(db);
+            return 1;
+        }
+        in = &file;
+    }
+
+    CsvColumns csv_columns;
+    string line;
+    if (options.generate == 0 && options.format == "csv") {
+        if (!getline(*in, line)) {
+            cerr << "CSV input is empty" << endl;
+            sqlite3_close(db);
+            return 1;
+        }
+        csv_columns = parse_csv_header(line);
+        if (csv_columns.order_no < 0 || csv_columns.amount < 0) {
+            cerr << "CSV header must contain order_no and amount" << endl;
+            sqlite3_close(db);
+            return 1;
+        }
+    }
+
+    // Dropped only once the input is known to open; rebuilt below however the load ends.
+    if (!options.keep_indexes &&
+        !exec_sql(db, "DROP INDEX IF EXISTS idx_orders_created_at; DROP INDEX IF EXISTS idx_orders_status_paid_at;")) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    const auto start = chrono::steady_clock::now();
+    BoundedQueue<Chunk> chunks(options.threads * 2);
+    BoundedQueue<ParsedChunk> parsed(options.threads * 2);
+    atomic<size_t> rejected{0};
+
+    vector<thread> parsers;
+    for (unsigned i = 0; i < options.threads; ++i) {
+        parsers.emplace_back([&] {
+            while (auto chunk = chunks.pop()) {
+                ParsedChunk out;
+                if (chunk->generate_count > 0) {
+                    generate_rows(*chunk, out);
+                } else {
+                    out.rows.reserve(chunk->lines.size());
+                    for (const auto& raw : chunk->lines) {
+                        if (raw.empty() || raw == "\r") {
+                            continue;
+                        }
+                        OrderRow row;
+                        const bool ok = options.format == "csv" ? parse_csv(raw, csv_columns, row) : parse_jsonl(raw, row);
+                        if (ok && valid_row(row)) {
+                            out.rows.push_back(move(row));
+                        } else {
+                            ++out.rejected;
+                        }
+                    }
+                }
+                rejected.fetch_add(out.rejected, memory_order_relaxed);
+                parsed.push(move(out));
+            }
+        });
+    }
+
+    // Single writer: one prepared statement, large transactions.
+    size_t inserted = 0;
+    size_t written = 0;
+    bool write_failed = false;
+    thread writer([&] {
+        const char* sql = options.replace
+            ? "INSERT OR REPLACE INTO orders (order_no, amount, status, created_at, paid_at) VALUES (?, ?, ?, ?, ?);"
+            : "INSERT OR IGNORE INTO orders (order_no, amount, status, created_at, paid_at) VALUES (?, ?, ?, ?, ?);";
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            cerr << "Prepare failed: " << sqlite3_errmsg(db) << endl;
+            write_failed = true;
+        }
+
+        size_t in_transaction = 0;
+        auto last_report = chrono::steady_clock::now();
+        while (auto batch = parsed.pop()) {
+            if (write_failed) {
+                continue; // keep draining so the parsers can finish
+            }
+            for (const auto& row : batch->rows) {
+                if (in_transaction == 0 && !exec_sql(db, "BEGIN;")) {
+                    write_failed = true;
+                    break;
+                }
+                sqlite3_bind_text(stmt, 1, row.order_no.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_double(stmt, 2, row.amount);
+                sqlite3_bind_text(stmt, 3, row.status.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int64(stmt, 4, row.created_at);
+                sqlite3_bind_int64(stmt, 5, row.paid_at);
+                if (sqlite3_step(stmt) != SQLITE_DONE) {
+                    cerr << "Insert failed for " << row.order_no << ": " << sqlite3_errmsg(db) << endl;
+                    write_failed = true;
+                    break;
+                }
+                inserted += sqlite3_changes(db);
+                ++written;
+                sqlite3_reset(stmt);
+                if (++in_transaction >= options.batch_rows) {
+                    if (!exec_sql(db, "COMMIT;")) {
+                        write_failed = true;
+                        break;
+                    }
+                    in_transaction = 0;
+                }
+            }
+
+            const auto now = chrono::steady_clock::now();
+            if (now - last_report >= chrono::seconds(2)) {
+                const double seconds = chrono::duration<double>(now - start).count();
+                cerr << "[order_loader] " << written << " rows (" << static_cast<int64_t>(written / seconds) << " rows/s)" << endl;
+                last_report = now;
+            }
+        }
+        // A failed batch is rolled back so the index rebuild below doesn't run inside it.
+        if (write_failed) {
+            if (!sqlite3_get_autocommit(db)) {
+                exec_sql(db, "ROLLBACK;");
+            }
+        } else if (in_transaction > 0) {
+            write_failed = !exec_sql(db, "COMMIT;");
+        }
+        sqlite3_finalize(stmt);
+    });
+
+    uint64_t line_no = 0;
+    if (options.generate > 0) {
+        for (size_t offset = 0; offset < options.generate; offset += kLinesPerChunk) {
+            Chunk chunk;
+            chunk.first_line = offset;
+            chunk.generate_count = min(kLinesPerChunk, options.generate - offset);
+            chunks.push(move(chunk));
+        }
+    } else {
+        Chunk chunk;
+        while (getline(*in, line)) {
+            chunk.lines.push_back(move(line));
+            if (chunk.lines.size() == kLinesPerChunk) {
+                chunk.first_line = line_no;
+                line_no += chunk.lines.size();
+                chunks.push(move(chunk));
+                chunk = Chunk();
+            }
+        }
+        if (!chunk.lines.empty()) {
+            chunk.first_line = line_no;
+            chunks.push(move(chunk));
+        }
+    }
+
+    chunks.close();
+    for (auto& parser : parsers) {
+        parser.join();
+    }
+    parsed.close();
+    writer.join();
+
+    const auto load_done = chrono::steady_clock::now();
+    if (!options.keep_indexes) {
+        cerr << "[order_loader] building indexes..." << endl;
+        if (!exec_sql(db, order_schema::create_orders_indexes_sql() + "ANALYZE;")) {
+            write_failed = true;
+        }
+    }
+    sqlite3_close(db);
+
+    const auto end = chrono::steady_clock::now();
+    const double load_seconds = chrono::duration<double>(load_done - start).count();
+    const double total_seconds = chrono::duration<double>(end - start).count();
+    cout << "rows_written " << written << "\n"
+         << "rows_inserted " << inserted << "\n"
+         << "rows_rejected " << rejected.load() << "\n"
+         << "load_seconds " << load_seconds << "\n"
+         << "index_seconds " << (total_seconds - load_seconds) << "\n"
+         << "rows_per_second " << static_cast<int64_t>(written / max(total_seconds, 1e-9)) << endl;
+    return write_failed ? 1 : 0;
+}